@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/*
+Allocator for std::vector that places the first element on an Alignment byte boundary,
+so that the data can be read and written with aligned SSE/AVX loads and stores.
+
+The memory comes from the global operator new, over-allocated so that the block can be
+moved up to the boundary, with the original pointer kept just in front of it for freeing.
+*/
+
+template <typename T, size_t Alignment = 32>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count)
+	{
+		char* memory = static_cast<char*>(::operator new(count * sizeof(T) + sizeof(void*) + Alignment - 1));
+
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(memory) + sizeof(void*) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = memory;
+
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* memory, size_t)
+	{
+		::operator delete(reinterpret_cast<void**>(memory)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
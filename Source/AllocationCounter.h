@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+Counts every heap allocation made through operator new (and so by every standard container)
+since the program started, by replacing the global operator new and delete. Reading the count
+before and after a piece of code shows how many allocations it made, which for a frame in
+steady state should be none.
+*/
+
+class AllocationCounter
+{
+public:
+	static unsigned long long GetAllocationCount();
+};
@@ -0,0 +1,203 @@
+#include "AssetLoader.h"
+#include "MD2Loader.h"
+#include "MeshCache.h"
+
+AssetLoader::AssetLoader()
+{
+	//the workers are only started by the first load, so a loader that is never used costs nothing
+	SetThreadCount(0);
+}
+
+AssetLoader::~AssetLoader()
+{
+	StopWorkers();
+
+	//loads that never started are handed back as failed, so nothing waiting on a future waits forever
+	for (size_t i = 0; i < _queue.size(); i++)
+	{
+		if (!_queue[i]->callback)
+		{
+			_queue[i]->promise.set_value(nullptr);
+		}
+	}
+}
+
+unsigned int AssetLoader::GetThreadCount() const
+{
+	return _threadCount;
+}
+
+void AssetLoader::SetThreadCount(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount > 0 ? threadCount : 1;
+	}
+
+	if (threadCount == _threadCount)
+	{
+		return;
+	}
+	_threadCount = threadCount;
+
+	//the queue is kept, so the new workers pick up where the old ones stopped
+	if (!_workers.empty())
+	{
+		StopWorkers();
+		StartWorkers();
+	}
+}
+
+std::future<AssetLoader::ModelPointer> AssetLoader::LoadModel(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile)
+{
+	std::unique_ptr<LoadRequest> request(new LoadRequest());
+	request->modelFile = modelFile;
+	request->textureFile = textureFile;
+	request->cacheFile = cacheFile;
+
+	std::future<ModelPointer> future = request->promise.get_future();
+	Queue(std::move(request));
+	return future;
+}
+
+void AssetLoader::LoadModel(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile, const ModelCallback& callback)
+{
+	std::unique_ptr<LoadRequest> request(new LoadRequest());
+	request->modelFile = modelFile;
+	request->textureFile = textureFile;
+	request->cacheFile = cacheFile;
+	request->callback = callback;
+
+	Queue(std::move(request));
+}
+
+unsigned int AssetLoader::DeliverCompleted()
+{
+	//the finished loads are taken in one go, so the callbacks run without holding the lock and can queue more loads
+	std::vector<std::unique_ptr<LoadRequest>> completed;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		completed.swap(_completed);
+	}
+
+	for (size_t i = 0; i < completed.size(); i++)
+	{
+		completed[i]->callback(completed[i]->model);
+	}
+
+	return static_cast<unsigned int>(completed.size());
+}
+
+size_t AssetLoader::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _queue.size() + _running + _completed.size();
+}
+
+bool AssetLoader::Load(const char* modelFile, const char* textureFile, const char* cacheFile, Model& model)
+{
+	//the cache holds the model ready to use, and is rebuilt from the MD2 and PCX files when they change
+	if (cacheFile != nullptr)
+	{
+		return MeshCache::LoadModel(modelFile, textureFile, cacheFile, model);
+	}
+
+	//load the model and texture, populate collections with vertices, polygons and coords
+	if (!MD2Loader::LoadModel(modelFile, textureFile, model,
+		&Model::AddPolygon,
+		&Model::AddVertex,
+		&Model::AddTextureUV,
+		&Model::AddAnimationFrame))
+	{
+		return false;
+	}
+
+	model.CalculateBounds();
+	model.BuildClusters();
+
+	return true;
+}
+
+void AssetLoader::Queue(std::unique_ptr<LoadRequest> request)
+{
+	if (_workers.empty())
+	{
+		StartWorkers();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.push_back(std::move(request));
+	}
+	_queueCondition.notify_one();
+}
+
+void AssetLoader::StartWorkers()
+{
+	_stopping = false;
+
+	for (unsigned int i = 0; i < _threadCount; i++)
+	{
+		_workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+	}
+}
+
+//lets each worker finish the load it is on, then joins them
+void AssetLoader::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_queueCondition.notify_all();
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		_workers[i].join();
+	}
+	_workers.clear();
+}
+
+//each worker sleeps until a load is queued, loads it into a model of its own, then hands the model back
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		std::unique_ptr<LoadRequest> request;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_queueCondition.wait(lock, [this] { return _stopping || !_queue.empty(); });
+			if (_stopping)
+			{
+				return;
+			}
+			request = std::move(_queue.front());
+			_queue.pop_front();
+			_running++;
+		}
+
+		ModelPointer model = std::make_shared<Model>();
+		if (!Load(request->modelFile.c_str(),
+			request->textureFile.empty() ? nullptr : request->textureFile.c_str(),
+			request->cacheFile.empty() ? nullptr : request->cacheFile.c_str(),
+			*model))
+		{
+			model = nullptr;
+		}
+
+		//callbacks wait for DeliverCompleted, while futures are ready as soon as the model is
+		if (request->callback)
+		{
+			request->model = model;
+			std::lock_guard<std::mutex> lock(_mutex);
+			_completed.push_back(std::move(request));
+			_running--;
+		}
+		else
+		{
+			request->promise.set_value(model);
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running--;
+		}
+	}
+}
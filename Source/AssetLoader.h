@@ -0,0 +1,108 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Model.h"
+
+/*
+Loads models in the background on a pool of worker threads, so that many MD2 and PCX files
+(or their mesh caches) are decoded at once while the main loop carries on rendering.
+
+Each request is queued and taken by the next free worker, which loads it into a Model of
+its own. The finished model is handed back either through a future, or through a callback
+that is run on whichever thread calls DeliverCompleted, normally the main loop between
+frames, so that the model can be swapped in without any locking around rendering. A model
+that fails to load is handed back as nullptr. When the loader is destroyed, loads that have not
+started hand nullptr to their futures, but callbacks that have not yet been delivered are dropped
+without being run, as whatever they would hand the model to may already be gone.
+
+Loads of the same model with the same cache file should not run at once, as both would
+rebuild the cache together; the reader checksums the cache, so the worst that happens is
+that it is rebuilt again on the next start.
+*/
+
+class AssetLoader
+{
+public:
+	typedef std::shared_ptr<Model> ModelPointer;
+	typedef std::function<void(ModelPointer)> ModelCallback;
+
+	AssetLoader();
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	/*
+	Accesses / mutates the number of worker threads, 0 for one per core. The workers start with the first load,
+	and changing the count once they have started waits for the loads already running
+	*/
+
+	unsigned int GetThreadCount() const;
+	void SetThreadCount(unsigned int threadCount);
+
+	/*
+	Queues a model to load, with an optional texture and mesh cache file (empty for none),
+	returning a future for the model / calling back with it from DeliverCompleted
+	*/
+
+	std::future<ModelPointer> LoadModel(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile);
+	void LoadModel(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile, const ModelCallback& callback);
+
+	/*
+	Runs the callbacks of the loads that have finished since it was last called, on the calling thread,
+	returning how many were run
+	*/
+
+	unsigned int DeliverCompleted();
+
+	/*
+	Accesses the number of loads that are queued, running or waiting to be delivered
+	*/
+
+	size_t GetPendingCount() const;
+
+	/*
+	Loads a model straight away on the calling thread, through the mesh cache if a cache file is
+	given. The model must be empty. This is what each worker runs for a queued load
+	*/
+
+	static bool Load(const char* modelFile, const char* textureFile, const char* cacheFile, Model& model);
+
+private:
+	struct LoadRequest
+	{
+		std::string modelFile;
+		std::string textureFile;
+		std::string cacheFile;
+		std::promise<ModelPointer> promise;
+		ModelCallback callback;
+		ModelPointer model;
+	};
+
+	void Queue(std::unique_ptr<LoadRequest> request);
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerLoop();
+
+	/*
+	Members to hold the workers, the queue of loads they take from and the finished loads
+	that are waiting for their callbacks
+	*/
+
+	unsigned int _threadCount{ 0 };
+	std::vector<std::thread> _workers;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _queueCondition;
+	std::deque<std::unique_ptr<LoadRequest>> _queue;
+	std::vector<std::unique_ptr<LoadRequest>> _completed;
+	size_t _running{ 0 };
+	bool _stopping{ false };
+};
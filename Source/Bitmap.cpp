@@ -1,4 +1,5 @@
 #include "Bitmap.h"
+#include <algorithm>
 
 Bitmap::Bitmap()
 {
@@ -10,7 +11,11 @@ Bitmap::~Bitmap()
 	DeleteBitmap();
 }
 
-// Create a new bitmap of the specified width and height, deleting any existing bitmap
+#ifdef _WIN32
+
+// Create a new bitmap of the specified width and height, deleting any existing bitmap.
+// The bitmap is a top-down 32-bit DIB section so that the pixel memory can be written
+// to directly as well as through GDI.
 //
 // Returns value of false if bitmap cannot be created.
 
@@ -29,10 +34,20 @@ bool Bitmap::Create(HWND hWnd, unsigned int width, unsigned int height)
 	_hMemDC = CreateCompatibleDC(hDc);
 	if (_hMemDC != 0)
 	{
-		// Create a bitmap compatible with the window
-		_hBitmap = CreateCompatibleBitmap(hDc, _width, _height);
+		// Describe a 32 bits per pixel bitmap. A negative height makes row 0 the top of the image
+		BITMAPINFO bitmapInfo = {};
+		bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bitmapInfo.bmiHeader.biWidth = static_cast<LONG>(_width);
+		bitmapInfo.bmiHeader.biHeight = -static_cast<LONG>(_height);
+		bitmapInfo.bmiHeader.biPlanes = 1;
+		bitmapInfo.bmiHeader.biBitCount = 32;
+		bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+		void * bits = nullptr;
+		_hBitmap = CreateDIBSection(hDc, &bitmapInfo, DIB_RGB_COLORS, &bits, NULL, 0);
 		if (_hBitmap != 0)
 		{
+			_pixels = static_cast<unsigned int *>(bits);
 			// Select the bitmap into the new device context, saving any old bitmap handle
 			_hOldBitmap = static_cast<HBITMAP>(SelectObject(_hMemDC, _hBitmap));
 			status = true;
@@ -50,6 +65,23 @@ HDC Bitmap::GetDC() const
 	return _hMemDC;
 }
 
+#else
+
+// Create a new bitmap of the specified width and height in ordinary heap memory,
+// deleting any existing bitmap. Used when there is no window to draw to.
+
+bool Bitmap::Create(unsigned int width, unsigned int height)
+{
+	DeleteBitmap();
+
+	_width = width;
+	_height = height;
+	_pixels = new unsigned int[_width * _height];
+	return true;
+}
+
+#endif
+
 // Return width of bitmap
 
 unsigned int Bitmap::GetWidth() const
@@ -64,17 +96,51 @@ unsigned int Bitmap::GetHeight() const
 	return _height;
 }
 
+// Return the first pixel of the top row of the bitmap
+
+unsigned int * Bitmap::GetPixels() const
+{
+	return _pixels;
+}
+
+// Return the number of pixels between the start of one row and the next
+
+unsigned int Bitmap::GetStride() const
+{
+	return _width;
+}
+
+// Return a render target covering the whole bitmap. Any outstanding GDI drawing is
+// flushed first so that it is not lost underneath direct writes to the pixels.
+
+RenderTarget Bitmap::GetRenderTarget() const
+{
+#ifdef _WIN32
+	GdiFlush();
+#endif
+	RenderTarget target;
+	target.pixels = _pixels;
+	target.depth = nullptr;
+	target.stride = GetStride();
+	target.minX = 0;
+	target.minY = 0;
+	target.maxX = static_cast<int>(_width) - 1;
+	target.maxY = static_cast<int>(_height) - 1;
+	return target;
+}
+
 // Delete any existing bitmap
 
 void Bitmap::DeleteBitmap()
 {
+#ifdef _WIN32
 	// Select any default bitmap that existed for the device context
 	if (_hOldBitmap != 0 && _hMemDC != 0)
 	{
 		SelectObject(_hMemDC, _hOldBitmap);
 		_hOldBitmap = 0;
 	}
-	// Delete any existing bitmap
+	// Delete any existing bitmap. This also frees the pixel memory of the DIB section
 	if (_hBitmap != 0)
 	{
 		DeleteObject(_hBitmap);
@@ -86,8 +152,14 @@ void Bitmap::DeleteBitmap()
 		DeleteDC(_hMemDC);
 		_hMemDC = 0;
 	}
+#else
+	delete[] _pixels;
+#endif
+	_pixels = nullptr;
 }
 
+#ifdef _WIN32
+
 // Clear bitmap using the specified brush
 
 void Bitmap::Clear(HBRUSH hBrush) const
@@ -101,11 +173,18 @@ void Bitmap::Clear(HBRUSH hBrush) const
 	FillRect(_hMemDC, &rect, hBrush);
 }
 
-// Clear bitmap using the specified colour
+#endif
+
+// Clear bitmap using the specified colour, writing straight into the pixel memory
 
 void Bitmap::Clear(COLORREF colour) const
 {
-	HBRUSH brush = CreateSolidBrush(colour);
-	Clear(brush);
-	DeleteObject(brush);
+	if (_pixels == nullptr)
+	{
+		return;
+	}
+#ifdef _WIN32
+	GdiFlush();
+#endif
+	std::fill(_pixels, _pixels + _width * _height, ToPixel(colour));
 }
@@ -1,5 +1,6 @@
 #pragma once
-#include "windows.h"
+#include "Platform.h"
+#include "RenderTarget.h"
 
 class Bitmap
 {
@@ -7,20 +8,42 @@ public:
 	Bitmap();
 	~Bitmap();
 
+#ifdef _WIN32
 	bool			Create(HWND hWnd, unsigned int width, unsigned int height);
 	HDC				GetDC() const;
+	void			Clear(HBRUSH hBrush) const;
+#else
+	bool			Create(unsigned int width, unsigned int height);
+#endif
 	unsigned int	GetWidth() const;
 	unsigned int	GetHeight() const;
-	void			Clear(HBRUSH hBrush) const;
+	unsigned int *	GetPixels() const;
+	unsigned int	GetStride() const;
+	RenderTarget	GetRenderTarget() const;
 	void			Clear(COLORREF colour) const;
 
+	// Convert a COLORREF (0x00BBGGRR) or separate channels into the 0x00RRGGBB
+	// layout used by the pixel memory. Kept inline as they are called per pixel.
+
+	static inline unsigned int ToPixel(COLORREF colour)
+	{
+		return ((colour & 0xFF) << 16) | (colour & 0xFF00) | ((colour >> 16) & 0xFF);
+	}
+
+	static inline unsigned int ToPixel(int red, int green, int blue)
+	{
+		return ((red & 0xFF) << 16) | ((green & 0xFF) << 8) | (blue & 0xFF);
+	}
+
 private:
+#ifdef _WIN32
 	HBITMAP			_hBitmap{ 0 };
 	HBITMAP			_hOldBitmap{ 0 };
 	HDC				_hMemDC{ 0 };
+#endif
+	unsigned int *	_pixels{ nullptr };
 	unsigned int	_width{ 0 };
 	unsigned int	_height{ 0 };
 
 	void DeleteBitmap();
 };
-
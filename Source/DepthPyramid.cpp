@@ -0,0 +1,143 @@
+#include "DepthPyramid.h"
+
+DepthPyramid::DepthPyramid()
+{
+	_width = 0;
+	_height = 0;
+}
+
+void DepthPyramid::Build(const float* depth, unsigned int stride, unsigned int width, unsigned int height)
+{
+	//lays the levels out once for each size, halving and rounding up until a single texel is left
+	if (width != _width || height != _height)
+	{
+		_width = width;
+		_height = height;
+		_levelWidths.clear();
+		_levelHeights.clear();
+		_levelOffsets.clear();
+
+		size_t texelCount = 0;
+		unsigned int levelWidth = width;
+		unsigned int levelHeight = height;
+		do
+		{
+			levelWidth = (levelWidth + 1) / 2;
+			levelHeight = (levelHeight + 1) / 2;
+			_levelWidths.push_back(levelWidth);
+			_levelHeights.push_back(levelHeight);
+			_levelOffsets.push_back(texelCount);
+			texelCount += static_cast<size_t>(levelWidth) * levelHeight;
+		} while (levelWidth > 1 || levelHeight > 1);
+
+		_texels.resize(texelCount);
+	}
+
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+
+	//each level takes the furthest of each 2x2 block of the one before, the first from the depth buffer itself.
+	//a block that runs off the right or bottom edge only looks at the values that are there
+	const float* source = depth;
+	unsigned int sourceStride = stride;
+	unsigned int sourceWidth = width;
+	unsigned int sourceHeight = height;
+
+	for (size_t level = 0; level < _levelOffsets.size(); level++)
+	{
+		float* destination = &_texels[_levelOffsets[level]];
+		unsigned int levelWidth = _levelWidths[level];
+		unsigned int levelHeight = _levelHeights[level];
+
+		for (unsigned int y = 0; y < levelHeight; y++)
+		{
+			const float* row0 = source + static_cast<size_t>(y * 2) * sourceStride;
+			const float* row1 = y * 2 + 1 < sourceHeight ? row0 + sourceStride : row0;
+
+			for (unsigned int x = 0; x < levelWidth; x++)
+			{
+				unsigned int x0 = x * 2;
+				unsigned int x1 = x0 + 1 < sourceWidth ? x0 + 1 : x0;
+
+				float a = row0[x0] < row0[x1] ? row0[x0] : row0[x1];
+				float b = row1[x0] < row1[x1] ? row1[x0] : row1[x1];
+				destination[static_cast<size_t>(y) * levelWidth + x] = a < b ? a : b;
+			}
+		}
+
+		source = destination;
+		sourceStride = levelWidth;
+		sourceWidth = levelWidth;
+		sourceHeight = levelHeight;
+	}
+}
+
+bool DepthPyramid::IsOccluded(int minX, int minY, int maxX, int maxY, float nearestReciprocalW) const
+{
+	if (_texels.empty() || _width == 0 || _height == 0)
+	{
+		return false;
+	}
+
+	//only the part on the screen can be drawn, and a rectangle wholly off it is left to the frustum test
+	minX = minX > 0 ? minX : 0;
+	minY = minY > 0 ? minY : 0;
+	maxX = maxX < static_cast<int>(_width) - 1 ? maxX : static_cast<int>(_width) - 1;
+	maxY = maxY < static_cast<int>(_height) - 1 ? maxY : static_cast<int>(_height) - 1;
+	if (minX > maxX || minY > maxY)
+	{
+		return false;
+	}
+
+	//climbs to the first level where the rectangle covers no more than 2 texels across and down
+	size_t level = 0;
+	int texelMinX = minX >> 1, texelMaxX = maxX >> 1;
+	int texelMinY = minY >> 1, texelMaxY = maxY >> 1;
+	while (level + 1 < _levelOffsets.size() && (texelMaxX - texelMinX > 1 || texelMaxY - texelMinY > 1))
+	{
+		level++;
+		texelMinX >>= 1;
+		texelMaxX >>= 1;
+		texelMinY >>= 1;
+		texelMaxY >>= 1;
+	}
+
+	//hidden only if every covered texel has something drawn nearer than the nearest point, matching the depth test that
+	//rejects a pixel whose 1/w is not greater than the one already there
+	const float* texels = &_texels[_levelOffsets[level]];
+	unsigned int levelWidth = _levelWidths[level];
+	for (int y = texelMinY; y <= texelMaxY; y++)
+	{
+		for (int x = texelMinX; x <= texelMaxX; x++)
+		{
+			if (nearestReciprocalW > texels[static_cast<size_t>(y) * levelWidth + x])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+size_t DepthPyramid::GetLevelCount() const
+{
+	return _levelOffsets.size();
+}
+
+unsigned int DepthPyramid::GetLevelWidth(size_t level) const
+{
+	return _levelWidths[level];
+}
+
+unsigned int DepthPyramid::GetLevelHeight(size_t level) const
+{
+	return _levelHeights[level];
+}
+
+const float* DepthPyramid::GetLevel(size_t level) const
+{
+	return &_texels[_levelOffsets[level]];
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/*
+A hierarchical depth buffer, for rejecting whole models that are hidden behind what has
+already been drawn without transforming, lighting or filling any of them.
+
+The depth buffer holds 1/w, so larger values are nearer. Each texel of the first level holds
+the smallest 1/w, the furthest depth, of a 2x2 block of pixels, and each level after that
+the smallest of a 2x2 block of texels in the level before, down to a single texel. A
+rectangle of the screen is hidden from anything no nearer than its texel in whichever
+level covers the rectangle with no more than 2x2 texels, so a test reads at most 4 values
+however large the rectangle is.
+
+Pixels nothing has been drawn on hold 0, so they never hide anything, and the furthest
+depth of a block covers every pixel in it. The test is therefore conservative: a model it
+rejects could not have put a single pixel through the depth test, while a model partly
+behind something may still be drawn.
+*/
+
+class DepthPyramid
+{
+public:
+	DepthPyramid();
+
+	/*
+	Builds every level from the depth buffer, which is width by height pixels with rows stride floats apart.
+	The memory is only reallocated when the size changes
+	*/
+
+	void Build(const float* depth, unsigned int stride, unsigned int width, unsigned int height);
+
+	/*
+	Checks whether everything within the rectangle of pixels, inclusive, with no point nearer than the given 1/w,
+	would fail the depth test against the buffer the pyramid was built from. Parts of the rectangle off the screen
+	are ignored
+	*/
+
+	bool IsOccluded(int minX, int minY, int maxX, int maxY, float nearestReciprocalW) const;
+
+	/*
+	Accesses the number of levels, and the size and texels of each one
+	*/
+
+	size_t GetLevelCount() const;
+	unsigned int GetLevelWidth(size_t level) const;
+	unsigned int GetLevelHeight(size_t level) const;
+	const float* GetLevel(size_t level) const;
+
+private:
+
+	/*
+	The size of the buffer the pyramid was built from, and the size and start of each level within one array of texels
+	*/
+
+	unsigned int _width;
+	unsigned int _height;
+
+	std::vector<unsigned int> _levelWidths;
+	std::vector<unsigned int> _levelHeights;
+	std::vector<size_t> _levelOffsets;
+	std::vector<float> _texels;
+};
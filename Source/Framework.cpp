@@ -1,4 +1,6 @@
 #include "Framework.h"
+#include <cstddef>
+#include <cstdio>
 
 const unsigned int DEFAULT_FRAMERATE = 30;
 
@@ -11,6 +13,8 @@ Framework *	_thisFramework = NULL;
 
 bool isInitialised = false;
 
+#ifdef _WIN32
+
 // Forward declaration of our window procedure
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
@@ -31,12 +35,18 @@ int APIENTRY wWinMain(_In_	   HINSTANCE hInstance,
 	return -1;
 }
 
+#endif
+
 Framework::Framework() : Framework(800, 600)
 {
 }
 
 Framework::Framework(unsigned int width, unsigned int height)
+#ifdef _WIN32
 	: _hInstance(0), _hWnd(0), _width(width), _height(height)
+#else
+	: _width(width), _height(height)
+#endif
 {
 	_thisFramework = this;
 }
@@ -45,6 +55,8 @@ Framework::~Framework()
 {
 }
 
+#ifdef _WIN32
+
 int Framework::Run(HINSTANCE hInstance, int nCmdShow)
 {
 	int returnValue;
@@ -127,6 +139,8 @@ int Framework::MainLoop()
 	return static_cast<int>(msg.wParam);
 }
 
+#endif
+
 // Initialise the application.  Called after the window and bitmap has been
 // created, but before the main loop starts
 //
@@ -152,7 +166,24 @@ void Framework::Update(const Bitmap &bitmap)
 void Framework::Render(const Bitmap &bitmap)
 {
 	// Default render method just sets the background to the default window colour
+#ifdef _WIN32
 	bitmap.Clear(reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1));
+#else
+	bitmap.Clear(RGB(255, 255, 255));
+#endif
+}
+
+// Report an error and close the window, which ends the main loop.
+// Without a window the message is written to stderr instead
+
+void Framework::Close(const char* message)
+{
+#ifdef _WIN32
+	MessageBoxA(_hWnd, message, "Rasteriser", MB_OK | MB_ICONERROR);
+	DestroyWindow(_hWnd);
+#else
+	fprintf(stderr, "%s\n", message);
+#endif
 }
 
 // Perform any application shutdown that is needed
@@ -161,6 +192,8 @@ void Framework::Shutdown()
 {
 }
 
+#ifdef _WIN32
+
 // Register the  window class, create the window and
 // create the bitmap that we will use for rendering
 
@@ -273,3 +306,4 @@ LRESULT Framework::MsgProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam
 	return 0;
 }
 
+#endif
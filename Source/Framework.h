@@ -1,5 +1,5 @@
 #pragma once
-#include <windows.h>
+#include "Platform.h"
 #include "Resource.h"
 #include "Bitmap.h"
 
@@ -12,26 +12,35 @@ public:
 	Framework(unsigned int width, unsigned int height);
 	virtual ~Framework();
 
+#ifdef _WIN32
 	int Run(HINSTANCE hInstance, int nCmdShow);
 
 	LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+#endif
 
 	virtual bool Initialise();
 	virtual void Update(const Bitmap &bitmap);
 	virtual void Render(const Bitmap &bitmap);
 	virtual void Shutdown();
 
+protected:
+	void Close(const char* message);
+
 private:
+#ifdef _WIN32
 	HINSTANCE		_hInstance;
 	HWND			_hWnd;
 	Bitmap			_bitmap;
+#endif
 	unsigned int	_width;
 	unsigned int	_height;
 
 	// Used in timing loop
 	double			_timeSpan{ 0 };
 
+#ifdef _WIN32
 	bool InitialiseMainWindow(int nCmdShow);
 	int MainLoop();
+#endif
 };
 
@@ -0,0 +1,105 @@
+#include "Frustum.h"
+#include <cmath>
+
+const int Frustum::PlaneCount;
+
+Frustum::Frustum()
+{
+	//planes of 0x + 0y + 0z + 1 hold every point
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		_planes[i][0] = 0;
+		_planes[i][1] = 0;
+		_planes[i][2] = 0;
+		_planes[i][3] = 1;
+	}
+}
+
+Frustum::Frustum(const Matrix& clipMatrix, float nearW, float farW)
+{
+	//a point is inside when -w <= x <= w and -w <= y <= w, so each side is the w row of the matrix plus or minus the x or y row
+	for (int column = 0; column < 4; column++)
+	{
+		float x = clipMatrix.GetM(0, column);
+		float y = clipMatrix.GetM(1, column);
+		float w = clipMatrix.GetM(3, column);
+
+		_planes[0][column] = w + x;
+		_planes[1][column] = w - x;
+		_planes[2][column] = w + y;
+		_planes[3][column] = w - y;
+		_planes[4][column] = w;
+		_planes[5][column] = farW > 0 ? -w : 0;
+	}
+
+	//w >= nearW and w <= farW
+	_planes[4][3] -= nearW;
+	_planes[5][3] = farW > 0 ? _planes[5][3] + farW : 1;
+}
+
+FrustumTest Frustum::TestSphere(const Vector3D& centre, float radius) const
+{
+	FrustumTest result = FrustumTest::Inside;
+
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		const float* plane = _planes[i];
+
+		//the distance to the plane and the radius are both left scaled by the length of the plane's normal
+		float distance = plane[0] * centre.GetX() + plane[1] * centre.GetY() + plane[2] * centre.GetZ() + plane[3];
+		float reach = radius * sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+
+		if (distance < -reach)
+		{
+			return FrustumTest::Outside;
+		}
+		if (distance < reach)
+		{
+			result = FrustumTest::Intersecting;
+		}
+	}
+
+	return result;
+}
+
+FrustumTest Frustum::TestBox(const Vector3D& minimum, const Vector3D& maximum) const
+{
+	FrustumTest result = FrustumTest::Inside;
+
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		const float* plane = _planes[i];
+
+		//the corner furthest along the normal is the last to leave the plane's inside, and the corner furthest against it the first
+		float furthest = plane[3];
+		float nearest = plane[3];
+		furthest += plane[0] * (plane[0] > 0 ? maximum.GetX() : minimum.GetX());
+		furthest += plane[1] * (plane[1] > 0 ? maximum.GetY() : minimum.GetY());
+		furthest += plane[2] * (plane[2] > 0 ? maximum.GetZ() : minimum.GetZ());
+		nearest += plane[0] * (plane[0] > 0 ? minimum.GetX() : maximum.GetX());
+		nearest += plane[1] * (plane[1] > 0 ? minimum.GetY() : maximum.GetY());
+		nearest += plane[2] * (plane[2] > 0 ? minimum.GetZ() : maximum.GetZ());
+
+		if (furthest < 0)
+		{
+			return FrustumTest::Outside;
+		}
+		if (nearest < 0)
+		{
+			result = FrustumTest::Intersecting;
+		}
+	}
+
+	return result;
+}
+
+FrustumTest Frustum::TestBounds(const Vector3D& minimum, const Vector3D& maximum, const Vector3D& centre, float radius) const
+{
+	FrustumTest result = TestSphere(centre, radius);
+	if (result != FrustumTest::Intersecting)
+	{
+		return result;
+	}
+
+	return TestBox(minimum, maximum);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Matrix.h"
+#include "Vector3D.h"
+
+/*
+Where a bounding volume lies against the view: entirely outside it, crossing one or more of
+its planes, or entirely inside
+*/
+
+enum class FrustumTest
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+/*
+The six planes of the view, taken from the matrix that takes a point to clip space, so that
+whole models can be rejected from their bounds before any of their vertices are transformed.
+
+The sides are the planes where x or y equals w in clip space. The projection here copies z into
+w, so it has no depth range of its own, and the near and far planes are instead placed at the
+given values of w. When the matrix includes the model transformation, the planes come out in
+the model's own space and its bounds can be tested as they were loaded, with the box tested
+as the box it becomes once transformed rather than a looser box around that.
+
+Neither test divides by the length of a plane's normal, so a transformation that flattens the
+model, such as a scale of 0, still gives an answer.
+*/
+
+class Frustum
+{
+public:
+
+	/*
+	Creates a frustum that contains everything
+	*/
+
+	Frustum();
+
+	/*
+	Takes the planes from the clip matrix, with the near plane at nearW and the far plane at farW,
+	or no far plane when farW is 0
+	*/
+
+	Frustum(const Matrix& clipMatrix, float nearW, float farW);
+
+	/*
+	Tests a sphere and an axis aligned box against the planes. The sphere is cheaper to test,
+	while the box fits models that are much longer than they are wide more closely
+	*/
+
+	FrustumTest TestSphere(const Vector3D& centre, float radius) const;
+	FrustumTest TestBox(const Vector3D& minimum, const Vector3D& maximum) const;
+
+	/*
+	Tests the sphere first, and only tests the box when the sphere crosses a plane
+	*/
+
+	FrustumTest TestBounds(const Vector3D& minimum, const Vector3D& maximum, const Vector3D& centre, float radius) const;
+
+private:
+	static const int PlaneCount = 6;
+
+	/*
+	Each plane as a, b, c and d, with points where ax + by + cz + d >= 0 on the inside
+	*/
+
+	float _planes[PlaneCount][4];
+};
@@ -0,0 +1,364 @@
+#include "HalfSpaceRasteriser.h"
+#include "Bitmap.h"
+#include <cmath>
+#include <cstdint>
+
+// Vertices are snapped to 1/16th of a pixel
+const int SUBPIXEL_BITS = 4;
+const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+// Width and height of the blocks of pixels that are accepted or rejected as a whole
+const int BLOCK_SIZE = 8;
+
+// Coordinates further than this from the origin cannot be held in the fixed point edge
+// functions without overflowing, so triangles that reach them are not drawn
+const float MAX_COORDINATE = 1.0e7f;
+
+/*
+Edge function of one side of a triangle, in fixed point. Evaluate gives a value that is
+>= 0 when the centre of pixel (x, y) is inside the edge and < 0 when it is outside.
+*/
+
+struct Edge
+{
+	int64_t stepX;
+	int64_t stepY;
+	int64_t origin;
+
+	// Smallest and largest amount the value changes by across a block
+	int64_t blockMin;
+	int64_t blockMax;
+
+	int64_t Evaluate(int x, int y) const
+	{
+		return origin + stepX * x + stepY * y;
+	}
+};
+
+/*
+A value interpolated linearly in screen space across the triangle.
+Evaluate gives the value at the centre of pixel (x, y).
+*/
+
+struct Plane
+{
+	float stepX;
+	float stepY;
+	float origin;
+
+	float Evaluate(int x, int y) const
+	{
+		return origin + stepX * x + stepY * y;
+	}
+};
+
+/*
+Everything worked out once per triangle before any pixels are visited
+*/
+
+struct TriangleSetup
+{
+	Edge edges[3];
+
+	Plane red;
+	Plane green;
+	Plane blue;
+	Plane uOverZ;
+	Plane vOverZ;
+	Plane zReciprocal;
+
+	int minX;
+	int minY;
+	int maxX;
+	int maxY;
+};
+
+/*
+Each shading mode returns the colour of a pixel, in the layout used by the pixel memory,
+from the interpolants at the centre of that pixel
+*/
+
+struct FlatShader
+{
+	unsigned int pixel;
+
+	unsigned int operator()(const TriangleSetup& /*setup*/, int /*x*/, int /*y*/, float /*zr*/) const
+	{
+		return pixel;
+	}
+};
+
+struct GouraudShader
+{
+	unsigned int operator()(const TriangleSetup& setup, int x, int y, float /*zr*/) const
+	{
+		return Bitmap::ToPixel((int)setup.red.Evaluate(x, y), (int)setup.green.Evaluate(x, y), (int)setup.blue.Evaluate(x, y));
+	}
+};
+
+struct TexturedShader
+{
+	const TextureLevel * level;
+
+	unsigned int operator()(const TriangleSetup& setup, int x, int y, float zr) const
+	{
+		//convert u/z and v/z back to UV coords, scaled from the first level to this one
+		int u = (int)(setup.uOverZ.Evaluate(x, y) / zr * level->uScale);
+		int v = (int)(setup.vOverZ.Evaluate(x, y) / zr * level->vScale);
+
+		u = u < 0 ? 0 : (u >= level->width ? level->width - 1 : u);
+		v = v < 0 ? 0 : (v >= level->height ? level->height - 1 : v);
+		return level->texels[v * level->width + u];
+	}
+};
+
+// Builds the fixed point edge function from a to b. Pixels exactly on the edge are only
+// inside it if it is a top edge (horizontal with the triangle below) or a left edge.
+
+static void SetupEdge(Edge& edge, int64_t ax, int64_t ay, int64_t bx, int64_t by)
+{
+	int64_t deltaX = bx - ax;
+	int64_t deltaY = by - ay;
+
+	bool isTopLeft = (deltaY == 0 && deltaX > 0) || deltaY < 0;
+
+	edge.stepX = -deltaY * SUBPIXEL_ONE;
+	edge.stepY = deltaX * SUBPIXEL_ONE;
+	edge.origin = deltaX * (SUBPIXEL_ONE / 2 - ay) - deltaY * (SUBPIXEL_ONE / 2 - ax) + (isTopLeft ? 0 : -1);
+
+	int64_t blockStepX = edge.stepX * (BLOCK_SIZE - 1);
+	int64_t blockStepY = edge.stepY * (BLOCK_SIZE - 1);
+	edge.blockMin = (blockStepX < 0 ? blockStepX : 0) + (blockStepY < 0 ? blockStepY : 0);
+	edge.blockMax = (blockStepX > 0 ? blockStepX : 0) + (blockStepY > 0 ? blockStepY : 0);
+}
+
+// Builds the plane passing through the values f0, f1, f2 at the three vertices
+
+static void SetupPlane(Plane& plane, float x0, float y0, float x1, float y1, float x2, float y2, float f0, float f1, float f2, float inverseArea)
+{
+	plane.stepX = ((f1 - f0) * (y2 - y0) - (f2 - f0) * (y1 - y0)) * inverseArea;
+	plane.stepY = ((f2 - f0) * (x1 - x0) - (f1 - f0) * (x2 - x0)) * inverseArea;
+	plane.origin = f0 + plane.stepX * (0.5f - x0) + plane.stepY * (0.5f - y0);
+}
+
+// Works out the edges, interpolant planes and bounding box of a triangle
+//
+// Returns false if the triangle has no area or does not touch the target
+
+static bool SetupTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, TriangleSetup& setup)
+{
+	const Vertex * vertices[3] = { &vertex1, &vertex2, &vertex3 };
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(fabs(vertices[i]->GetX()) < MAX_COORDINATE && fabs(vertices[i]->GetY()) < MAX_COORDINATE))
+		{
+			return false;
+		}
+	}
+
+	//snaps the vertices to the sub-pixel grid
+	int64_t fixedX[3];
+	int64_t fixedY[3];
+	for (int i = 0; i < 3; i++)
+	{
+		fixedX[i] = (int64_t)floor(vertices[i]->GetX() * SUBPIXEL_ONE + 0.5f);
+		fixedY[i] = (int64_t)floor(vertices[i]->GetY() * SUBPIXEL_ONE + 0.5f);
+	}
+
+	//works out twice the signed area, swapping two vertices so that the inside of every edge is positive
+	int64_t area = (fixedX[1] - fixedX[0]) * (fixedY[2] - fixedY[0]) - (fixedY[1] - fixedY[0]) * (fixedX[2] - fixedX[0]);
+	if (area == 0)
+	{
+		return false;
+	}
+	if (area < 0)
+	{
+		const Vertex * vertexTemp = vertices[1];
+		vertices[1] = vertices[2];
+		vertices[2] = vertexTemp;
+
+		int64_t fixedTemp = fixedX[1];
+		fixedX[1] = fixedX[2];
+		fixedX[2] = fixedTemp;
+
+		fixedTemp = fixedY[1];
+		fixedY[1] = fixedY[2];
+		fixedY[2] = fixedTemp;
+
+		area = -area;
+	}
+
+	//finds the pixels the triangle can cover, limited to the target
+	int64_t minFixedX = fixedX[0] < fixedX[1] ? (fixedX[0] < fixedX[2] ? fixedX[0] : fixedX[2]) : (fixedX[1] < fixedX[2] ? fixedX[1] : fixedX[2]);
+	int64_t maxFixedX = fixedX[0] > fixedX[1] ? (fixedX[0] > fixedX[2] ? fixedX[0] : fixedX[2]) : (fixedX[1] > fixedX[2] ? fixedX[1] : fixedX[2]);
+	int64_t minFixedY = fixedY[0] < fixedY[1] ? (fixedY[0] < fixedY[2] ? fixedY[0] : fixedY[2]) : (fixedY[1] < fixedY[2] ? fixedY[1] : fixedY[2]);
+	int64_t maxFixedY = fixedY[0] > fixedY[1] ? (fixedY[0] > fixedY[2] ? fixedY[0] : fixedY[2]) : (fixedY[1] > fixedY[2] ? fixedY[1] : fixedY[2]);
+
+	setup.minX = (int)((minFixedX >> SUBPIXEL_BITS) > target.minX ? (minFixedX >> SUBPIXEL_BITS) : target.minX);
+	setup.minY = (int)((minFixedY >> SUBPIXEL_BITS) > target.minY ? (minFixedY >> SUBPIXEL_BITS) : target.minY);
+	setup.maxX = (int)((maxFixedX >> SUBPIXEL_BITS) < target.maxX ? (maxFixedX >> SUBPIXEL_BITS) : target.maxX);
+	setup.maxY = (int)((maxFixedY >> SUBPIXEL_BITS) < target.maxY ? (maxFixedY >> SUBPIXEL_BITS) : target.maxY);
+
+	if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+	{
+		return false;
+	}
+
+	//edge opposite each vertex
+	SetupEdge(setup.edges[0], fixedX[1], fixedY[1], fixedX[2], fixedY[2]);
+	SetupEdge(setup.edges[1], fixedX[2], fixedY[2], fixedX[0], fixedY[0]);
+	SetupEdge(setup.edges[2], fixedX[0], fixedY[0], fixedX[1], fixedY[1]);
+
+	//sets up every interpolant from the snapped positions
+	float x0 = (float)fixedX[0] / SUBPIXEL_ONE;
+	float y0 = (float)fixedY[0] / SUBPIXEL_ONE;
+	float x1 = (float)fixedX[1] / SUBPIXEL_ONE;
+	float y1 = (float)fixedY[1] / SUBPIXEL_ONE;
+	float x2 = (float)fixedX[2] / SUBPIXEL_ONE;
+	float y2 = (float)fixedY[2] / SUBPIXEL_ONE;
+	float inverseArea = (float)(SUBPIXEL_ONE * SUBPIXEL_ONE) / (float)area;
+
+	COLORREF colour0 = vertices[0]->GetVertexRGB();
+	COLORREF colour1 = vertices[1]->GetVertexRGB();
+	COLORREF colour2 = vertices[2]->GetVertexRGB();
+
+	SetupPlane(setup.red, x0, y0, x1, y1, x2, y2, GetRValue(colour0), GetRValue(colour1), GetRValue(colour2), inverseArea);
+	SetupPlane(setup.green, x0, y0, x1, y1, x2, y2, GetGValue(colour0), GetGValue(colour1), GetGValue(colour2), inverseArea);
+	SetupPlane(setup.blue, x0, y0, x1, y1, x2, y2, GetBValue(colour0), GetBValue(colour1), GetBValue(colour2), inverseArea);
+	SetupPlane(setup.uOverZ, x0, y0, x1, y1, x2, y2, vertices[0]->GetUOZ(), vertices[1]->GetUOZ(), vertices[2]->GetUOZ(), inverseArea);
+	SetupPlane(setup.vOverZ, x0, y0, x1, y1, x2, y2, vertices[0]->GetVOZ(), vertices[1]->GetVOZ(), vertices[2]->GetVOZ(), inverseArea);
+	SetupPlane(setup.zReciprocal, x0, y0, x1, y1, x2, y2, vertices[0]->GetZR(), vertices[1]->GetZR(), vertices[2]->GetZR(), inverseArea);
+
+	return true;
+}
+
+// Depth tests and shades a single pixel known to be inside the triangle
+
+template <typename Shader>
+static inline void ShadePixel(const TriangleSetup& setup, const Shader& shader, unsigned int * row, float * depthRow, int x, int y)
+{
+	float zr = setup.zReciprocal.Evaluate(x, y);
+
+	//skips the pixel if something nearer has already been drawn there
+	if (depthRow != nullptr)
+	{
+		if (zr <= depthRow[x])
+		{
+			return;
+		}
+		depthRow[x] = zr;
+	}
+
+	row[x] = shader(setup, x, y, zr);
+}
+
+// Visits every 8x8 block of the triangle's bounding box, rejecting, accepting or
+// testing each pixel of the block against the edges
+
+template <typename Shader>
+static void RasteriseTriangle(const RenderTarget& target, const TriangleSetup& setup, const Shader& shader)
+{
+	int firstBlockX = setup.minX - (setup.minX % BLOCK_SIZE);
+	int firstBlockY = setup.minY - (setup.minY % BLOCK_SIZE);
+
+	for (int blockY = firstBlockY; blockY <= setup.maxY; blockY += BLOCK_SIZE)
+	{
+		int startY = blockY > setup.minY ? blockY : setup.minY;
+		int endY = blockY + BLOCK_SIZE - 1 < setup.maxY ? blockY + BLOCK_SIZE - 1 : setup.maxY;
+
+		for (int blockX = firstBlockX; blockX <= setup.maxX; blockX += BLOCK_SIZE)
+		{
+			int startX = blockX > setup.minX ? blockX : setup.minX;
+			int endX = blockX + BLOCK_SIZE - 1 < setup.maxX ? blockX + BLOCK_SIZE - 1 : setup.maxX;
+
+			//tests the corners of the block against each edge
+			bool rejected = false;
+			bool accepted = true;
+			for (int i = 0; i < 3; i++)
+			{
+				int64_t corner = setup.edges[i].Evaluate(blockX, blockY);
+				if (corner + setup.edges[i].blockMax < 0)
+				{
+					rejected = true;
+					break;
+				}
+				if (corner + setup.edges[i].blockMin < 0)
+				{
+					accepted = false;
+				}
+			}
+
+			if (rejected)
+			{
+				continue;
+			}
+
+			for (int y = startY; y <= endY; y++)
+			{
+				unsigned int * row = target.pixels + y * target.stride;
+				float * depthRow = target.depth != nullptr ? target.depth + y * target.stride : nullptr;
+
+				if (accepted)
+				{
+					//whole block is inside the triangle
+					for (int x = startX; x <= endX; x++)
+					{
+						ShadePixel(setup, shader, row, depthRow, x, y);
+					}
+				}
+				else
+				{
+					//block straddles an edge so each pixel is tested, stepping the edge functions along the row
+					int64_t edge0 = setup.edges[0].Evaluate(startX, y);
+					int64_t edge1 = setup.edges[1].Evaluate(startX, y);
+					int64_t edge2 = setup.edges[2].Evaluate(startX, y);
+
+					for (int x = startX; x <= endX; x++)
+					{
+						if ((edge0 | edge1 | edge2) >= 0)
+						{
+							ShadePixel(setup, shader, row, depthRow, x, y);
+						}
+
+						edge0 += setup.edges[0].stepX;
+						edge1 += setup.edges[1].stepX;
+						edge2 += setup.edges[2].stepX;
+					}
+				}
+			}
+		}
+	}
+}
+
+void HalfSpaceRasteriser::FillFlat(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& colour)
+{
+	TriangleSetup setup;
+	if (SetupTriangle(target, vertex1, vertex2, vertex3, setup))
+	{
+		FlatShader shader;
+		shader.pixel = Bitmap::ToPixel(colour);
+		RasteriseTriangle(target, setup, shader);
+	}
+}
+
+void HalfSpaceRasteriser::FillGouraud(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3)
+{
+	TriangleSetup setup;
+	if (SetupTriangle(target, vertex1, vertex2, vertex3, setup))
+	{
+		GouraudShader shader;
+		RasteriseTriangle(target, setup, shader);
+	}
+}
+
+void HalfSpaceRasteriser::FillTextured(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level)
+{
+	TriangleSetup setup;
+	if (SetupTriangle(target, vertex1, vertex2, vertex3, setup))
+	{
+		TexturedShader shader;
+		shader.level = &level;
+		RasteriseTriangle(target, setup, shader);
+	}
+}
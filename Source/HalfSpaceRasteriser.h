@@ -0,0 +1,27 @@
+#pragma once
+#include "Vertex.h"
+#include "Texture.h"
+#include "RenderTarget.h"
+
+/*
+Fills triangles by evaluating the three edge functions of the triangle incrementally
+over 8x8 blocks of pixels. Blocks entirely outside an edge are skipped, blocks entirely
+inside all edges are filled without any per-pixel edge tests, and only the blocks on
+the boundary test each pixel.
+
+Vertices are snapped to 1/16th of a pixel and pixels are sampled at their centres using
+the top-left fill rule, so triangles that share an edge never leave gaps or draw the
+same pixel twice. Colour, u/z, v/z and 1/z are all set up as planes across the triangle
+in one place, and each shading mode only evaluates the ones it needs.
+
+The vertices are expected to be in screen space, with the 1/w value set (and u/z, v/z
+when texturing) and may be in either winding order.
+*/
+
+class HalfSpaceRasteriser
+{
+public:
+	static void FillFlat(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& colour);
+	static void FillGouraud(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3);
+	static void FillTextured(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level);
+};
@@ -0,0 +1,229 @@
+#include "ImageWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+//largest amount of data a stored (uncompressed) deflate block can hold
+const size_t MaxStoredBlock = 65535;
+
+//most bytes the Adler-32 sums can take before they must be reduced to stay within 32 bits
+const size_t MaxAdlerRun = 5552;
+
+//table for the CRC-32 used by PNG chunks, built the first time it is needed
+struct CrcTable
+{
+	unsigned int values[256];
+
+	CrcTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int crc = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+			}
+			values[i] = crc;
+		}
+	}
+};
+
+static const unsigned int* GetCrcTable()
+{
+	static const CrcTable table;
+	return table.values;
+}
+
+bool ImageWriter::Write(const char* filename, const Bitmap& bitmap, ImageFormat format)
+{
+	if (bitmap.GetPixels() == nullptr)
+	{
+		return false;
+	}
+
+	switch (format)
+	{
+	case ImageFormat::PPM:
+		return WritePPM(filename, bitmap);
+	case ImageFormat::PNG:
+		return WritePNG(filename, bitmap);
+	case ImageFormat::Raw:
+		return WriteRaw(filename, bitmap);
+	}
+
+	return false;
+}
+
+bool ImageWriter::WritePPM(const char* filename, const Bitmap& bitmap)
+{
+	unsigned int width = bitmap.GetWidth();
+	unsigned int height = bitmap.GetHeight();
+
+	char header[64];
+	int headerLength = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+
+	//the header is followed by the rows top to bottom, 3 bytes per pixel
+	_file.resize(headerLength + static_cast<size_t>(width) * height * 3);
+	memcpy(_file.data(), header, headerLength);
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		ConvertRow(bitmap, y, _file.data() + headerLength + static_cast<size_t>(y) * width * 3);
+	}
+
+	return WriteFile(filename, _file.data(), _file.size());
+}
+
+bool ImageWriter::WritePNG(const char* filename, const Bitmap& bitmap)
+{
+	unsigned int width = bitmap.GetWidth();
+	unsigned int height = bitmap.GetHeight();
+
+	//each scanline starts with a filter type byte, which is 0 for no filtering
+	size_t rowLength = 1 + static_cast<size_t>(width) * 3;
+	_scanlines.resize(rowLength * height);
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		unsigned char* row = _scanlines.data() + y * rowLength;
+		row[0] = 0;
+		ConvertRow(bitmap, y, row + 1);
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	_file.clear();
+	_file.insert(_file.end(), signature, signature + 8);
+
+	//8 bit RGB, no interlacing
+	size_t chunk = BeginChunk("IHDR");
+	AppendBigEndian(width);
+	AppendBigEndian(height);
+	_file.push_back(8);
+	_file.push_back(2);
+	_file.push_back(0);
+	_file.push_back(0);
+	_file.push_back(0);
+	EndChunk(chunk);
+
+	//the image data is a zlib stream made of stored deflate blocks, followed by the Adler-32 of the scanlines
+	chunk = BeginChunk("IDAT");
+	_file.push_back(0x78);
+	_file.push_back(0x01);
+
+	size_t remaining = _scanlines.size();
+	const unsigned char* source = _scanlines.data();
+	do
+	{
+		size_t blockLength = remaining < MaxStoredBlock ? remaining : MaxStoredBlock;
+		remaining -= blockLength;
+
+		_file.push_back(remaining == 0 ? 1 : 0);
+		_file.push_back(static_cast<unsigned char>(blockLength & 0xFF));
+		_file.push_back(static_cast<unsigned char>(blockLength >> 8));
+		_file.push_back(static_cast<unsigned char>(~blockLength & 0xFF));
+		_file.push_back(static_cast<unsigned char>((~blockLength >> 8) & 0xFF));
+		_file.insert(_file.end(), source, source + blockLength);
+		source += blockLength;
+	} while (remaining > 0);
+
+	unsigned int a = 1;
+	unsigned int b = 0;
+	for (size_t i = 0; i < _scanlines.size(); i++)
+	{
+		a += _scanlines[i];
+		b += a;
+		if (i % MaxAdlerRun == MaxAdlerRun - 1)
+		{
+			a %= 65521;
+			b %= 65521;
+		}
+	}
+	a %= 65521;
+	b %= 65521;
+	AppendBigEndian((b << 16) | a);
+	EndChunk(chunk);
+
+	chunk = BeginChunk("IEND");
+	EndChunk(chunk);
+
+	return WriteFile(filename, _file.data(), _file.size());
+}
+
+bool ImageWriter::WriteRaw(const char* filename, const Bitmap& bitmap)
+{
+	//the rows are written as they are, leaving out any padding at the end of each one
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	for (unsigned int y = 0; y < bitmap.GetHeight(); y++)
+	{
+		file.write(reinterpret_cast<const char*>(bitmap.GetPixels() + y * bitmap.GetStride()), bitmap.GetWidth() * sizeof(unsigned int));
+	}
+
+	return file.good();
+}
+
+bool ImageWriter::WriteFile(const char* filename, const unsigned char* data, size_t length) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(data), length);
+	return file.good();
+}
+
+void ImageWriter::ConvertRow(const Bitmap& bitmap, unsigned int row, unsigned char* rgb) const
+{
+	//the pixel memory holds 0x00RRGGBB, image files want the bytes in R, G, B order
+	const unsigned int* pixels = bitmap.GetPixels() + row * bitmap.GetStride();
+
+	for (unsigned int x = 0; x < bitmap.GetWidth(); x++)
+	{
+		unsigned int pixel = pixels[x];
+		rgb[0] = static_cast<unsigned char>(pixel >> 16);
+		rgb[1] = static_cast<unsigned char>(pixel >> 8);
+		rgb[2] = static_cast<unsigned char>(pixel);
+		rgb += 3;
+	}
+}
+
+void ImageWriter::AppendBigEndian(unsigned int value)
+{
+	_file.push_back(static_cast<unsigned char>(value >> 24));
+	_file.push_back(static_cast<unsigned char>(value >> 16));
+	_file.push_back(static_cast<unsigned char>(value >> 8));
+	_file.push_back(static_cast<unsigned char>(value));
+}
+
+size_t ImageWriter::BeginChunk(const char* type)
+{
+	//the length is filled in once the data is known
+	size_t start = _file.size();
+	AppendBigEndian(0);
+	_file.insert(_file.end(), type, type + 4);
+	return start;
+}
+
+void ImageWriter::EndChunk(size_t start)
+{
+	unsigned int length = static_cast<unsigned int>(_file.size() - start - 8);
+	_file[start] = static_cast<unsigned char>(length >> 24);
+	_file[start + 1] = static_cast<unsigned char>(length >> 16);
+	_file[start + 2] = static_cast<unsigned char>(length >> 8);
+	_file[start + 3] = static_cast<unsigned char>(length);
+
+	//the CRC covers the chunk type and data, but not the length
+	const unsigned int* table = GetCrcTable();
+	unsigned int crc = 0xFFFFFFFFu;
+	for (size_t i = start + 4; i < _file.size(); i++)
+	{
+		crc = table[(crc ^ _file[i]) & 0xFF] ^ (crc >> 8);
+	}
+	AppendBigEndian(crc ^ 0xFFFFFFFFu);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "Bitmap.h"
+
+/*
+Formats a rendered frame can be saved in.
+
+PPM is a binary (P6) RGB image that almost every image tool can read.
+PNG is written with uncompressed deflate blocks, so it needs no compression library and costs
+little more than the PPM to write, at the price of being no smaller.
+Raw is the pixel memory exactly as it sits in the bitmap, 4 bytes per pixel in 0x00RRGGBB
+order with no header, for tools that already know the frame size.
+*/
+
+enum class ImageFormat
+{
+	PPM,
+	PNG,
+	Raw
+};
+
+/*
+Saves the contents of a bitmap to an image file. The whole file is built in memory and written
+with a single call, and the writer keeps its buffers between calls so that saving frame after
+frame of the same size does not keep resizing them.
+*/
+
+class ImageWriter
+{
+public:
+	bool Write(const char* filename, const Bitmap& bitmap, ImageFormat format);
+
+private:
+	bool WritePPM(const char* filename, const Bitmap& bitmap);
+	bool WritePNG(const char* filename, const Bitmap& bitmap);
+	bool WriteRaw(const char* filename, const Bitmap& bitmap);
+
+	bool WriteFile(const char* filename, const unsigned char* data, size_t length) const;
+	void ConvertRow(const Bitmap& bitmap, unsigned int row, unsigned char* rgb) const;
+
+	/*
+	Helpers to build the PNG in memory. A chunk is started by writing its type, and once its data
+	has been appended the length and CRC are filled in by ending it
+	*/
+
+	void AppendBigEndian(unsigned int value);
+	size_t BeginChunk(const char* type);
+	void EndChunk(size_t start);
+
+	std::vector<unsigned char> _scanlines;
+	std::vector<unsigned char> _file;
+};
@@ -0,0 +1,403 @@
+#include "KeyframeAnimation.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ANIMATION_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ANIMATION_USE_SSE
+#endif
+
+const int KeyframeAnimation::NormalCount;
+
+KeyframeAnimation::KeyframeAnimation()
+{
+	_vertexCount = 0;
+	_paddedCount = 0;
+
+	//spreads the directions evenly over the sphere along a spiral, stepping round by the golden angle
+	const float goldenAngle = 2.39996323f;
+	for (int i = 0; i < NormalCount; i++)
+	{
+		float z = 1.0f - (2.0f * i + 1.0f) / NormalCount;
+		float radius = sqrt(1.0f - z * z);
+		float angle = goldenAngle * i;
+
+		_normalX[i] = radius * cos(angle);
+		_normalY[i] = radius * sin(angle);
+		_normalZ[i] = z;
+	}
+}
+
+void KeyframeAnimation::Reset(size_t vertexCount)
+{
+	_vertexCount = vertexCount;
+	_paddedCount = (vertexCount + VertexStream::BatchSize - 1) / VertexStream::BatchSize * VertexStream::BatchSize;
+	_frames.clear();
+	_packed.clear();
+}
+
+void KeyframeAnimation::AddFrame(const char* name, const float scale[3], const float translate[3], const unsigned char* packedVertices, const std::vector<Polygon3D>& polygons)
+{
+	//MD2 has z up, so the y and z of the file are swapped over, as they are for the static vertices
+	FrameInfo frame;
+	size_t nameLength = strlen(name) < sizeof(frame.name) - 1 ? strlen(name) : sizeof(frame.name) - 1;
+	memcpy(frame.name, name, nameLength);
+	frame.name[nameLength] = '\0';
+	frame.scale[0] = scale[0];
+	frame.scale[1] = scale[2];
+	frame.scale[2] = scale[1];
+	frame.translate[0] = translate[0];
+	frame.translate[1] = translate[2];
+	frame.translate[2] = translate[1];
+	_frames.push_back(frame);
+
+	//the padding stays zero, so it decodes to the frame's translation
+	size_t start = _packed.size();
+	_packed.resize(start + _paddedCount * 4, 0);
+	unsigned char* planeX = _packed.data() + start;
+	unsigned char* planeY = planeX + _paddedCount;
+	unsigned char* planeZ = planeY + _paddedCount;
+	unsigned char* planeNormal = planeZ + _paddedCount;
+
+	for (size_t i = 0; i < _vertexCount; i++)
+	{
+		planeX[i] = packedVertices[i * 4];
+		planeY[i] = packedVertices[i * 4 + 2];
+		planeZ[i] = packedVertices[i * 4 + 1];
+	}
+
+	//averages the polygon normals at each vertex, in the frame's own shape
+	std::vector<float> normals(_vertexCount * 3, 0.0f);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		int i0 = polygons[i].GetIndex(0);
+		int i1 = polygons[i].GetIndex(1);
+		int i2 = polygons[i].GetIndex(2);
+
+		float x0 = planeX[i0] * frame.scale[0], y0 = planeY[i0] * frame.scale[1], z0 = planeZ[i0] * frame.scale[2];
+		float ax = x0 - planeX[i1] * frame.scale[0], ay = y0 - planeY[i1] * frame.scale[1], az = z0 - planeZ[i1] * frame.scale[2];
+		float bx = x0 - planeX[i2] * frame.scale[0], by = y0 - planeY[i2] * frame.scale[1], bz = z0 - planeZ[i2] * frame.scale[2];
+
+		float nx = ay * bz - az * by;
+		float ny = az * bx - ax * bz;
+		float nz = ax * by - ay * bx;
+
+		//degenerate polygons have no direction to contribute
+		float length = sqrt(nx * nx + ny * ny + nz * nz);
+		if (length == 0)
+		{
+			continue;
+		}
+
+		int indices[3] = { i0, i1, i2 };
+		for (int j = 0; j < 3; j++)
+		{
+			normals[indices[j] * 3] += nx / length;
+			normals[indices[j] * 3 + 1] += ny / length;
+			normals[indices[j] * 3 + 2] += nz / length;
+		}
+	}
+
+	for (size_t i = 0; i < _vertexCount; i++)
+	{
+		planeNormal[i] = FindClosestNormal(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+	}
+}
+
+int KeyframeAnimation::GetFrameCount() const
+{
+	return static_cast<int>(_frames.size());
+}
+
+size_t KeyframeAnimation::GetVertexCount() const
+{
+	return _vertexCount;
+}
+
+const char* KeyframeAnimation::GetFrameName(int frame) const
+{
+	return _frames[frame].name;
+}
+
+bool KeyframeAnimation::FindSequence(const char* name, int& firstFrame, int& frameCount) const
+{
+	size_t length = strlen(name);
+	firstFrame = -1;
+	frameCount = 0;
+
+	for (int i = 0; i < GetFrameCount(); i++)
+	{
+		//the name must be followed by nothing but the frame number
+		const char* frameName = _frames[i].name;
+		bool match = strncmp(frameName, name, length) == 0 && frameName[length] >= '0' && frameName[length] <= '9';
+		for (const char* c = frameName + length; match && *c != '\0'; c++)
+		{
+			match = *c >= '0' && *c <= '9';
+		}
+
+		if (match)
+		{
+			if (firstFrame < 0)
+			{
+				firstFrame = i;
+			}
+			frameCount++;
+		}
+		else if (firstFrame >= 0)
+		{
+			break;
+		}
+	}
+
+	return frameCount > 0;
+}
+
+void KeyframeAnimation::StartSequence(AnimationState& state, int firstFrame, int frameCount, float framesPerSecond) const
+{
+	state.firstFrame = firstFrame;
+	state.frameCount = frameCount > 0 ? frameCount : 1;
+	state.framesPerSecond = framesPerSecond;
+	state.time = 0.0f;
+}
+
+void KeyframeAnimation::Advance(AnimationState& state, float seconds)
+{
+	state.time = fmod(state.time + seconds * state.framesPerSecond, static_cast<float>(state.frameCount));
+	if (state.time < 0.0f)
+	{
+		state.time += state.frameCount;
+	}
+}
+
+void KeyframeAnimation::GetBlend(const AnimationState& state, int& frameA, int& frameB, float& t)
+{
+	//the last frame of the sequence blends back round into the first
+	int frame = static_cast<int>(state.time);
+	frame = frame < state.frameCount ? frame : state.frameCount - 1;
+	int nextFrame = frame + 1 < state.frameCount ? frame + 1 : 0;
+
+	frameA = state.firstFrame + frame;
+	frameB = state.firstFrame + nextFrame;
+	t = state.time - frame;
+}
+
+void KeyframeAnimation::Interpolate(const AnimationState& state, VertexStream& positions, VertexStream& normals) const
+{
+	int frameA, frameB;
+	float t;
+	GetBlend(state, frameA, frameB, t);
+
+	Interpolate(frameA, frameB, t, positions, normals);
+}
+
+void KeyframeAnimation::Interpolate(int frameA, int frameB, float t, VertexStream& positions, VertexStream& normals) const
+{
+	if (positions.GetCount() != _vertexCount)
+	{
+		//only w needs setting up, as x, y and z are all written below
+		positions.Resize(_vertexCount);
+		float* w = positions.GetW();
+		for (size_t i = 0; i < _vertexCount; i++)
+		{
+			w[i] = 1.0f;
+		}
+	}
+	if (normals.GetCount() != _vertexCount)
+	{
+		normals.Resize(_vertexCount);
+	}
+
+	const FrameInfo& infoA = _frames[frameA];
+	const FrameInfo& infoB = _frames[frameB];
+	const unsigned char* planesA = _packed.data() + frameA * _paddedCount * 4;
+	const unsigned char* planesB = _packed.data() + frameB * _paddedCount * 4;
+
+	//lerping (byte * scale + translate) between the frames gives byteA * ka + byteB * kb + c for each axis
+	float s = 1.0f - t;
+	float ka[3], kb[3], c[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		ka[axis] = infoA.scale[axis] * s;
+		kb[axis] = infoB.scale[axis] * t;
+		c[axis] = infoA.translate[axis] * s + infoB.translate[axis] * t;
+	}
+
+	float* destination[3] = { positions.GetX(), positions.GetY(), positions.GetZ() };
+	float* normalDestination[3] = { normals.GetX(), normals.GetY(), normals.GetZ() };
+	const float* normalTable[3] = { _normalX, _normalY, _normalZ };
+	const unsigned char* normalsA = planesA + _paddedCount * 3;
+	const unsigned char* normalsB = planesB + _paddedCount * 3;
+
+	// The planes and streams are padded to a whole number of batches, so every loop below works on full groups
+#if defined(ANIMATION_USE_AVX2)
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const unsigned char* planeA = planesA + axis * _paddedCount;
+		const unsigned char* planeB = planesB + axis * _paddedCount;
+		__m256 scaleA = _mm256_set1_ps(ka[axis]);
+		__m256 scaleB = _mm256_set1_ps(kb[axis]);
+		__m256 offset = _mm256_set1_ps(c[axis]);
+
+		for (size_t i = 0; i < _paddedCount; i += 8)
+		{
+			__m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planeA + i))));
+			__m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planeB + i))));
+			_mm256_store_ps(destination[axis] + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, scaleA), _mm256_mul_ps(b, scaleB)), offset));
+		}
+	}
+
+	__m256 weightA = _mm256_set1_ps(s);
+	__m256 weightB = _mm256_set1_ps(t);
+	for (size_t i = 0; i < _paddedCount; i += 8)
+	{
+		__m256i indexA = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(normalsA + i)));
+		__m256i indexB = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(normalsB + i)));
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m256 a = _mm256_i32gather_ps(normalTable[axis], indexA, 4);
+			__m256 b = _mm256_i32gather_ps(normalTable[axis], indexB, 4);
+			_mm256_store_ps(normalDestination[axis] + i, _mm256_add_ps(_mm256_mul_ps(a, weightA), _mm256_mul_ps(b, weightB)));
+		}
+	}
+#elif defined(ANIMATION_USE_SSE)
+	__m128i zero = _mm_setzero_si128();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const unsigned char* planeA = planesA + axis * _paddedCount;
+		const unsigned char* planeB = planesB + axis * _paddedCount;
+		__m128 scaleA = _mm_set1_ps(ka[axis]);
+		__m128 scaleB = _mm_set1_ps(kb[axis]);
+		__m128 offset = _mm_set1_ps(c[axis]);
+
+		for (size_t i = 0; i < _paddedCount; i += 8)
+		{
+			//widens 8 bytes to two groups of 4 integers
+			__m128i bytesA = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planeA + i)), zero);
+			__m128i bytesB = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planeB + i)), zero);
+
+			__m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(bytesA, zero));
+			__m128 b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(bytesB, zero));
+			_mm_store_ps(destination[axis] + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, scaleA), _mm_mul_ps(b, scaleB)), offset));
+
+			a = _mm_cvtepi32_ps(_mm_unpackhi_epi16(bytesA, zero));
+			b = _mm_cvtepi32_ps(_mm_unpackhi_epi16(bytesB, zero));
+			_mm_store_ps(destination[axis] + i + 4, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, scaleA), _mm_mul_ps(b, scaleB)), offset));
+		}
+	}
+
+	//SSE2 has no gather, so the normals are looked up one at a time and blended 4 at once
+	__m128 weightA = _mm_set1_ps(s);
+	__m128 weightB = _mm_set1_ps(t);
+	for (size_t i = 0; i < _paddedCount; i += 4)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float* table = normalTable[axis];
+			__m128 a = _mm_set_ps(table[normalsA[i + 3]], table[normalsA[i + 2]], table[normalsA[i + 1]], table[normalsA[i]]);
+			__m128 b = _mm_set_ps(table[normalsB[i + 3]], table[normalsB[i + 2]], table[normalsB[i + 1]], table[normalsB[i]]);
+			_mm_store_ps(normalDestination[axis] + i, _mm_add_ps(_mm_mul_ps(a, weightA), _mm_mul_ps(b, weightB)));
+		}
+	}
+#else
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const unsigned char* planeA = planesA + axis * _paddedCount;
+		const unsigned char* planeB = planesB + axis * _paddedCount;
+
+		for (size_t i = 0; i < _paddedCount; i++)
+		{
+			destination[axis][i] = planeA[i] * ka[axis] + planeB[i] * kb[axis] + c[axis];
+			normalDestination[axis][i] = normalTable[axis][normalsA[i]] * s + normalTable[axis][normalsB[i]] * t;
+		}
+	}
+#endif
+}
+
+const KeyframeAnimation::FrameInfo& KeyframeAnimation::GetFrameInfo(int frame) const
+{
+	return _frames[frame];
+}
+
+const unsigned char* KeyframeAnimation::GetPackedFrames() const
+{
+	return _packed.data();
+}
+
+size_t KeyframeAnimation::GetPaddedCount() const
+{
+	return _paddedCount;
+}
+
+void KeyframeAnimation::SetFrames(size_t vertexCount, const FrameInfo* frames, int frameCount, const unsigned char* packedFrames)
+{
+	Reset(vertexCount);
+	_frames.assign(frames, frames + frameCount);
+	_packed.assign(packedFrames, packedFrames + frameCount * _paddedCount * 4);
+}
+
+bool KeyframeAnimation::GetBounds(float minimum[3], float maximum[3]) const
+{
+	if (_frames.empty() || _vertexCount == 0)
+	{
+		return false;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		minimum[axis] = 1e30f;
+		maximum[axis] = -1e30f;
+	}
+
+	//the smallest and largest byte of each plane give the extent of the frame along that axis
+	for (size_t frame = 0; frame < _frames.size(); frame++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const unsigned char* plane = _packed.data() + (frame * 4 + axis) * _paddedCount;
+			unsigned char smallest = plane[0];
+			unsigned char largest = plane[0];
+			for (size_t i = 1; i < _vertexCount; i++)
+			{
+				smallest = plane[i] < smallest ? plane[i] : smallest;
+				largest = plane[i] > largest ? plane[i] : largest;
+			}
+
+			float first = smallest * _frames[frame].scale[axis] + _frames[frame].translate[axis];
+			float last = largest * _frames[frame].scale[axis] + _frames[frame].translate[axis];
+			float low = first < last ? first : last;
+			float high = first < last ? last : first;
+			minimum[axis] = low < minimum[axis] ? low : minimum[axis];
+			maximum[axis] = high > maximum[axis] ? high : maximum[axis];
+		}
+	}
+
+	return true;
+}
+
+size_t KeyframeAnimation::GetMemoryUsage() const
+{
+	return _packed.size() + _frames.size() * sizeof(FrameInfo);
+}
+
+//picks the table direction with the largest dot product, which is the one at the smallest angle
+unsigned char KeyframeAnimation::FindClosestNormal(float x, float y, float z) const
+{
+	int closest = 0;
+	float closestDot = -3.0f;
+
+	for (int i = 0; i < NormalCount; i++)
+	{
+		float dot = _normalX[i] * x + _normalY[i] * y + _normalZ[i] * z;
+		if (dot > closestDot)
+		{
+			closest = i;
+			closestDot = dot;
+		}
+	}
+
+	return static_cast<unsigned char>(closest);
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include "AlignedAllocator.h"
+#include "Polygon3D.h"
+#include "VertexStream.h"
+
+/*
+Where one instance of an animated model is in its animation. The instance loops over
+frameCount frames starting at firstFrame, and time counts in frames, so its whole part
+picks the two keyframes that are blended and its fraction is how far between them it is
+*/
+
+struct AnimationState
+{
+	int firstFrame{ 0 };
+	int frameCount{ 1 };
+	float framesPerSecond{ 10.0f };
+	float time{ 0.0f };
+};
+
+/*
+Every keyframe of an MD2 model, kept in the same compact form as the file: each vertex of
+each frame is a byte for each coordinate, scaled and translated by the frame, and a byte
+that indexes a table of unit normals.
+
+Each frame is stored as four planes of bytes (x, y, z and normal index), padded to a whole
+VertexStream batch, so blending two frames reads 8 neighbouring vertices with a single load
+per plane and writes straight into the structure-of-arrays streams the transforms take.
+The byte coordinates are never converted up front; decoding and blending are folded into
+one multiply-add per coordinate per frame, which keeps each frame at 4 bytes per vertex
+however many instances are animated from it.
+
+The normal indices in an MD2 file point into a table built into Quake, so they are worked
+out again here for each frame from the averaged polygon normals, as the model does for its
+static normals, and stored as the closest of NormalCount evenly spread directions.
+*/
+
+class KeyframeAnimation
+{
+public:
+	static const int NormalCount = 256;
+
+	/*
+	The name of a frame, and the scale and translation that turn its bytes into positions, with y up
+	*/
+
+	struct FrameInfo
+	{
+		char name[16];
+		float scale[3];
+		float translate[3];
+	};
+
+	KeyframeAnimation();
+
+	/*
+	Empties the animation, ready for the frames of a model with the given number of vertices
+	*/
+
+	void Reset(size_t vertexCount);
+
+	/*
+	Adds a frame from its packed MD2 vertices, 4 bytes each with z up. The axes are swapped
+	to make y up, and the normals are found from the polygons, which must already be loaded
+	*/
+
+	void AddFrame(const char* name, const float scale[3], const float translate[3], const unsigned char* packedVertices, const std::vector<Polygon3D>& polygons);
+
+	/*
+	Accesses the frames that have been loaded
+	*/
+
+	int GetFrameCount() const;
+	size_t GetVertexCount() const;
+	const char* GetFrameName(int frame) const;
+
+	/*
+	Finds the run of frames with the given name followed by a number, such as "run" for
+	run1 to run6, returning false if there are none
+	*/
+
+	bool FindSequence(const char* name, int& firstFrame, int& frameCount) const;
+
+	/*
+	Sets the state to loop over a sequence from its start / moves it on by a number of seconds
+	*/
+
+	void StartSequence(AnimationState& state, int firstFrame, int frameCount, float framesPerSecond) const;
+	static void Advance(AnimationState& state, float seconds);
+
+	/*
+	Finds the two keyframes a state is between and how far it is from the first to the second
+	*/
+
+	static void GetBlend(const AnimationState& state, int& frameA, int& frameB, float& t);
+
+	/*
+	Blends two frames, writing the positions and normals into streams sized to the vertex
+	count. The normals are not renormalised, so they shorten slightly between frames that
+	differ, which the normal transform corrects when it normalises them
+	*/
+
+	void Interpolate(int frameA, int frameB, float t, VertexStream& positions, VertexStream& normals) const;
+	void Interpolate(const AnimationState& state, VertexStream& positions, VertexStream& normals) const;
+
+	/*
+	Accesses the number of bytes held by the frames
+	*/
+
+	size_t GetMemoryUsage() const;
+
+	/*
+	Accesses the frames as they are stored, and replaces them with frames stored before, such as
+	those read from the mesh cache. The packed planes are 4 per frame, each GetPaddedCount bytes long
+	*/
+
+	const FrameInfo& GetFrameInfo(int frame) const;
+	const unsigned char* GetPackedFrames() const;
+	size_t GetPaddedCount() const;
+	void SetFrames(size_t vertexCount, const FrameInfo* frames, int frameCount, const unsigned char* packedFrames);
+
+	/*
+	Finds the box that contains the model in every frame, returning false if there are no frames
+	*/
+
+	bool GetBounds(float minimum[3], float maximum[3]) const;
+
+private:
+	typedef std::vector<unsigned char, AlignedAllocator<unsigned char, 32>> AlignedBytes;
+
+	unsigned char FindClosestNormal(float x, float y, float z) const;
+
+	size_t _vertexCount;
+	size_t _paddedCount;
+	std::vector<FrameInfo> _frames;
+
+	//frameCount * 4 planes of _paddedCount bytes: x, y, z, then the normal indices
+	AlignedBytes _packed;
+
+	//the directions the normal indices stand for, as structure-of-arrays for gathering
+	float _normalX[NormalCount];
+	float _normalY[NormalCount];
+	float _normalZ[NormalCount];
+};
@@ -1,10 +1,9 @@
 #include "MD2Loader.h"
 
-// File reading
-#include <iostream>
-#include <fstream>
-
-using namespace std;
+// File mapping
+#include "MappedFile.h"
+#include <functional>
+#include <cstring>
 
 // BYTE added in case Windows.h is not included.
 typedef unsigned char BYTE; 
@@ -94,20 +93,19 @@ MD2Loader::~MD2Loader()
 
 bool LoadPCX(const char* textureFilename, Texture& texture, const Md2Header* md2Header)
 {
-	std::ifstream   file;   
+	MappedFile file;
 
 	BYTE * paletteIndices = texture.GetPaletteIndices();
 	COLORREF * palette = texture.GetPalette();
 
-	// Try to open file
-	file.open(textureFilename, std::ios::in | std::ios::binary);
-	if (file.fail())
+	// Try to map file
+	if (!file.Open(textureFilename) || !file.Contains(0, sizeof(PcxHeader)))
 	{
 		return false;
 	}
-	// Read PCX header
-	PcxHeader header;
-	file.read(reinterpret_cast<char*>(&header), sizeof(PcxHeader));
+	// The PCX header is read straight from the start of the file
+	const BYTE* data = file.GetData();
+	const PcxHeader& header = *reinterpret_cast<const PcxHeader*>(data);
 
 	// Verify that this is a valid PCX file
 
@@ -117,7 +115,6 @@ bool LoadPCX(const char* textureFilename, Texture& texture, const Md2Header* md2
 		(md2Header && (header.BytesPerLine != md2Header->skinWidth)))
 	{
 		// This is not valid supported PCX
-		file.close();
 		return false;
 	}
 
@@ -129,33 +126,43 @@ bool LoadPCX(const char* textureFilename, Texture& texture, const Md2Header* md2
 
 	// Check that this matches our MD2 expected texture
 	// Note. valid size is <= because uses RLE (so potentially smaller)
-	if (md2Header && (size > (md2Header->skinHeight * md2Header->skinWidth)))
+	if (size <= 0 || (md2Header && (size > (md2Header->skinHeight * md2Header->skinWidth))))
 	{
 		// Doesn't match expected MD2 skin size
-		file.close();
 		return false;
 	}
 
-	// Reading file data
+	// The palette is the last 769 bytes of the file: a marker byte of 12 then 256 RGB triples
+	const size_t paletteSize = 769;
+	if (!file.Contains(sizeof(PcxHeader), paletteSize))
+	{
+		return false;
+	}
+	const BYTE* rawPalette = data + file.GetSize() - paletteSize;
 
-	BYTE processByte, colourByte;
+	// Decoding the image data, which runs from the header up to the palette
+
+	const BYTE* source = data + sizeof(PcxHeader);
 	int count = 0;
-	while (count < size)
+	while (count < size && source < rawPalette)
 	{
-		file.read(reinterpret_cast<char*>(&processByte), 1);
+		BYTE processByte = *source++;
 
 		// Run length encoding - test if byte is an RLE byte
 		if ((processByte & 192) == 192)
 		{
-			// Extract number of times repeated byte
-			processByte &= 63;
-			file.read(reinterpret_cast<char*>(&colourByte), 1);
-			for (int index = 0; index < processByte; ++index)
+			// Extract number of times repeated byte, never running past the end of the image
+			int runLength = processByte & 63;
+			runLength = runLength < size - count ? runLength : size - count;
+			if (source == rawPalette)
 			{
-				// repeatedly write colour 
-				paletteIndices[count] = colourByte;
-				++count;
+				break;
 			}
+			BYTE colourByte = *source++;
+
+			// repeatedly write colour 
+			memset(paletteIndices + count, colourByte, runLength);
+			count += runLength;
 		}
 		else
 		{
@@ -165,82 +172,73 @@ bool LoadPCX(const char* textureFilename, Texture& texture, const Md2Header* md2
 		}
 	}
 
-	bool returnValue = false;
-
 	// read palette data...
-	file.seekg(-769, std::ios::end);	// This offset from end of file
-	file.read(reinterpret_cast<char*>(&processByte), 1);
-	if (processByte == 12)
+	if (rawPalette[0] != 12)
 	{
-		BYTE rawPalette[768];
-		file.read(reinterpret_cast<char*>(&rawPalette), 768);
+		return false;
+	}
 
-		// Build palette
-		for (int palIndex = 0; palIndex < 256; ++palIndex)
-		{
-			palette[palIndex] = RGB(rawPalette[palIndex * 3],
-									rawPalette[(palIndex * 3) + 1],
-									rawPalette[(palIndex * 3) + 2]);
-		}
-		returnValue = true;
+	// Build palette
+	for (int palIndex = 0; palIndex < 256; ++palIndex)
+	{
+		palette[palIndex] = RGB(rawPalette[1 + palIndex * 3],
+								rawPalette[1 + (palIndex * 3) + 1],
+								rawPalette[1 + (palIndex * 3) + 2]);
 	}
 
-	file.close();
-	return returnValue;
+	return true;
 }
 
 // Load model from file.
+// The file is mapped rather than read, and the triangles, frames and texture coordinates are
+// used in place in the mapping, once the header has been checked to point at tables inside the file
 
-bool MD2Loader::LoadModel(const char* md2Filename, const char * textureFilename, Model& model, AddPolygon addPolygon, AddVertex addVertex, AddTextureUV addTextureUV)
+bool MD2Loader::LoadModel(const char* md2Filename, const char * textureFilename, Model& model, AddPolygon addPolygon, AddVertex addVertex, AddTextureUV addTextureUV, AddAnimationFrame addAnimationFrame)
 {
-	ifstream   file;           
-	Md2Header header;
+	MappedFile file;
 	bool bHasTexture = false;
 
-	// Try to open MD2 file
-	file.open(md2Filename, ios::in | ios::binary);
-	if (file.fail())
+	// Try to map MD2 file
+	if (!file.Open(md2Filename) || !file.Contains(0, sizeof(Md2Header)))
 	{
 		return false;
 	}
-	// Read file header
-	file.read(reinterpret_cast<char*>(&header), sizeof(Md2Header));
-		
+	const BYTE* data = file.GetData();
+	const Md2Header& header = *reinterpret_cast<const Md2Header*>(data);
+
 	// Verify that this is a MD2 file (check for the magic number and version number)
-	if ((header.indent != MD2_IDENT) && (header.version != MD2_VERSION))
+	if ((header.indent != MD2_IDENT) || (header.version != MD2_VERSION))
 	{
 		// This is not a MD2 model
-		file.close();
 		return false;
 	}
 
-	// Allocate the memory we need
-	Md2Triangle* triangles = new Md2Triangle[header.numTriangles];
-	// We are only interested in the first frame 
-	BYTE* frameBuffer = new BYTE[header.frameSize];
-	Md2Frame* frame = reinterpret_cast<Md2Frame*>(frameBuffer);
-	Md2TextureCoord * textureCoords = new Md2TextureCoord[header.numTexCoords];
-
-	// Read polygon data...
-	file.seekg(header.offsetTriangles, ios::beg);
-	file.read(reinterpret_cast<char*>(triangles), sizeof(Md2Triangle) * header.numTriangles);	
-		
-	// Read frame data...
-	file.seekg(header.offsetFrames, ios::beg);
-	file.read(reinterpret_cast<char*>(frame), header.frameSize);	
-
-	// Read texture coordinate data
-	file.seekg(header.offsetTexCoords, std::ios::beg);
-	file.read(reinterpret_cast<char*>(textureCoords), sizeof(Md2TextureCoord) * header.numTexCoords);
-		
-	// Close the file 
-	file.close();
+	// Check that every table the header describes lies within the file.
+	// The first frame is the static mesh, and all of them are used if the animation is wanted
+	int numFramesUsed = addAnimationFrame ? header.numFrames : 1;
+	size_t frameHeaderSize = sizeof(Md2Frame) - sizeof(Md2Vertex);
+	if (header.numTriangles < 0 || header.numVertices < 0 || header.numTexCoords < 0 || header.numFrames < 1 ||
+		header.frameSize < 0 || static_cast<size_t>(header.frameSize) < frameHeaderSize + sizeof(Md2Vertex) * header.numVertices ||
+		!file.Contains(header.offsetTriangles, sizeof(Md2Triangle) * header.numTriangles) ||
+		!file.Contains(header.offsetFrames, static_cast<size_t>(header.frameSize) * numFramesUsed) ||
+		!file.Contains(header.offsetTexCoords, sizeof(Md2TextureCoord) * header.numTexCoords))
+	{
+		return false;
+	}
+
+	const Md2Triangle* triangles = reinterpret_cast<const Md2Triangle*>(data + header.offsetTriangles);
+	const Md2Frame* frame = reinterpret_cast<const Md2Frame*>(data + header.offsetFrames);
+	const Md2TextureCoord* textureCoords = reinterpret_cast<const Md2TextureCoord*>(data + header.offsetTexCoords);
 
 	// Attempt to load any texture
 	if (textureFilename)
 	{
 		model.GetTexture().SetTextureSize(header.skinWidth, header.skinHeight);
 		bHasTexture = LoadPCX(textureFilename, model.GetTexture(), &header);
+		if (bHasTexture)
+		{
+			model.GetTexture().ResolvePalette();
+		}
 	}
 
 	// Polygon array initialization
@@ -275,16 +273,18 @@ bool MD2Loader::LoadModel(const char* md2Filename, const char * textureFilename,
 			std::invoke(addTextureUV, model, textureCoords[i].textureCoord[0], textureCoords[i].textureCoord[1]);
 		}
 	}
-	// Free dynamically allocated memory
-	delete [] triangles; // NOTE: this is 'array' delete. Must be sure to use this
-	triangles = 0;
-
-	delete [] frameBuffer;
-	frameBuffer = 0;
-	frame = 0;
-
-	delete[] textureCoords;
-	textureCoords = 0;
+	// Animation frames initialisation, once the polygons and vertices they depend on are in place
+	if (addAnimationFrame)
+	{
+		for (int i = 0; i < numFramesUsed; i++)
+		{
+			const Md2Frame* animationFrame = reinterpret_cast<const Md2Frame*>(data + header.offsetFrames + static_cast<size_t>(header.frameSize) * i);
+			char name[17] = { 0 };
+			memcpy(name, animationFrame->name, 16);
+			std::invoke(addAnimationFrame, model, name, animationFrame->scale, animationFrame->translate, &animationFrame->verts[0].v[0]);
+		}
+	}
 
+	// The mapping is released when the file goes out of scope, and nothing refers into it after this
 	return true;
 }
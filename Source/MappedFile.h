@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include "Platform.h"
+
+/*
+Maps a whole file into memory read only, so that it can be parsed in place through a
+pointer rather than copied out with reads. The operating system pages the file in as it
+is touched, and the mapping is released when the object is closed or destroyed.
+*/
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/*
+	Maps the file, returning false if it cannot be opened or is empty / unmaps it
+	*/
+
+	bool Open(const char* filename);
+	void Close();
+
+	/*
+	Accesses the bytes of the file and how many there are
+	*/
+
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+
+	/*
+	Checks that a range of bytes, such as a table an offset in a header points to, lies within the file
+	*/
+
+	bool Contains(size_t offset, size_t length) const;
+
+private:
+	const unsigned char* _data;
+	size_t _size;
+
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#endif
+};
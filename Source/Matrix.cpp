@@ -1,4 +1,12 @@
 #include "Matrix.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MATRIX_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATRIX_USE_SSE
+#endif
 //#include <cmath>
 
 // Default constructor
@@ -111,6 +119,226 @@ const Vertex Matrix::operator*(const Vertex& p) const
     return newVertex;
 }
 
+// Build the matrix that transforms normals
+Matrix Matrix::GetNormalMatrix() const
+{
+    Matrix result;
+
+    // Each element is the cofactor of the same element in the upper 3x3
+    result._m[0][0] = _m[1][1] * _m[2][2] - _m[1][2] * _m[2][1];
+    result._m[0][1] = _m[1][2] * _m[2][0] - _m[1][0] * _m[2][2];
+    result._m[0][2] = _m[1][0] * _m[2][1] - _m[1][1] * _m[2][0];
+    result._m[1][0] = _m[0][2] * _m[2][1] - _m[0][1] * _m[2][2];
+    result._m[1][1] = _m[0][0] * _m[2][2] - _m[0][2] * _m[2][0];
+    result._m[1][2] = _m[0][1] * _m[2][0] - _m[0][0] * _m[2][1];
+    result._m[2][0] = _m[0][1] * _m[1][2] - _m[0][2] * _m[1][1];
+    result._m[2][1] = _m[0][2] * _m[1][0] - _m[0][0] * _m[1][2];
+    result._m[2][2] = _m[0][0] * _m[1][1] - _m[0][1] * _m[1][0];
+    result._m[3][3] = 1;
+
+    // The determinant is negative when the transformation mirrors, which would turn the normals inside out
+    float determinant = _m[0][0] * result._m[0][0] + _m[0][1] * result._m[0][1] + _m[0][2] * result._m[0][2];
+    if (determinant < 0)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                result._m[i][j] = -result._m[i][j];
+            }
+        }
+    }
+
+    return result;
+}
+
+// Build the inverse of a transformation that rotates, scales and translates
+Matrix Matrix::GetAffineInverse() const
+{
+    Matrix result;
+
+    // The inverse of the upper 3x3 is its transposed cofactors divided by the determinant
+    float cofactors[3][3];
+    cofactors[0][0] = _m[1][1] * _m[2][2] - _m[1][2] * _m[2][1];
+    cofactors[0][1] = _m[1][2] * _m[2][0] - _m[1][0] * _m[2][2];
+    cofactors[0][2] = _m[1][0] * _m[2][1] - _m[1][1] * _m[2][0];
+    cofactors[1][0] = _m[0][2] * _m[2][1] - _m[0][1] * _m[2][2];
+    cofactors[1][1] = _m[0][0] * _m[2][2] - _m[0][2] * _m[2][0];
+    cofactors[1][2] = _m[0][1] * _m[2][0] - _m[0][0] * _m[2][1];
+    cofactors[2][0] = _m[0][1] * _m[1][2] - _m[0][2] * _m[1][1];
+    cofactors[2][1] = _m[0][2] * _m[1][0] - _m[0][0] * _m[1][2];
+    cofactors[2][2] = _m[0][0] * _m[1][1] - _m[0][1] * _m[1][0];
+
+    float determinant = _m[0][0] * cofactors[0][0] + _m[0][1] * cofactors[0][1] + _m[0][2] * cofactors[0][2];
+    if (determinant == 0)
+    {
+        return result;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            result._m[i][j] = cofactors[j][i] / determinant;
+        }
+    }
+
+    // The translation is undone after the rotation and scale are, so it goes through the inverse too
+    for (int i = 0; i < 3; i++)
+    {
+        result._m[i][3] = -(result._m[i][0] * _m[0][3] + result._m[i][1] * _m[1][3] + result._m[i][2] * _m[2][3]);
+    }
+    result._m[3][3] = 1;
+
+    return result;
+}
+
+// Multiply every vertex in a stream by the matrix
+void Matrix::TransformStream(const VertexStream& source, VertexStream& destination, const unsigned char* batchMask) const
+{
+    TransformStream(source, destination, false, batchMask);
+}
+
+// Multiply every vertex in a stream by the matrix and divide through by w
+void Matrix::ProjectStream(const VertexStream& source, VertexStream& destination, const unsigned char* batchMask) const
+{
+    TransformStream(source, destination, true, batchMask);
+}
+
+void Matrix::TransformStream(const VertexStream& source, VertexStream& destination, bool divideByW, const unsigned char* batchMask) const
+{
+    if (destination.GetCount() != source.GetCount())
+    {
+        destination.Resize(source.GetCount());
+    }
+
+    const float* sourceX = source.GetX();
+    const float* sourceY = source.GetY();
+    const float* sourceZ = source.GetZ();
+    const float* sourceW = source.GetW();
+    float* destinationX = destination.GetX();
+    float* destinationY = destination.GetY();
+    float* destinationZ = destination.GetZ();
+    float* destinationW = destination.GetW();
+
+    // The streams are padded to a whole number of batches, so every loop below works on full groups
+    size_t count = source.GetPaddedCount();
+
+#if defined(MATRIX_USE_AVX2)
+    // Broadcast each matrix element across a register once, then transform 8 vertices per iteration
+    __m256 m[ROWS][COLS];
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLS; j++)
+        {
+            m[i][j] = _mm256_set1_ps(_m[i][j]);
+        }
+    }
+
+    for (size_t i = 0; i < count; i += 8)
+    {
+        if (batchMask != nullptr && batchMask[i / VertexStream::BatchSize] == 0)
+        {
+            continue;
+        }
+
+        __m256 x = _mm256_load_ps(sourceX + i);
+        __m256 y = _mm256_load_ps(sourceY + i);
+        __m256 z = _mm256_load_ps(sourceZ + i);
+        __m256 w = _mm256_load_ps(sourceW + i);
+
+        __m256 row[ROWS];
+        for (int r = 0; r < ROWS; r++)
+        {
+            row[r] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[r][0], x), _mm256_mul_ps(m[r][1], y)), _mm256_mul_ps(m[r][2], z)), _mm256_mul_ps(m[r][3], w));
+        }
+
+        if (divideByW)
+        {
+            row[0] = _mm256_div_ps(row[0], row[3]);
+            row[1] = _mm256_div_ps(row[1], row[3]);
+            row[2] = _mm256_div_ps(row[2], row[3]);
+        }
+
+        _mm256_store_ps(destinationX + i, row[0]);
+        _mm256_store_ps(destinationY + i, row[1]);
+        _mm256_store_ps(destinationZ + i, row[2]);
+        _mm256_store_ps(destinationW + i, row[3]);
+    }
+#elif defined(MATRIX_USE_SSE)
+    // Broadcast each matrix element across a register once, then transform 4 vertices per iteration
+    __m128 m[ROWS][COLS];
+    for (int i = 0; i < ROWS; i++)
+    {
+        for (int j = 0; j < COLS; j++)
+        {
+            m[i][j] = _mm_set1_ps(_m[i][j]);
+        }
+    }
+
+    for (size_t i = 0; i < count; i += 4)
+    {
+        if (batchMask != nullptr && batchMask[i / VertexStream::BatchSize] == 0)
+        {
+            continue;
+        }
+
+        __m128 x = _mm_load_ps(sourceX + i);
+        __m128 y = _mm_load_ps(sourceY + i);
+        __m128 z = _mm_load_ps(sourceZ + i);
+        __m128 w = _mm_load_ps(sourceW + i);
+
+        __m128 row[ROWS];
+        for (int r = 0; r < ROWS; r++)
+        {
+            row[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], x), _mm_mul_ps(m[r][1], y)), _mm_mul_ps(m[r][2], z)), _mm_mul_ps(m[r][3], w));
+        }
+
+        if (divideByW)
+        {
+            row[0] = _mm_div_ps(row[0], row[3]);
+            row[1] = _mm_div_ps(row[1], row[3]);
+            row[2] = _mm_div_ps(row[2], row[3]);
+        }
+
+        _mm_store_ps(destinationX + i, row[0]);
+        _mm_store_ps(destinationY + i, row[1]);
+        _mm_store_ps(destinationZ + i, row[2]);
+        _mm_store_ps(destinationW + i, row[3]);
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        if (batchMask != nullptr && batchMask[i / VertexStream::BatchSize] == 0)
+        {
+            continue;
+        }
+
+        float x = sourceX[i];
+        float y = sourceY[i];
+        float z = sourceZ[i];
+        float w = sourceW[i];
+
+        float resultX = _m[0][0] * x + _m[0][1] * y + _m[0][2] * z + _m[0][3] * w;
+        float resultY = _m[1][0] * x + _m[1][1] * y + _m[1][2] * z + _m[1][3] * w;
+        float resultZ = _m[2][0] * x + _m[2][1] * y + _m[2][2] * z + _m[2][3] * w;
+        float resultW = _m[3][0] * x + _m[3][1] * y + _m[3][2] * z + _m[3][3] * w;
+
+        if (divideByW)
+        {
+            resultX = resultX / resultW;
+            resultY = resultY / resultW;
+            resultZ = resultZ / resultW;
+        }
+
+        destinationX[i] = resultX;
+        destinationY[i] = resultY;
+        destinationZ[i] = resultZ;
+        destinationW[i] = resultW;
+    }
+#endif
+}
+
 void Matrix::Copy(const Matrix& other)
 {
     for (int i = 0; i < ROWS; i++)
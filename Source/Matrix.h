@@ -1,5 +1,6 @@
 #pragma once
 #include "Vertex.h"
+#include "VertexStream.h"
 
 const int ROWS = 4;
 const int COLS = 4;
@@ -39,9 +40,33 @@ public:
 	// Multiply a matrix by a vertex, returning a vertex
 	const Vertex operator*(const Vertex& other) const;
 
+	// Returns the matrix that takes normals through this transformation: the cofactor matrix of the
+	// upper 3x3, which is its inverse transpose scaled by the determinant. It exists even when the
+	// transformation cannot be inverted, and its sign is fixed so that normals keep facing the same
+	// way through a mirroring transformation. Normals need normalising after being transformed by it.
+	Matrix GetNormalMatrix() const;
+
+	// Returns the inverse of an affine transformation, one whose bottom row is 0 0 0 1, from the
+	// cofactors of its upper 3x3 and its translation. A transformation that flattens everything
+	// onto a plane has no inverse, and gives a matrix of zeros.
+	Matrix GetAffineInverse() const;
+
+	// Multiply every vertex in source by the matrix, writing the results into destination.
+	// Uses AVX2 (8 vertices at a time) or SSE (4 at a time) when the compiler targets them,
+	// otherwise a scalar loop. The results match operator* exactly on every path.
+	// When a batch mask is given, only the batches of VertexStream::BatchSize vertices whose
+	// entry is non-zero are transformed, and the rest of destination is left as it was.
+	void TransformStream(const VertexStream& source, VertexStream& destination, const unsigned char* batchMask = nullptr) const;
+
+	// As TransformStream, but also divides x, y and z by the transformed w in the same pass,
+	// leaving the undivided w in the w array for perspective correction and depth testing.
+	void ProjectStream(const VertexStream& source, VertexStream& destination, const unsigned char* batchMask = nullptr) const;
+
 private:
 	float _m[ROWS][COLS];
 
 	void Copy(const Matrix& other);
 
+	void TransformStream(const VertexStream& source, VertexStream& destination, bool divideByW, const unsigned char* batchMask) const;
+
 };
@@ -0,0 +1,408 @@
+#include "MeshCache.h"
+#include "MD2Loader.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+const unsigned int MeshCache::Version;
+
+static const char MeshCacheMagic[4] = { 'G', 'M', 'M', 'C' };
+static const size_t SectionAlignment = 32;
+
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceChecksum;
+	uint64_t contentChecksum;	// of every byte after the header
+	uint64_t fileSize;
+
+	uint32_t vertexCount;
+	uint32_t paddedCount;
+	uint32_t polygonCount;
+	uint32_t uvCount;
+	int32_t textureWidth;
+	int32_t textureHeight;
+	uint32_t frameCount;
+	uint32_t clusterCount;
+
+	float boundsMinimum[3];
+	float boundsMaximum[3];
+	float sphereCentre[3];
+	float sphereRadius;
+
+	uint64_t positionsOffset;
+	uint64_t normalsOffset;
+	uint64_t uvsOffset;
+	uint64_t indicesOffset;
+	uint64_t texelsOffset;
+	uint64_t framesOffset;
+	uint64_t packedFramesOffset;
+	uint64_t polygonClustersOffset;
+	uint64_t clusterBoundsOffset;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 176, "the mesh cache header must not change size without a new version");
+static_assert(sizeof(KeyframeAnimation::FrameInfo) == 40, "the mesh cache frames must not change size without a new version");
+static_assert(sizeof(TriangleClusters::ClusterBounds) == 36, "the mesh cache clusters must not change size without a new version");
+
+//rounds an offset up to the start of the next section
+static size_t AlignSection(size_t offset)
+{
+	return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+static void AppendBytes(std::vector<unsigned char>& buffer, size_t offset, const void* data, size_t size)
+{
+	if (size > 0)
+	{
+		memcpy(buffer.data() + offset, data, size);
+	}
+}
+
+bool MeshCache::LoadModel(const char* md2Filename, const char* textureFilename, const char* cacheFilename, Model& model)
+{
+	unsigned long long sourceChecksum = 0;
+	if (!CalculateSourceChecksum(md2Filename, textureFilename, sourceChecksum))
+	{
+		return false;
+	}
+
+	if (Read(cacheFilename, sourceChecksum, model))
+	{
+		return true;
+	}
+
+	//the cache is missing or stale, so the sources are loaded and the cache rebuilt for next time
+	if (!MD2Loader::LoadModel(md2Filename, textureFilename, model,
+		&Model::AddPolygon,
+		&Model::AddVertex,
+		&Model::AddTextureUV,
+		&Model::AddAnimationFrame))
+	{
+		return false;
+	}
+	model.CalculateBounds();
+	model.BuildClusters();
+
+	//failing to write the cache only means the next start is slower
+	Write(cacheFilename, sourceChecksum, model);
+	return true;
+}
+
+bool MeshCache::Cook(const char* md2Filename, const char* textureFilename, const char* cacheFilename)
+{
+	unsigned long long sourceChecksum = 0;
+	Model model;
+	if (!CalculateSourceChecksum(md2Filename, textureFilename, sourceChecksum) ||
+		!MD2Loader::LoadModel(md2Filename, textureFilename, model, &Model::AddPolygon, &Model::AddVertex, &Model::AddTextureUV, &Model::AddAnimationFrame))
+	{
+		return false;
+	}
+	model.CalculateBounds();
+	model.BuildClusters();
+
+	return Write(cacheFilename, sourceChecksum, model);
+}
+
+bool MeshCache::Read(const char* cacheFilename, unsigned long long sourceChecksum, Model& model)
+{
+	MappedFile file;
+	if (!file.Open(cacheFilename) || !file.Contains(0, sizeof(MeshCacheHeader)))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	const MeshCacheHeader& header = *reinterpret_cast<const MeshCacheHeader*>(data);
+
+	if (memcmp(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 || header.version != Version ||
+		header.sourceChecksum != sourceChecksum || header.fileSize != file.GetSize())
+	{
+		return false;
+	}
+
+	//every section must lie inside the file before anything is checksummed or copied
+	size_t positionsSize = static_cast<size_t>(header.paddedCount) * 3 * sizeof(float);
+	size_t uvsSize = static_cast<size_t>(header.uvCount) * 2 * sizeof(float);
+	size_t indicesSize = static_cast<size_t>(header.polygonCount) * 6 * sizeof(int32_t);
+	size_t texelsSize = static_cast<size_t>(header.textureWidth > 0 ? header.textureWidth : 0) * (header.textureHeight > 0 ? header.textureHeight : 0) * sizeof(uint32_t);
+	size_t framesSize = static_cast<size_t>(header.frameCount) * sizeof(KeyframeAnimation::FrameInfo);
+	size_t packedFramesSize = static_cast<size_t>(header.frameCount) * header.paddedCount * 4;
+	size_t poseCount = header.frameCount > 0 ? header.frameCount * 2 - 1 : 1;
+	size_t polygonClustersSize = header.clusterCount > 0 ? static_cast<size_t>(header.polygonCount) * sizeof(uint32_t) : 0;
+	size_t clusterBoundsSize = static_cast<size_t>(header.clusterCount) * poseCount * sizeof(TriangleClusters::ClusterBounds);
+
+	if (header.paddedCount < header.vertexCount || header.paddedCount % VertexStream::BatchSize != 0 ||
+		!file.Contains(header.positionsOffset, positionsSize) ||
+		!file.Contains(header.normalsOffset, positionsSize) ||
+		!file.Contains(header.uvsOffset, uvsSize) ||
+		!file.Contains(header.indicesOffset, indicesSize) ||
+		!file.Contains(header.texelsOffset, texelsSize) ||
+		!file.Contains(header.framesOffset, framesSize) ||
+		!file.Contains(header.packedFramesOffset, packedFramesSize) ||
+		!file.Contains(header.polygonClustersOffset, polygonClustersSize) ||
+		!file.Contains(header.clusterBoundsOffset, clusterBoundsSize))
+	{
+		return false;
+	}
+
+	if (CalculateChecksum(data + sizeof(MeshCacheHeader), file.GetSize() - sizeof(MeshCacheHeader), 0) != header.contentChecksum)
+	{
+		return false;
+	}
+
+	//the polygons must only refer to vertices and UVs that exist
+	const int32_t* indices = reinterpret_cast<const int32_t*>(data + header.indicesOffset);
+	for (size_t i = 0; i < static_cast<size_t>(header.polygonCount) * 6; i += 6)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			if (indices[i + j] < 0 || static_cast<uint32_t>(indices[i + j]) >= header.vertexCount)
+			{
+				return false;
+			}
+
+			//without UVs the model is never textured, so the UV indices are not used
+			if (header.uvCount > 0 && (indices[i + 3 + j] < 0 || static_cast<uint32_t>(indices[i + 3 + j]) >= header.uvCount))
+			{
+				return false;
+			}
+		}
+	}
+
+	//and must only be in clusters that exist
+	const uint32_t* polygonClusters = reinterpret_cast<const uint32_t*>(data + header.polygonClustersOffset);
+	for (size_t i = 0; i < polygonClustersSize / sizeof(uint32_t); i++)
+	{
+		if (polygonClusters[i] >= header.clusterCount)
+		{
+			return false;
+		}
+	}
+
+	//the sections are in the form the model holds them, so they are copied in as they are
+	const float* positions = reinterpret_cast<const float*>(data + header.positionsOffset);
+	const float* normals = reinterpret_cast<const float*>(data + header.normalsOffset);
+	model.SetMesh(header.vertexCount,
+		positions, positions + header.paddedCount, positions + header.paddedCount * 2,
+		normals, normals + header.paddedCount, normals + header.paddedCount * 2);
+
+	for (size_t i = 0; i < header.polygonCount; i++)
+	{
+		model.AddPolygon(indices[i * 6], indices[i * 6 + 1], indices[i * 6 + 2], indices[i * 6 + 3], indices[i * 6 + 4], indices[i * 6 + 5]);
+	}
+
+	const float* uvs = reinterpret_cast<const float*>(data + header.uvsOffset);
+	for (size_t i = 0; i < header.uvCount; i++)
+	{
+		model.AddTextureUV(uvs[i * 2], uvs[i * 2 + 1]);
+	}
+
+	if (texelsSize > 0)
+	{
+		model.GetTexture().SetTexels(header.textureWidth, header.textureHeight, reinterpret_cast<const COLORREF*>(data + header.texelsOffset));
+	}
+
+	if (header.frameCount > 0)
+	{
+		model.GetAnimation().SetFrames(header.vertexCount,
+			reinterpret_cast<const KeyframeAnimation::FrameInfo*>(data + header.framesOffset), header.frameCount,
+			data + header.packedFramesOffset);
+	}
+
+	if (header.clusterCount > 0)
+	{
+		model.GetClusters().SetClusters(polygonClusters, header.polygonCount, header.clusterCount,
+			reinterpret_cast<const TriangleClusters::ClusterBounds*>(data + header.clusterBoundsOffset), poseCount);
+	}
+
+	model.SetBounds(Vector3D(header.boundsMinimum[0], header.boundsMinimum[1], header.boundsMinimum[2]),
+					Vector3D(header.boundsMaximum[0], header.boundsMaximum[1], header.boundsMaximum[2]),
+					Vector3D(header.sphereCentre[0], header.sphereCentre[1], header.sphereCentre[2]),
+					header.sphereRadius);
+
+	return true;
+}
+
+bool MeshCache::Write(const char* cacheFilename, unsigned long long sourceChecksum, Model& model)
+{
+	const VertexStream& positions = model.GetLocalPositions();
+	const VertexStream& normals = model.GetLocalNormals();
+	const std::vector<Polygon3D>& polygons = model.GetPolygons();
+	const std::vector<UVCoord>& uvs = model.GetUVCoords();
+	const Texture& texture = model.GetTexture();
+	const KeyframeAnimation& animation = model.GetAnimation();
+	const TriangleClusters& clusters = model.GetClusters();
+
+	bool hasTexels = texture.GetTexels() != nullptr;
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.version = Version;
+	header.sourceChecksum = sourceChecksum;
+	header.vertexCount = static_cast<uint32_t>(positions.GetCount());
+	header.paddedCount = static_cast<uint32_t>(positions.GetPaddedCount());
+	header.polygonCount = static_cast<uint32_t>(polygons.size());
+	header.uvCount = static_cast<uint32_t>(uvs.size());
+	header.textureWidth = hasTexels ? texture.GetWidth() : 0;
+	header.textureHeight = hasTexels ? texture.GetHeight() : 0;
+	header.frameCount = static_cast<uint32_t>(animation.GetFrameCount());
+	header.clusterCount = static_cast<uint32_t>(clusters.GetClusterCount());
+
+	Vector3D minimum, maximum, centre;
+	model.GetBoundingBox(minimum, maximum);
+	model.GetBoundingSphere(centre, header.sphereRadius);
+	header.boundsMinimum[0] = minimum.GetX();
+	header.boundsMinimum[1] = minimum.GetY();
+	header.boundsMinimum[2] = minimum.GetZ();
+	header.boundsMaximum[0] = maximum.GetX();
+	header.boundsMaximum[1] = maximum.GetY();
+	header.boundsMaximum[2] = maximum.GetZ();
+	header.sphereCentre[0] = centre.GetX();
+	header.sphereCentre[1] = centre.GetY();
+	header.sphereCentre[2] = centre.GetZ();
+
+	//lays the sections out one after another, each on a section boundary
+	size_t positionsSize = positions.GetPaddedCount() * 3 * sizeof(float);
+	size_t uvsSize = uvs.size() * 2 * sizeof(float);
+	size_t indicesSize = polygons.size() * 6 * sizeof(int32_t);
+	size_t texelsSize = static_cast<size_t>(header.textureWidth) * header.textureHeight * sizeof(uint32_t);
+	size_t framesSize = header.frameCount * sizeof(KeyframeAnimation::FrameInfo);
+	size_t packedFramesSize = header.frameCount * animation.GetPaddedCount() * 4;
+	size_t polygonClustersSize = header.clusterCount > 0 ? polygons.size() * sizeof(uint32_t) : 0;
+	size_t clusterBoundsSize = header.clusterCount * clusters.GetPoseCount() * sizeof(TriangleClusters::ClusterBounds);
+
+	header.positionsOffset = AlignSection(sizeof(MeshCacheHeader));
+	header.normalsOffset = AlignSection(header.positionsOffset + positionsSize);
+	header.uvsOffset = AlignSection(header.normalsOffset + positionsSize);
+	header.indicesOffset = AlignSection(header.uvsOffset + uvsSize);
+	header.texelsOffset = AlignSection(header.indicesOffset + indicesSize);
+	header.framesOffset = AlignSection(header.texelsOffset + texelsSize);
+	header.packedFramesOffset = AlignSection(header.framesOffset + framesSize);
+	header.polygonClustersOffset = AlignSection(header.packedFramesOffset + packedFramesSize);
+	header.clusterBoundsOffset = AlignSection(header.polygonClustersOffset + polygonClustersSize);
+	header.fileSize = header.clusterBoundsOffset + clusterBoundsSize;
+
+	std::vector<unsigned char> buffer(static_cast<size_t>(header.fileSize), 0);
+
+	//the padding of the streams is copied too, so the planes read back exactly as they were
+	size_t planeSize = positions.GetPaddedCount() * sizeof(float);
+	AppendBytes(buffer, header.positionsOffset, positions.GetX(), planeSize);
+	AppendBytes(buffer, header.positionsOffset + planeSize, positions.GetY(), planeSize);
+	AppendBytes(buffer, header.positionsOffset + planeSize * 2, positions.GetZ(), planeSize);
+	AppendBytes(buffer, header.normalsOffset, normals.GetX(), planeSize);
+	AppendBytes(buffer, header.normalsOffset + planeSize, normals.GetY(), planeSize);
+	AppendBytes(buffer, header.normalsOffset + planeSize * 2, normals.GetZ(), planeSize);
+
+	//MD2 texture coordinates are whole texels, so nothing is lost reading them back as integers
+	float* uvData = reinterpret_cast<float*>(buffer.data() + header.uvsOffset);
+	for (size_t i = 0; i < uvs.size(); i++)
+	{
+		uvData[i * 2] = static_cast<float>(uvs[i].GetIntU());
+		uvData[i * 2 + 1] = static_cast<float>(uvs[i].GetIntV());
+	}
+
+	int32_t* indexData = reinterpret_cast<int32_t*>(buffer.data() + header.indicesOffset);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			indexData[i * 6 + j] = polygons[i].GetIndex(j);
+			indexData[i * 6 + 3 + j] = polygons[i].GetUVIndex(j);
+		}
+	}
+
+	if (hasTexels)
+	{
+		AppendBytes(buffer, header.texelsOffset, texture.GetTexels(), texelsSize);
+	}
+
+	for (int i = 0; i < animation.GetFrameCount(); i++)
+	{
+		AppendBytes(buffer, header.framesOffset + i * sizeof(KeyframeAnimation::FrameInfo), &animation.GetFrameInfo(i), sizeof(KeyframeAnimation::FrameInfo));
+	}
+	AppendBytes(buffer, header.packedFramesOffset, animation.GetPackedFrames(), packedFramesSize);
+	AppendBytes(buffer, header.polygonClustersOffset, clusters.GetPolygonClusters().data(), polygonClustersSize);
+	AppendBytes(buffer, header.clusterBoundsOffset, clusters.GetBounds(0), clusterBoundsSize);
+
+	header.contentChecksum = CalculateChecksum(buffer.data() + sizeof(MeshCacheHeader), buffer.size() - sizeof(MeshCacheHeader), 0);
+	memcpy(buffer.data(), &header, sizeof(header));
+
+	std::ofstream file(cacheFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+	return file.good();
+}
+
+bool MeshCache::CalculateSourceChecksum(const char* md2Filename, const char* textureFilename, unsigned long long& checksum)
+{
+	MappedFile md2File;
+	if (!md2File.Open(md2Filename))
+	{
+		return false;
+	}
+	checksum = CalculateChecksum(md2File.GetData(), md2File.GetSize(), Version);
+
+	//the texture checksum carries on from the model's, and a missing texture changes it as well
+	MappedFile textureFile;
+	if (textureFilename != nullptr && textureFile.Open(textureFilename))
+	{
+		checksum = CalculateChecksum(textureFile.GetData(), textureFile.GetSize(), checksum);
+	}
+	else
+	{
+		checksum = CalculateChecksum(nullptr, 0, checksum ^ 0x9E3779B97F4A7C15ULL);
+	}
+
+	return true;
+}
+
+//a 64 bit checksum taking 8 bytes at a time in 4 independent lanes, each mixed by multiplying and rotating,
+//so that any change to the data changes the result and large files checksum at memory speed
+unsigned long long MeshCache::CalculateChecksum(const unsigned char* data, size_t size, unsigned long long seed)
+{
+	const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+	uint64_t lanes[4] = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint64_t word;
+			memcpy(&word, data + i + lane * 8, sizeof(word));
+			lanes[lane] += word * prime2;
+			lanes[lane] = (lanes[lane] << 31) | (lanes[lane] >> 33);
+			lanes[lane] *= prime1;
+		}
+	}
+
+	uint64_t checksum = ((lanes[0] << 1) | (lanes[0] >> 63)) + ((lanes[1] << 7) | (lanes[1] >> 57)) +
+						((lanes[2] << 12) | (lanes[2] >> 52)) + ((lanes[3] << 18) | (lanes[3] >> 46));
+	checksum += size;
+
+	//the last few bytes one at a time
+	for (; i < size; i++)
+	{
+		checksum ^= data[i] * prime1;
+		checksum = ((checksum << 11) | (checksum >> 53)) * prime2;
+	}
+
+	//avalanches the bits so that nearby inputs give unrelated checksums
+	checksum ^= checksum >> 33;
+	checksum *= prime2;
+	checksum ^= checksum >> 29;
+	checksum *= prime1;
+	checksum ^= checksum >> 32;
+
+	return checksum;
+}
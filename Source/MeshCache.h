@@ -0,0 +1,63 @@
+#pragma once
+#include "Model.h"
+
+/*
+Reads and writes the mesh cache: a binary file holding a model exactly as the renderer keeps
+it once loaded, so that starting up does none of the MD2 decoding, axis swapping, PCX run
+length decoding or normal calculation that loading the source files needs.
+
+The file starts with a header giving the format version, a checksum of the MD2 and PCX the
+cache was built from, a checksum of everything after the header and the bounding box and
+sphere. Each section after it starts on a 32 byte boundary:
+
+	positions		x, y and z planes of padded vertex count floats, as VertexStream holds them
+	normals			x, y and z planes of padded vertex count floats
+	UVs				u and v floats for each texture coordinate
+	indices			3 vertex and 3 UV indices for each polygon, as 32 bit integers
+	texels			width * height colours, already looked up in the palette
+	frames			the name, scale and translation of each animation frame
+	packed frames	the 4 byte planes of each animation frame, as KeyframeAnimation holds them
+	clusters		the back-face cluster of each polygon, as a 32 bit integer
+	cluster bounds	the sphere and normal cone of each cluster in each pose, as TriangleClusters holds them
+
+The cache is mapped and each section is copied straight into the model, so reading it is
+a handful of bulk copies. When the version or either checksum does not match, the cache is
+treated as stale and rebuilt from the source files. The numbers are written in the byte
+order of the machine that built the cache, so caches are not shared between machines.
+*/
+
+class MeshCache
+{
+public:
+	static const unsigned int Version = 2;
+
+	/*
+	Loads a model through its cache, rebuilding the cache from the MD2 and PCX files if it is
+	missing or stale. The texture file is optional, as it is for MD2Loader. The model must be empty
+	*/
+
+	static bool LoadModel(const char* md2Filename, const char* textureFilename, const char* cacheFilename, Model& model);
+
+	/*
+	The offline cook step, which loads the MD2 and PCX files and writes their cache
+	*/
+
+	static bool Cook(const char* md2Filename, const char* textureFilename, const char* cacheFilename);
+
+	/*
+	Reads a cache into an empty model, returning false without changing the model if the cache is
+	missing, damaged or was not built from sources with the given checksum by this version.
+	Writes a model that has been loaded from its sources to a cache
+	*/
+
+	static bool Read(const char* cacheFilename, unsigned long long sourceChecksum, Model& model);
+	static bool Write(const char* cacheFilename, unsigned long long sourceChecksum, Model& model);
+
+	/*
+	Checksums the contents of the MD2 and PCX files, returning false if the MD2 cannot be read.
+	A missing texture gives a different checksum from any texture that exists
+	*/
+
+	static bool CalculateSourceChecksum(const char* md2Filename, const char* textureFilename, unsigned long long& checksum);
+	static unsigned long long CalculateChecksum(const unsigned char* data, size_t size, unsigned long long seed);
+};
@@ -1,7 +1,8 @@
 #include "Model.h"
 #include <algorithm>
 #include <math.h>
-#include <wingdi.h>
+#include <string.h>
+#include "Platform.h"
 
 
 Model::Model()
@@ -30,25 +31,19 @@ Model::~Model()
 }
 
 //returns the polygon list
-const std::vector<Polygon3D>& Model::GetPolygons()
+const std::vector<Polygon3D>& Model::GetPolygons() const
 {
 	return _polygons;
 }
 
-//returns the default vertex list
-const std::vector<Vertex>& Model::GetVertices()
+//returns the polygons to draw, in the order to draw them
+const std::vector<int>& Model::GetDrawOrder() const
 {
-	return _originalVertices;
-}
-
-//returns the transformed vertex list
-const std::vector<Vertex>& Model::GetTransVertices()
-{
-	return _transformedVertices;
+	return _drawOrder;
 }
 
 //returns the UV coord list
-const std::vector<UVCoord>& Model::GetUVCoords()
+const std::vector<UVCoord>& Model::GetUVCoords() const
 {
 	return _uvCoordinates;
 }
@@ -62,7 +57,7 @@ size_t Model::GetPolygonCount() const
 //counts the number of vertices
 size_t Model::GetVertexCount() const
 {
-	return _originalVertices.size();
+	return _localStream.GetCount();
 }
 
 //returns the texture that is loaded
@@ -71,10 +66,140 @@ Texture& Model::GetTexture()
 	return _texture;
 }
 
+//gathers a screen space vertex from the streams, for the fill methods
+Vertex Model::GetScreenVertex(int index) const
+{
+	Vertex vertex(_screenStream.GetX()[index], _screenStream.GetY()[index], _screenStream.GetZ()[index], 1);
+
+	vertex.SetZR(_reciprocalW[index]);
+	vertex.SetVertexRGB(_vertexColours[index]);
+
+	return vertex;
+}
+
+const VertexStream& Model::GetWorldPositions() const
+{
+	return _worldStream;
+}
+
+//returns the box around the model as it was loaded
+void Model::GetLocalBounds(Vector3D& minimum, Vector3D& maximum) const
+{
+	size_t count = _localStream.GetCount();
+	if (count == 0)
+	{
+		minimum = Vector3D(0, 0, 0);
+		maximum = Vector3D(0, 0, 0);
+		return;
+	}
+
+	const float* x = _localStream.GetX();
+	const float* y = _localStream.GetY();
+	const float* z = _localStream.GetZ();
+
+	float minX = x[0], minY = y[0], minZ = z[0];
+	float maxX = x[0], maxY = y[0], maxZ = z[0];
+
+	for (size_t i = 1; i < count; i++)
+	{
+		minX = x[i] < minX ? x[i] : minX;
+		minY = y[i] < minY ? y[i] : minY;
+		minZ = z[i] < minZ ? z[i] : minZ;
+		maxX = x[i] > maxX ? x[i] : maxX;
+		maxY = y[i] > maxY ? y[i] : maxY;
+		maxZ = z[i] > maxZ ? z[i] : maxZ;
+	}
+
+	minimum = Vector3D(minX, minY, minZ);
+	maximum = Vector3D(maxX, maxY, maxZ);
+}
+
+void Model::GetBoundingBox(Vector3D& minimum, Vector3D& maximum) const
+{
+	minimum = _boundsMinimum;
+	maximum = _boundsMaximum;
+}
+
+void Model::GetBoundingSphere(Vector3D& centre, float& radius) const
+{
+	centre = _sphereCentre;
+	radius = _sphereRadius;
+}
+
+//finds the box around every frame, or the static mesh when there is no animation, and the sphere centred on
+//the box that reaches the furthest vertex of any frame
+void Model::CalculateBounds()
+{
+	float minimum[3];
+	float maximum[3];
+	if (!_animation.GetBounds(minimum, maximum))
+	{
+		Vector3D localMinimum, localMaximum;
+		GetLocalBounds(localMinimum, localMaximum);
+		minimum[0] = localMinimum.GetX();
+		minimum[1] = localMinimum.GetY();
+		minimum[2] = localMinimum.GetZ();
+		maximum[0] = localMaximum.GetX();
+		maximum[1] = localMaximum.GetY();
+		maximum[2] = localMaximum.GetZ();
+	}
+
+	_boundsMinimum = Vector3D(minimum[0], minimum[1], minimum[2]);
+	_boundsMaximum = Vector3D(maximum[0], maximum[1], maximum[2]);
+	_sphereCentre = Vector3D((minimum[0] + maximum[0]) / 2, (minimum[1] + maximum[1]) / 2, (minimum[2] + maximum[2]) / 2);
+
+	float centreX = _sphereCentre.GetX(), centreY = _sphereCentre.GetY(), centreZ = _sphereCentre.GetZ();
+	float furthest = 0;
+
+	VertexStream positions;
+	VertexStream normals;
+	int frames = _animation.GetFrameCount() > 0 ? _animation.GetFrameCount() : 1;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const VertexStream* stream = &_localStream;
+		if (_animation.GetFrameCount() > 0)
+		{
+			_animation.Interpolate(frame, frame, 0.0f, positions, normals);
+			stream = &positions;
+		}
+
+		for (size_t i = 0; i < stream->GetCount(); i++)
+		{
+			float x = stream->GetX()[i] - centreX;
+			float y = stream->GetY()[i] - centreY;
+			float z = stream->GetZ()[i] - centreZ;
+			float distance = x * x + y * y + z * z;
+			furthest = distance > furthest ? distance : furthest;
+		}
+	}
+
+	_sphereRadius = sqrt(furthest);
+}
+
+void Model::SetBounds(const Vector3D& minimum, const Vector3D& maximum, const Vector3D& centre, float radius)
+{
+	_boundsMinimum = minimum;
+	_boundsMaximum = maximum;
+	_sphereCentre = centre;
+	_sphereRadius = radius;
+}
+
+//adds up the memory held by each per-vertex stream
+size_t Model::GetVertexMemoryUsage() const
+{
+	size_t positionStreamSize = _localStream.GetPaddedCount() * 4 * sizeof(float);
+
+	return positionStreamSize * 3 +
+		_reciprocalW.size() * sizeof(float) +
+		_localNormals.GetPaddedCount() * 4 * sizeof(float) +
+		_vertexNormals.size() * sizeof(Vector3D) +
+		_vertexColours.size() * sizeof(COLORREF);
+}
+
 //adds vertex to vertex list for the model
 void Model::AddVertex(float x, float y, float z)
 {
-	_originalVertices.push_back(Vertex(x, y, z, 1));
+	_localStream.Add(x, y, z, 1);
 }
 
 //adds polygon to the polygon list for the model
@@ -89,108 +214,438 @@ void Model::AddTextureUV(float u, float v)
 	_uvCoordinates.push_back(UVCoord(u, v));
 }
 
-void Model::ApplyTransformToLocalVertices(const Matrix& transform)
+//adds a keyframe, starting the animation afresh with the first one
+void Model::AddAnimationFrame(const char* name, const float scale[3], const float translate[3], const unsigned char* packedVertices)
+{
+	if (_animation.GetVertexCount() != _localStream.GetCount())
+	{
+		_animation.Reset(_localStream.GetCount());
+	}
+
+	_animation.AddFrame(name, scale, translate, packedVertices, _polygons);
+}
+
+//returns the keyframes
+const KeyframeAnimation& Model::GetAnimation() const
+{
+	return _animation;
+}
+
+KeyframeAnimation& Model::GetAnimation()
 {
-	//loop through original vertices, apply matrix and write to transformed list
-	// transVertex = origVertex * transform
+	return _animation;
+}
 
-	_transformedVertices.clear();
+const VertexStream& Model::GetLocalPositions() const
+{
+	return _localStream;
+}
 
-	for (int i = 0; i < _originalVertices.size(); i++)
+const VertexStream& Model::GetLocalNormals()
+{
+	ResizeVertexStreams();
+
+	return _localNormals;
+}
+
+//takes positions and normals that are ready to use, so the normals are not calculated again
+void Model::SetMesh(size_t vertexCount, const float* x, const float* y, const float* z, const float* normalX, const float* normalY, const float* normalZ)
+{
+	_localStream.Resize(vertexCount);
+	_localNormals.Resize(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
 	{
-		_transformedVertices.push_back(transform * _originalVertices[i]);
+		_localStream.Set(i, x[i], y[i], z[i], 1);
+		_localNormals.Set(i, normalX[i], normalY[i], normalZ[i], 0);
 	}
 
+	_clusterPose = 0;
 }
 
-void Model::ApplyTransformToTransformedVertices(const Matrix& transform)
+void Model::SetAnimationPose(const AnimationState& state)
 {
-	//loop through transformed vertices, applying the matrix and update each index in that list
-	// transVertex = transVertex * transform
+	int frameA, frameB;
+	float t;
+	KeyframeAnimation::GetBlend(state, frameA, frameB, t);
 
-	for (int i = 0; i < _originalVertices.size(); i++)
+	SetAnimationPose(frameA, frameB, t);
+}
+
+void Model::SetAnimationPose(int frameA, int frameB, float t)
+{
+	//the streams are sized first so that sizing them does not recalculate the normals over the pose
+	if (_animation.GetFrameCount() == 0)
+	{
+		return;
+	}
+
+	ResizeVertexStreams();
+
+	_animation.Interpolate(frameA, frameB, t, _localStream, _localNormals);
+
+	//the clusters have bounds for each keyframe and for the blends between neighbouring ones, which follow them.
+	//any other blend, such as a sequence looping back round, has none, and is culled a polygon at a time
+	int frameCount = _animation.GetFrameCount();
+	if (t <= 0 || frameA == frameB)
 	{
-		_transformedVertices[i] = transform * _transformedVertices[i];
+		_clusterPose = frameA;
 	}
+	else if (t >= 1)
+	{
+		_clusterPose = frameB;
+	}
+	else
+	{
+		_clusterPose = frameB == frameA + 1 ? frameCount + frameA : NoClusterPose;
+	}
+}
+
+//groups the polygons into clusters and bounds them in every frame, or in the static mesh when there is no animation
+void Model::BuildClusters()
+{
+	if (_animation.GetFrameCount() == 0)
+	{
+		_clusters.Build(_polygons, _localStream);
+		return;
+	}
+
+	//each keyframe, then each blend from one keyframe into the next
+	VertexStream positions;
+	VertexStream nextPositions;
+	VertexStream normals;
+	for (int frame = 0; frame < _animation.GetFrameCount(); frame++)
+	{
+		_animation.Interpolate(frame, frame, 0.0f, positions, normals);
+		if (frame == 0)
+		{
+			_clusters.Build(_polygons, positions);
+		}
+		else
+		{
+			_clusters.AddPose(_polygons, positions);
+		}
+	}
+
+	_animation.Interpolate(0, 0, 0.0f, positions, normals);
+	for (int frame = 0; frame + 1 < _animation.GetFrameCount(); frame++)
+	{
+		_animation.Interpolate(frame + 1, frame + 1, 0.0f, nextPositions, normals);
+		_clusters.AddBlendPose(_polygons, positions, nextPositions);
+		std::swap(positions, nextPositions);
+	}
+}
+
+const TriangleClusters& Model::GetClusters() const
+{
+	return _clusters;
+}
+
+TriangleClusters& Model::GetClusters()
+{
+	return _clusters;
+}
+
+void Model::ApplyTransformToLocalVertices(const Matrix& transform)
+{
+	ResizeVertexStreams();
+
+	//transform the vertices of the polygons that survived culling in batches
+	// worldStream = transform * localStream
+
+	transform.TransformStream(_localStream, _worldStream, _referencedBatches.data());
+}
+
+void Model::ApplyTransformToWorldVertices(const Matrix& transform)
+{
+	//starts the transformed vertices off from the world vertices
+	// screenStream = transform * worldStream
+
+	transform.TransformStream(_worldStream, _screenStream, _referencedBatches.data());
+}
+
+void Model::ApplyTransformToTransformedVertices(const Matrix& transform)
+{
+	//applies the matrix to each transformed vertex in place
+	// screenStream = transform * screenStream
 
+	transform.TransformStream(_screenStream, _screenStream, _referencedBatches.data());
 }
 
-//dehomogenizes the vertex coordinates
+//dehomogenizes the vertex coordinates, keeping 1/w for perspective texturing and depth testing
 void Model::Dehomogenized()
 {
-	for (int i = 0; i < _originalVertices.size(); i++)
+	float* x = _screenStream.GetX();
+	float* y = _screenStream.GetY();
+	float* z = _screenStream.GetZ();
+	float* w = _screenStream.GetW();
+
+	for (size_t i = 0; i < _screenStream.GetCount(); i++)
 	{
-		_transformedVertices[i].SetPreTranZ(_transformedVertices[i].GetW());
+		if (!_referencedVertices[i])
+		{
+			continue;
+		}
+
+		_reciprocalW[i] = 1 / w[i];
 
-		_transformedVertices[i].Dehomogenized();
+		x[i] = x[i] / w[i];
+		y[i] = y[i] / w[i];
+		z[i] = z[i] / w[i];
+		w[i] = 1;
 	}
 
 }
 
-void Model::CalculateBackfaces(Camera _camera)
+void Model::ApplyTransformToScreen(const Matrix& transform)
 {
+	ResizeVertexStreams();
+
+	//transform, divide by w and map to the viewport in batches, skipping those that no polygon that survived culling uses
+	// screenStream = transform * localStream / w
+
+	transform.ProjectStream(_localStream, _screenStream, _referencedBatches.data());
+
+	const float* w = _screenStream.GetW();
+
+	for (size_t i = 0; i < _screenStream.GetCount(); i++)
+	{
+		if (_referencedVertices[i])
+		{
+			_reciprocalW[i] = 1 / w[i];
+		}
+	}
+}
+
+//sizes the per-frame streams to match the local vertices, which only allocates the first time after loading
+void Model::ResizeVertexStreams()
+{
+	size_t count = _localStream.GetCount();
+
+	//the normals may already have come from the mesh cache or an animation pose
+	if (_localNormals.GetCount() != count)
+	{
+		CalculateLocalVertexNormals();
+	}
+
+	if (_reciprocalW.size() == count)
+	{
+		return;
+	}
+
+	_worldStream.Resize(count);
+	_screenStream.Resize(count);
+	_reciprocalW.resize(count);
+	_vertexNormals.resize(count);
+	_vertexColours.resize(count);
+
+	//until culling has run, every vertex counts as used
+	_referencedVertices.assign(count, 1);
+	_referencedBatches.assign(_localStream.GetPaddedCount() / VertexStream::BatchSize, 1);
+}
+
+//empties the draw order, which is all the draw loops read, so the polygons themselves are left as they were
+void Model::CullAll()
+{
+	_drawOrder.clear();
+}
+
+void Model::CalculateBackfaces(const Matrix& transform, const Camera& camera)
+{
+	ResizeVertexStreams();
+
+	//the untransformed positions are read, so this can run before anything is transformed
+	const float* x = _localStream.GetX();
+	const float* y = _localStream.GetY();
+	const float* z = _localStream.GetZ();
+
+	//the camera is taken back into object space once, rather than every vertex being taken out to world space.
+	//which side of a polygon the camera is on does not change with the transformation, even when it mirrors
+	Matrix inverseTransform = transform.GetAffineInverse();
+	bool invertible = inverseTransform.GetM(3, 3) != 0;
+	Vertex cameraPosition = inverseTransform * camera.GetCameraPosition();
+
+	//lighting needs the normals of the polygons that are kept in world space
+	Matrix normalMatrix = transform.GetNormalMatrix();
+
+	float m00 = normalMatrix.GetM(0, 0), m01 = normalMatrix.GetM(0, 1), m02 = normalMatrix.GetM(0, 2);
+	float m10 = normalMatrix.GetM(1, 0), m11 = normalMatrix.GetM(1, 1), m12 = normalMatrix.GetM(1, 2);
+	float m20 = normalMatrix.GetM(2, 0), m21 = normalMatrix.GetM(2, 1), m22 = normalMatrix.GetM(2, 2);
+
+	//the polygons that survive are listed in their loaded order, which is the draw order when nothing sorts them,
+	//and the vertices they use are marked so that the later stages can skip the rest
+	_drawOrder.clear();
+	std::fill(_referencedVertices.begin(), _referencedVertices.end(), 0);
+	std::fill(_referencedBatches.begin(), _referencedBatches.end(), 0);
+
+	//whole clusters that face away are rejected first with one test each, so their polygons need no test of their own
+	bool cullClusters = invertible && _clusters.GetClusterCount() > 0 && _clusterPose < _clusters.GetPoseCount();
+	if (cullClusters)
+	{
+		const TriangleClusters::ClusterBounds* bounds = _clusters.GetBounds(_clusterPose);
+
+		_clusterCulled.resize(_clusters.GetClusterCount());
+		for (size_t i = 0; i < _clusterCulled.size(); i++)
+		{
+			_clusterCulled[i] = TriangleClusters::IsBackFacing(bounds[i], cameraPosition.GetX(), cameraPosition.GetY(), cameraPosition.GetZ());
+		}
+	}
+	const std::vector<unsigned int>& polygonClusters = _clusters.GetPolygonClusters();
 
 	for (int i = 0; i < _polygons.size(); i++)
 	{
+		if (cullClusters && _clusterCulled[polygonClusters[i]])
+		{
+			_polygons[i].SetCullState(true);
+			continue;
+		}
+
 
-		// Get the vertices for those indices 
+		// Get the indices of the vertices
 
-		Vertex vertex0 = _transformedVertices[_polygons[i].GetIndex(0)];
-		Vertex vertex1 = _transformedVertices[_polygons[i].GetIndex(1)];
-		Vertex vertex2 = _transformedVertices[_polygons[i].GetIndex(2)];
+		int i0 = _polygons[i].GetIndex(0);
+		int i1 = _polygons[i].GetIndex(1);
+		int i2 = _polygons[i].GetIndex(2);
 
 		//Construct vector a by subtracting vertex 1 from vertex 0.
 
-		Vector3D vectorA = vertex0 - vertex1;
+		Vector3D vectorA(x[i0] - x[i1], y[i0] - y[i1], z[i0] - z[i1]);
 
 		//Construct vector b by subtracting vertex 2 from vertex 0. 
 
-		Vector3D vectorB = vertex0 - vertex2;
+		Vector3D vectorB(x[i0] - x[i2], y[i0] - y[i2], z[i0] - z[i2]);
 
 		//Calculate the normal vector from vector b and a 
 		Vector3D vectorNormal = Vector3D::CreateCrossProduct(vectorA, vectorB);
 
 		//Create eye - vector = vertex 0 - camera position
-		//Vector3D vectorEye = Vertex::CalculateVector(vertex0, _camera.GetCameraPosition());
 
-		Vector3D vectorEye(vertex0 - _camera.GetCameraPosition());
+		Vector3D vectorEye(x[i0] - cameraPosition.GetX(), y[i0] - cameraPosition.GetY(), z[i0] - cameraPosition.GetZ());
 
 		//Take dot product of the normal and eye-vector
 		float dotProduct = Vector3D::CreateDotProduct(vectorNormal, vectorEye);
 
 		//If result < 0
-		//Mark the polygon for culling
-		if (dotProduct > 0.0f) {
+		//Mark the polygon for culling. A transformation that flattens the model has no object space camera, so nothing is culled
+		if (invertible && dotProduct > 0.0f) {
 			_polygons[i].SetCullState(true);
+			continue;
 		}
-		else {
-			_polygons[i].SetCullState(false);
+
+		_polygons[i].SetCullState(false);
+		_drawOrder.push_back(i);
+
+		for (int j = 0; j <= 2; j++)
+		{
+			int index = _polygons[i].GetIndex(j);
+			_referencedVertices[index] = 1;
+			_referencedBatches[index / VertexStream::BatchSize] = 1;
 		}
 
-		_polygons[i].SetPolygonNormal(vectorNormal);
+		float normalX = vectorNormal.GetX();
+		float normalY = vectorNormal.GetY();
+		float normalZ = vectorNormal.GetZ();
+
+		_polygons[i].SetPolygonNormal(Vector3D(m00 * normalX + m01 * normalY + m02 * normalZ, m10 * normalX + m11 * normalY + m12 * normalZ, m20 * normalX + m21 * normalY + m22 * normalZ));
 
 	}
 
 }
 
 
-//loops through each polygon, sets the average Z value for each polygon and then sorts the collection by AVG Z
+//loops through the polygons to draw, sets the average Z value for each one and then sorts the draw order by AVG Z,
+//leaving the polygons where they are so that anything indexed by polygon, such as the clusters, still lines up.
+//w after projection is the view space z scaled by d, so it gives the same order as sorting before projection
 void Model::Sort(void)
 {
-	for (int i = 0; i < _polygons.size(); i++) 
+	for (size_t n = 0; n < _drawOrder.size(); n++)
 	{
+		int i = _drawOrder[n];
 
-		Vertex vertex0 = _transformedVertices[_polygons[i].GetIndex(0)];
-		Vertex vertex1 = _transformedVertices[_polygons[i].GetIndex(1)];
-		Vertex vertex2 = _transformedVertices[_polygons[i].GetIndex(2)];
+		float w0 = 1 / _reciprocalW[_polygons[i].GetIndex(0)];
+		float w1 = 1 / _reciprocalW[_polygons[i].GetIndex(1)];
+		float w2 = 1 / _reciprocalW[_polygons[i].GetIndex(2)];
 
-		float averagePolygonZ = (vertex0.GetZ() + vertex1.GetZ() + vertex2.GetZ()) / 3;
+		float averagePolygonZ = (w0 + w1 + w2) / 3;
 
 		_polygons[i].SetAverageZ(averagePolygonZ);
 	}
 
-	sort(_polygons.begin(), _polygons.end(), sortByAvgZ);
+	sort(_drawOrder.begin(), _drawOrder.end(), [this](int lhs, int rhs)
+	{
+		return sortByAvgZ(_polygons[lhs], _polygons[rhs]);
+	});
+}
+
+//sorts the draw order furthest first with a least significant digit radix sort, leaving the polygons where they are.
+//each key is the sum of w at the corners, which orders the same as the average, with its bits
+//flipped so that larger distances come first when compared as unsigned integers
+void Model::SortByDepth()
+{
+	const int DigitBits = 11;
+	const unsigned int DigitMask = (1 << DigitBits) - 1;
+	const int PassCount = 3;
+
+	_depthKeys.resize(_drawOrder.size());
+	_sortedDepthKeys.resize(_drawOrder.size());
+
+	unsigned int histograms[PassCount][1 << DigitBits] = {};
+
+	for (size_t n = 0; n < _drawOrder.size(); n++)
+	{
+		int i = _drawOrder[n];
+
+		float w = 1 / _reciprocalW[_polygons[i].GetIndex(0)] +
+			1 / _reciprocalW[_polygons[i].GetIndex(1)] +
+			1 / _reciprocalW[_polygons[i].GetIndex(2)];
+
+		//positive depths have their bits inverted so the furthest get the smallest keys, and negative ones, behind the camera, keep theirs and come last
+		unsigned int bits;
+		memcpy(&bits, &w, sizeof(bits));
+		unsigned int key = (bits & 0x80000000) != 0 ? bits : ~bits & 0x7FFFFFFF;
+
+		_depthKeys[n].key = key;
+		_depthKeys[n].polygon = i;
+
+		//every pass is counted at once, so the keys are only read once before the scatters
+		for (int pass = 0; pass < PassCount; pass++)
+		{
+			histograms[pass][(key >> (pass * DigitBits)) & DigitMask]++;
+		}
+	}
+
+	for (int pass = 0; pass < PassCount; pass++)
+	{
+		unsigned int* histogram = histograms[pass];
+		int shift = pass * DigitBits;
 
+		//when every key has the same digit, as the top one usually does, the pass would not move anything
+		if (_depthKeys.empty() || histogram[(_depthKeys[0].key >> shift) & DigitMask] == _depthKeys.size())
+		{
+			continue;
+		}
+
+		//turn the counts into the place each digit starts, then scatter the keys there in order, which keeps the sort stable
+		unsigned int offset = 0;
+		for (unsigned int digit = 0; digit <= DigitMask; digit++)
+		{
+			unsigned int count = histogram[digit];
+			histogram[digit] = offset;
+			offset += count;
+		}
+
+		for (size_t n = 0; n < _depthKeys.size(); n++)
+		{
+			_sortedDepthKeys[histogram[(_depthKeys[n].key >> shift) & DigitMask]++] = _depthKeys[n];
+		}
+
+		_depthKeys.swap(_sortedDepthKeys);
+	}
+
+	for (size_t n = 0; n < _depthKeys.size(); n++)
+	{
+		_drawOrder[n] = _depthKeys[n].polygon;
+	}
 }
 
 //Binary Predicate for sorting by AVG Z
@@ -203,8 +658,9 @@ bool Model::sortByAvgZ(const Polygon3D& lhs, const Polygon3D& rhs)
 void Model::CalculateLightingAmbient(const AmbientLighting& ambientLight)
 {
 
-	for (int i = 0; i < _polygons.size(); i++)
+	for (size_t n = 0; n < _drawOrder.size(); n++)
 	{
+		int i = _drawOrder[n];
 
 		float totalR = 0;
 		float totalG = 0;
@@ -232,8 +688,9 @@ void Model::CalculateLightingDirectional(const std::vector<DirectionalLighting>&
 	float tempG;
 	float tempB;
 
-	for (int i = 0; i < _polygons.size(); i++)
+	for (size_t n = 0; n < _drawOrder.size(); n++)
 	{
+		int i = _drawOrder[n];
 
 		totalR = GetRValue(_polygons[i].GetRGBValue());
 		totalG = GetGValue(_polygons[i].GetRGBValue());;
@@ -275,8 +732,9 @@ void Model::CalculateLightingDirectional(const std::vector<DirectionalLighting>&
 //loops through polygons to calculate the lighting effect from point lighting
 void Model::CalculateLightingPoint(const std::vector<PointLighting>& pointLights)
 {
-	for (int i = 0; i < _polygons.size(); i++)
+	for (size_t n = 0; n < _drawOrder.size(); n++)
 	{
+		int i = _drawOrder[n];
 
 		float totalR = GetRValue(_polygons[i].GetRGBValue());
 		float totalG = GetGValue(_polygons[i].GetRGBValue());
@@ -289,7 +747,7 @@ void Model::CalculateLightingPoint(const std::vector<PointLighting>& pointLights
 			float b = pointLights[j].GetValueB();
 			float c = pointLights[j].GetValueC();
 
-			Vertex vertex0 = _transformedVertices[_polygons[i].GetIndex(0)];
+			Vertex vertex0 = GetWorldVertex(_polygons[i].GetIndex(0));
 			Vertex pointPosition = pointLights[j].GetPointPosition();
 
 			Vector3D vectorToPointLight = vertex0 - pointPosition;
@@ -332,8 +790,12 @@ void Model::CalculateLightingPoint(const std::vector<PointLighting>& pointLights
 //loops through each vertex to calculate the lighting effect from ambient lighting
 void Model::CalculateVertexLightingAmbient(const AmbientLighting& ambientLight)
 {
-	for (int i = 0; i < _transformedVertices.size(); i++)
+	for (size_t i = 0; i < _vertexColours.size(); i++)
 	{
+		if (!_referencedVertices[i])
+		{
+			continue;
+		}
 
 		float totalR = 0;
 		float totalG = 0;
@@ -343,7 +805,7 @@ void Model::CalculateVertexLightingAmbient(const AmbientLighting& ambientLight)
 		totalG += (ambientLight.GetGreenValue() * _ka[1]);
 		totalB += (ambientLight.GetBlueValue() * _ka[2]);
 
-		_transformedVertices[i].SetVertexRGB(RGB(totalR, totalG, totalB));
+		_vertexColours[i] = RGB(totalR, totalG, totalB);
 	}
 }
 
@@ -358,18 +820,22 @@ void Model::CalculateVertexLightingDirectional(const std::vector<DirectionalLigh
 	float tempG;
 	float tempB;
 
-	for (int i = 0; i < _transformedVertices.size(); i++)
+	for (size_t i = 0; i < _vertexColours.size(); i++)
 	{
+		if (!_referencedVertices[i])
+		{
+			continue;
+		}
 
-		totalR = GetRValue(_transformedVertices[i].GetVertexRGB());
-		totalG = GetGValue(_transformedVertices[i].GetVertexRGB());;
-		totalB = GetBValue(_transformedVertices[i].GetVertexRGB());;
+		totalR = GetRValue(_vertexColours[i]);
+		totalG = GetGValue(_vertexColours[i]);;
+		totalB = GetBValue(_vertexColours[i]);;
 
 		for (int j = 0; j < lightingVectors.size(); j++)
 		{
 
 			Vector3D normalisedLightingVector = Vector3D::NormaliseVector(lightingVectors[j].GetLightDirectionVector());
-			Vector3D normalisedVertexNormalVector = Vector3D::NormaliseVector(_transformedVertices[i].GetVertexNormal());
+			Vector3D normalisedVertexNormalVector = Vector3D::NormaliseVector(_vertexNormals[i]);
 
 			tempR = (lightingVectors[j].GetRedValue()) * _kd[0];
 			tempG = (lightingVectors[j].GetGreenValue()) * _kd[1];
@@ -391,7 +857,7 @@ void Model::CalculateVertexLightingDirectional(const std::vector<DirectionalLigh
 		totalG = DirectionalLighting::ClampRGBValues(totalG);
 		totalB = DirectionalLighting::ClampRGBValues(totalB);
 
-		_transformedVertices[i].SetVertexRGB(RGB(int(totalR), int(totalG), int(totalB)));
+		_vertexColours[i] = RGB(int(totalR), int(totalG), int(totalB));
 
 	}
 }
@@ -399,12 +865,16 @@ void Model::CalculateVertexLightingDirectional(const std::vector<DirectionalLigh
 //loops through each vertex to calculate the lighting effect from point lighting
 void Model::CalculateVertexLightingPoint(const std::vector<PointLighting>& pointLights)
 {
-	for (int i = 0; i < _transformedVertices.size(); i++)
+	for (size_t i = 0; i < _vertexColours.size(); i++)
 	{
+		if (!_referencedVertices[i])
+		{
+			continue;
+		}
 
-		float totalR = GetRValue(_transformedVertices[i].GetVertexRGB());
-		float totalG = GetGValue(_transformedVertices[i].GetVertexRGB());
-		float totalB = GetBValue(_transformedVertices[i].GetVertexRGB());
+		float totalR = GetRValue(_vertexColours[i]);
+		float totalG = GetGValue(_vertexColours[i]);
+		float totalB = GetBValue(_vertexColours[i]);
 
 		for (int j = 0; j < pointLights.size(); j++)
 		{
@@ -413,12 +883,12 @@ void Model::CalculateVertexLightingPoint(const std::vector<PointLighting>& point
 			float b = pointLights[j].GetValueB();
 			float c = pointLights[j].GetValueC();
 
-			Vertex vertex0 = _transformedVertices[i];
+			Vertex vertex0 = GetWorldVertex(i);
 			Vertex pointPosition = pointLights[j].GetPointPosition();
 
 			Vector3D vectorToPointLight = vertex0 - pointPosition;
 
-			Vector3D vertexNormalVector = _transformedVertices[i].GetVertexNormal();
+			Vector3D vertexNormalVector = _vertexNormals[i];
 
 			//calculate angle of polygon normal with light point.
 			float angle = acos(Vector3D::CreateDotProduct(vectorToPointLight, vertexNormalVector) / (Vector3D::CalculateMagnitude(vectorToPointLight) * Vector3D::CalculateMagnitude(vertexNormalVector)));
@@ -448,42 +918,98 @@ void Model::CalculateVertexLightingPoint(const std::vector<PointLighting>& point
 		totalG = DirectionalLighting::ClampRGBValues(totalG);
 		totalB = DirectionalLighting::ClampRGBValues(totalB);
 
-		_transformedVertices[i].SetVertexRGB(RGB(int(totalR), int(totalG), int(totalB)));
+		_vertexColours[i] = RGB(int(totalR), int(totalG), int(totalB));
 
 	}
 }
 
-//loops through each polygon and vertex to make sure that the 
-//correct vertex normals are found according to how many vertices contribute to that area of space
+//transforms each object space normal by the normal matrix, which replaces rebuilding the normals from the polygons every frame
 
-void Model::CalculateVertexNormal()
+void Model::TransformVertexNormals(const Matrix& transform)
 {
+	ResizeVertexStreams();
+
+	Matrix normalMatrix = transform.GetNormalMatrix();
+
+	float m00 = normalMatrix.GetM(0, 0), m01 = normalMatrix.GetM(0, 1), m02 = normalMatrix.GetM(0, 2);
+	float m10 = normalMatrix.GetM(1, 0), m11 = normalMatrix.GetM(1, 1), m12 = normalMatrix.GetM(1, 2);
+	float m20 = normalMatrix.GetM(2, 0), m21 = normalMatrix.GetM(2, 1), m22 = normalMatrix.GetM(2, 2);
+
+	const float* normalX = _localNormals.GetX();
+	const float* normalY = _localNormals.GetY();
+	const float* normalZ = _localNormals.GetZ();
 
-	for (int i = 0; i < _transformedVertices.size(); i++)
+	for (size_t i = 0; i < _localNormals.GetCount(); i++)
 	{
-		_transformedVertices[i].SetVertexNormal(Vector3D(0, 0, 0));
-		_transformedVertices[i].SetContributeCount(0);
+		if (!_referencedVertices[i])
+		{
+			continue;
+		}
+
+		float x = normalX[i];
+		float y = normalY[i];
+		float z = normalZ[i];
+
+		Vector3D worldNormal(m00 * x + m01 * y + m02 * z, m10 * x + m11 * y + m12 * z, m20 * x + m21 * y + m22 * z);
+		_vertexNormals[i] = Vector3D::NormaliseVector(worldNormal);
 	}
+}
+
+//loops through each polygon and vertex to make sure that the 
+//correct vertex normals are found according to how many vertices contribute to that area of space.
+//worked out once in object space, from the same polygon normals the back-face test uses
+
+void Model::CalculateLocalVertexNormals()
+{
+	const float* x = _localStream.GetX();
+	const float* y = _localStream.GetY();
+	const float* z = _localStream.GetZ();
+
+	std::vector<int> contributeCounts(_localStream.GetCount(), 0);
+	std::vector<Vector3D> normals(_localStream.GetCount(), Vector3D(0, 0, 0));
 
 	for (int i = 0; i < _polygons.size(); i++)
 	{
-		for (int j = 0; j <= 2; j++)
-		{
-			Vector3D currentPolygonNormal = Vector3D::NormaliseVector(_polygons[i].GetPolygonNormal());
+		int i0 = _polygons[i].GetIndex(0);
+		int i1 = _polygons[i].GetIndex(1);
+		int i2 = _polygons[i].GetIndex(2);
 
-			Vector3D currentVertexNormal = _transformedVertices[_polygons[i].GetIndex(j)].GetVertexNormal();
-			_transformedVertices[_polygons[i].GetIndex(j)].SetVertexNormal(currentVertexNormal + currentPolygonNormal);
+		Vector3D vectorA(x[i0] - x[i1], y[i0] - y[i1], z[i0] - z[i1]);
+		Vector3D vectorB(x[i0] - x[i2], y[i0] - y[i2], z[i0] - z[i2]);
+		Vector3D polygonNormal = Vector3D::CreateCrossProduct(vectorA, vectorB);
 
-			int count = _transformedVertices[_polygons[i].GetIndex(j)].GetContributeCount();
-			_transformedVertices[_polygons[i].GetIndex(j)].SetContributeCount(count += 1);
+		//degenerate polygons have no direction to contribute
+		if (Vector3D::CalculateMagnitude(polygonNormal) == 0)
+		{
+			continue;
+		}
+		polygonNormal = Vector3D::NormaliseVector(polygonNormal);
+
+		for (int j = 0; j <= 2; j++)
+		{
+			int index = _polygons[i].GetIndex(j);
+			normals[index] = normals[index] + polygonNormal;
+			contributeCounts[index] += 1;
 		}
 	}
 
-	for (int i = 0; i < _transformedVertices.size(); i++)
+	_localNormals.Resize(normals.size());
+
+	for (size_t i = 0; i < normals.size(); i++)
 	{
-		
-		Vector3D returnNormal = _transformedVertices[i].GetVertexNormal() / _transformedVertices[i].GetContributeCount();
-		_transformedVertices[i].SetVertexNormal(Vector3D::NormaliseVector(returnNormal));
+		if (contributeCounts[i] > 0)
+		{
+			Vector3D returnNormal = normals[i] / contributeCounts[i];
+			normals[i] = Vector3D::NormaliseVector(returnNormal);
+		}
+
+		_localNormals.Set(i, normals[i].GetX(), normals[i].GetY(), normals[i].GetZ(), 0);
 	}
 
 }
+
+//gathers a world space position from the stream, for the culling and lighting maths
+Vertex Model::GetWorldVertex(int index) const
+{
+	return Vertex(_worldStream.GetX()[index], _worldStream.GetY()[index], _worldStream.GetZ()[index], _worldStream.GetW()[index]);
+}
@@ -10,6 +10,9 @@
 #include "PointLighting.h"
 #include "UVCoord.h"
 #include "Texture.h"
+#include "VertexStream.h"
+#include "KeyframeAnimation.h"
+#include "TriangleClusters.h"
 
 class Model
 {
@@ -17,19 +20,59 @@ public:
 
 	Model();
 	~Model();
+
+	/*
+	Models are moved rather than copied, such as when one that was loaded in the background is handed over
+	*/
+
+	Model(Model&&) = default;
+	Model& operator=(Model&&) = default;
 	
 	/*
 	Accesses the information that is included within the current model render
 	*/
 
-	const std::vector<Polygon3D>& GetPolygons();
-	const std::vector<Vertex>& GetVertices();
-	const std::vector<Vertex>& GetTransVertices();
-	const std::vector<UVCoord>& GetUVCoords();
+	const std::vector<Polygon3D>& GetPolygons() const;
+	const std::vector<UVCoord>& GetUVCoords() const;
 	size_t GetPolygonCount() const;
 	size_t GetVertexCount() const;
 	Texture& GetTexture();
 
+	/*
+	Builds the screen space vertex that the fill methods take, gathering its position,
+	1/w and colour from the separate vertex streams
+	*/
+
+	Vertex GetScreenVertex(int index) const;
+
+	/*
+	Accesses the positions written by ApplyTransformToLocalVertices, for the vertices the polygons that survived culling use
+	*/
+
+	const VertexStream& GetWorldPositions() const;
+
+	/*
+	Accesses the smallest box, aligned to the axes, that contains all of the untransformed vertices
+	*/
+
+	void GetLocalBounds(Vector3D& minimum, Vector3D& maximum) const;
+
+	/*
+	Accesses / mutates the box and sphere that contain the model in every frame of its animation.
+	They are worked out once the model has loaded, or read back from the mesh cache
+	*/
+
+	void GetBoundingBox(Vector3D& minimum, Vector3D& maximum) const;
+	void GetBoundingSphere(Vector3D& centre, float& radius) const;
+	void CalculateBounds();
+	void SetBounds(const Vector3D& minimum, const Vector3D& maximum, const Vector3D& centre, float radius);
+
+	/*
+	Accesses the number of bytes held by the per-vertex streams
+	*/
+
+	size_t GetVertexMemoryUsage() const;
+
 	/*
 	Loads the information needed about the model into vector 
 	collections that we can iterate through to render the model as needed
@@ -39,26 +82,94 @@ public:
 	void AddPolygon(int i0, int i1, int i2, int uvIndex0, int uvIndex1, int uvIndex2);
 	void AddTextureUV(float u, float v);
 
+	/*
+	Accesses the untransformed positions and normals, calculating the normals if they have not been yet,
+	and replaces them with ones worked out before, such as those read from the mesh cache
+	*/
+
+	const VertexStream& GetLocalPositions() const;
+	const VertexStream& GetLocalNormals();
+	void SetMesh(size_t vertexCount, const float* x, const float* y, const float* z, const float* normalX, const float* normalY, const float* normalZ);
+
+	/*
+	Adds one keyframe of the model's animation, from the packed vertices of an MD2 frame.
+	The vertices and polygons are loaded before the frames, and the first frame is also the static mesh
+	*/
+
+	void AddAnimationFrame(const char* name, const float scale[3], const float translate[3], const unsigned char* packedVertices);
+
+	/*
+	Accesses the keyframes of the model, and blends two of them into the local vertices and
+	normals, so that the rest of the pipeline draws the model in that pose
+	*/
+
+	const KeyframeAnimation& GetAnimation() const;
+	KeyframeAnimation& GetAnimation();
+	void SetAnimationPose(const AnimationState& state);
+	void SetAnimationPose(int frameA, int frameB, float t);
+
+	/*
+	Groups the polygons into clusters that back-face culling can reject whole, bounding them in every keyframe
+	and every blend between neighbouring keyframes, once the model has loaded. Accesses the clusters, such as to save them to or read them from the mesh cache
+	*/
+
+	void BuildClusters();
+	const TriangleClusters& GetClusters() const;
+	TriangleClusters& GetClusters();
+
 	/*
 	Applies the transformation that currently needs to be carried out onto the relevant set of vertices
-	Can dehomogenize the vertices to bring them to a 2D plane for rendering on screen
+	Local vertices are transformed into the world vertices, which the world transform takes on into
+	the transformed (screen) vertices. Can dehomogenize the vertices to bring them to a 2D plane for rendering on screen
 	*/
 
 	void ApplyTransformToLocalVertices(const Matrix& transform);
+	void ApplyTransformToWorldVertices(const Matrix& transform);
 	void ApplyTransformToTransformedVertices(const Matrix& transform);
 	void Dehomogenized();
 
+	/*
+	Transforms the local vertices straight to screen space in a single pass, using the combined
+	model, view, projection and viewport matrix, dividing by w as it goes and keeping 1/w
+	for perspective texturing and depth testing. The world space positions written by
+	ApplyTransformToLocalVertices are not needed by this, so lighting and culling can use them first.
+	*/
+
+	void ApplyTransformToScreen(const Matrix& transform);
+
 	/*
 	Calculates which polygons need to be culled, 
-	depending upon which are "back-facing" to the camera view
-	Sorts the polygons (in their collection) so 
-	that the first ones to be rendered are the ones that are furthest away (Painters' Sort)
+	depending upon which are "back-facing" to the camera view, in object space before anything is transformed,
+	marking the vertices the remaining polygons use so that transforming and lighting only work on those
+	Sorts the draw order so 
+	that the first ones to be rendered are the ones that are furthest away (Painters' Sort),
+	using the w kept from the projection as the distance. The polygons themselves are not moved
 	*/
 
-	void CalculateBackfaces(Camera _camera);
+	void CalculateBackfaces(const Matrix& transform, const Camera& camera);
 	void Sort(void);
+
+	/*
+	Leaves nothing to draw, for a model that is entirely outside the view, without looking at any polygon
+	*/
+
+	void CullAll();
 	static bool sortByAvgZ(const Polygon3D& lhs, const Polygon3D& rhs);
 
+	/*
+	Puts the polygons that survived culling furthest first without moving them, by radix sorting
+	a depth key and index for each one. Polygons at the same depth are kept in the order they were loaded
+	*/
+
+	void SortByDepth();
+
+	/*
+	Accesses the indices of the polygons to draw, in the order to draw them, leaving out the culled ones.
+	It is built by CalculateBackfaces and reordered by either sort
+	*/
+
+	const std::vector<int>& GetDrawOrder() const;
+
 	/*
 	Calculates the ambient, directional and point lighting that 
 	is acting upon the polygon, setting the entire polygon colour once this has been calculated.
@@ -78,24 +189,77 @@ public:
 	void CalculateVertexLightingPoint(const std::vector<PointLighting>& pointLights);
 
 	/*
-	Calculates the normal to each vector, taking into account how many polygons repeat the vertex, 
-	in order to find the perfect normal between each of the shared vertices
+	Transforms the vertex normals into world space with the normal matrix of the model transformation.
+	The normals themselves are only calculated once, in object space, unless an animation pose replaces them.
 	*/
 
-	void CalculateVertexNormal();
+	void TransformVertexNormals(const Matrix& transform);
 
 private:
 
+	void ResizeVertexStreams();
+	void CalculateLocalVertexNormals();
+	Vertex GetWorldVertex(int index) const;
+
 	/*
 	members for the vector collections needed to hold model data, 
 	as well as other members for lighting coefficients
 	*/
 
 	std::vector<Polygon3D> _polygons;
-	std::vector<Vertex> _originalVertices;
-	std::vector<Vertex> _transformedVertices;
 	std::vector<UVCoord> _uvCoordinates;
 
+	/*
+	the polygons to draw, and the depth keys the radix sort orders them by, kept between frames so that sorting allocates nothing
+	*/
+
+	struct DepthKey
+	{
+		unsigned int key;
+		int polygon;
+	};
+
+	std::vector<int> _drawOrder;
+	std::vector<DepthKey> _depthKeys;
+	std::vector<DepthKey> _sortedDepthKeys;
+
+	/*
+	which vertices, and which batches of them, are used by the polygons that survived culling
+	*/
+
+	std::vector<unsigned char> _referencedVertices;
+	std::vector<unsigned char> _referencedBatches;
+
+	/*
+	per-vertex data, kept as separate tightly packed streams so that each stage only reads
+	and writes what it needs. Positions are structure-of-arrays for the batch transforms.
+	*/
+
+	VertexStream _localStream;
+	VertexStream _worldStream;
+	VertexStream _screenStream;
+	std::vector<float, AlignedAllocator<float, 32>> _reciprocalW;
+	VertexStream _localNormals;
+	std::vector<Vector3D> _vertexNormals;
+	std::vector<COLORREF> _vertexColours;
+
+	KeyframeAnimation _animation;
+
+	/*
+	the clusters of polygons, the pose whose cluster bounds hold the current one and which clusters were rejected this frame
+	*/
+
+	static const size_t NoClusterPose = static_cast<size_t>(-1);
+
+	TriangleClusters _clusters;
+	size_t _clusterPose{ 0 };
+	std::vector<unsigned char> _clusterCulled;
+
+	Vector3D _boundsMinimum;
+	Vector3D _boundsMaximum;
+	Vector3D _sphereCentre;
+	float _sphereRadius{ 0 };
+
 	Texture _texture;
 
 	float _ka[3];
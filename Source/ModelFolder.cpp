@@ -0,0 +1,48 @@
+#include "ModelFolder.h"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+
+std::vector<std::string> ModelFolder::FindModels(const char* folder)
+{
+	std::vector<std::string> names;
+
+	DIR* directory = opendir(folder);
+	if (directory == nullptr)
+	{
+		return names;
+	}
+
+	while (dirent* entry = readdir(directory))
+	{
+		std::string name = entry->d_name;
+		if (name.size() > 4)
+		{
+			std::string extension = name.substr(name.size() - 4);
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			if (extension == ".md2")
+			{
+				names.push_back(name);
+			}
+		}
+	}
+	closedir(directory);
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+bool ModelFolder::ReadFolderOption(const char* option, const char* value, const char*& modelFolder, const char*& textureFolder)
+{
+	if (strcmp(option, "--models") == 0)
+	{
+		modelFolder = value;
+		return true;
+	}
+	if (strcmp(option, "--textures") == 0)
+	{
+		textureFolder = value;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/*
+The folder handling shared by the command line tools that work through every MD2 model in
+a folder, so that they find the models, and read the options naming the folders, the same way.
+Scanning a folder uses dirent, so like the tools themselves this is not built on Windows.
+*/
+
+class ModelFolder
+{
+public:
+	/*
+	Lists the MD2 files in a folder in name order, so that the tools always work through them
+	in the same order. The list is empty if the folder cannot be opened
+	*/
+
+	static std::vector<std::string> FindModels(const char* folder);
+
+	/*
+	Reads the --models and --textures options into the folders, returning false for any other option
+	*/
+
+	static bool ReadFolderOption(const char* option, const char* value, const char*& modelFolder, const char*& textureFolder);
+};
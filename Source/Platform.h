@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+Pulls in the Windows headers when building the windowed application, otherwise
+provides the small set of colour types and macros the rendering code relies on
+so that it can be built without Win32
+*/
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <cstdint>
+
+typedef unsigned char BYTE;
+typedef uint32_t COLORREF;
+
+#define RGB(r, g, b)	((COLORREF)(((BYTE)(r) | ((COLORREF)((BYTE)(g)) << 8)) | (((COLORREF)(BYTE)(b)) << 16)))
+#define GetRValue(rgb)	((BYTE)(rgb))
+#define GetGValue(rgb)	((BYTE)(((COLORREF)(rgb)) >> 8))
+#define GetBValue(rgb)	((BYTE)(((COLORREF)(rgb)) >> 16))
+
+#endif
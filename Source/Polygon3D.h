@@ -1,6 +1,6 @@
 #pragma once
 #include "Vector3D.h"
-#include <windows.h>
+#include "Platform.h"
 
 class Polygon3D
 {
@@ -0,0 +1,179 @@
+#include "PolygonClipper.h"
+#include "Platform.h"
+
+const int PolygonClipper::MaxVertices;
+const float PolygonClipper::GuardBand = 4.0f;
+
+PolygonClipper::PolygonClipper(const Matrix& clipMatrix, const Matrix& screenMatrix, float nearW)
+{
+	_clipMatrix = clipMatrix;
+	_screenMatrix = screenMatrix;
+	_nearW = nearW;
+
+	//the screen runs from -1 to 1 after the divide, which the screen matrix scales and offsets, flipping y
+	float scaleX = screenMatrix.GetM(0, 0);
+	float scaleY = screenMatrix.GetM(1, 1);
+	float centreX = screenMatrix.GetM(0, 3);
+	float centreY = screenMatrix.GetM(1, 3);
+	scaleX = scaleX < 0 ? -scaleX : scaleX;
+	scaleY = scaleY < 0 ? -scaleY : scaleY;
+
+	_screenMinX = centreX - scaleX;
+	_screenMaxX = centreX + scaleX;
+	_screenMinY = centreY - scaleY;
+	_screenMaxY = centreY + scaleY;
+
+	_bandMinX = centreX - scaleX * GuardBand;
+	_bandMaxX = centreX + scaleX * GuardBand;
+	_bandMinY = centreY - scaleY * GuardBand;
+	_bandMaxY = centreY + scaleY * GuardBand;
+}
+
+int PolygonClipper::Clip(Vertex* vertices, const int indices[3], const VertexStream& worldPositions) const
+{
+	//the screen position of a vertex is only meaningful when it is in front of the near plane, which 1/w shows without going back to clip space.
+	//the sides of the screen each vertex is beyond are and-ed, so a triangle wholly beyond one of them is left with that bit set
+	bool needsClipping = false;
+	int outside = 0xF;
+	for (int i = 0; i < 3; i++)
+	{
+		float zr = vertices[i].GetZR();
+		if (!(zr > 0 && zr * _nearW <= 1))
+		{
+			needsClipping = true;
+			outside = 0;
+			continue;
+		}
+
+		float x = vertices[i].GetX();
+		float y = vertices[i].GetY();
+		int sides = (x < _screenMinX ? 1 : 0) | (x > _screenMaxX ? 2 : 0) | (y < _screenMinY ? 4 : 0) | (y > _screenMaxY ? 8 : 0);
+		outside &= sides;
+
+		if (x < _bandMinX || x > _bandMaxX || y < _bandMinY || y > _bandMaxY)
+		{
+			needsClipping = true;
+		}
+	}
+
+	if (outside != 0)
+	{
+		return 0;
+	}
+	if (!needsClipping)
+	{
+		return 3;
+	}
+
+	//takes the triangle back to clip space from its world space positions, which are never divided and so stay exact
+	ClipVertex polygon[MaxVertices];
+	ClipVertex clipped[MaxVertices];
+	for (int i = 0; i < 3; i++)
+	{
+		int index = indices[i];
+		Vertex position = _clipMatrix * Vertex(worldPositions.GetX()[index], worldPositions.GetY()[index], worldPositions.GetZ()[index], 1);
+		polygon[i].position[0] = position.GetX();
+		polygon[i].position[1] = position.GetY();
+		polygon[i].position[2] = position.GetZ();
+		polygon[i].position[3] = position.GetW();
+
+		COLORREF colour = vertices[i].GetVertexRGB();
+		polygon[i].colour[0] = GetRValue(colour);
+		polygon[i].colour[1] = GetGValue(colour);
+		polygon[i].colour[2] = GetBValue(colour);
+
+		polygon[i].uv[0] = vertices[i].GetUVCoord().GetU();
+		polygon[i].uv[1] = vertices[i].GetUVCoord().GetV();
+	}
+
+	//each plane as its x, y, z and w coefficients and a constant, with the inside where they add up to 0 or more.
+	//the near plane is always clipped against, as the band's planes only hold for points in front of it
+	const float planes[5][5] =
+	{
+		{ 0, 0, 0, 1, -_nearW },
+		{ 1, 0, 0, GuardBand, 0 },
+		{ -1, 0, 0, GuardBand, 0 },
+		{ 0, 1, 0, GuardBand, 0 },
+		{ 0, -1, 0, GuardBand, 0 }
+	};
+
+	int count = 3;
+	for (int i = 0; i < 5 && count >= 3; i++)
+	{
+		count = ClipAgainstPlane(polygon, count, clipped, planes[i]);
+		for (int j = 0; j < count; j++)
+		{
+			polygon[j] = clipped[j];
+		}
+	}
+	if (count < 3)
+	{
+		return 0;
+	}
+
+	//divides by w and maps to the screen as the transform stage does, keeping 1/w for depth and perspective texturing
+	for (int i = 0; i < count; i++)
+	{
+		float reciprocalW = 1.0f / polygon[i].position[3];
+		Vertex screen = _screenMatrix * Vertex(polygon[i].position[0] * reciprocalW, polygon[i].position[1] * reciprocalW, polygon[i].position[2] * reciprocalW, 1);
+
+		vertices[i] = Vertex(screen.GetX(), screen.GetY(), screen.GetZ(), 1);
+		vertices[i].SetZR(reciprocalW);
+		vertices[i].SetVertexRGB(RGB((int)(polygon[i].colour[0] + 0.5f), (int)(polygon[i].colour[1] + 0.5f), (int)(polygon[i].colour[2] + 0.5f)));
+		vertices[i].SetUVCoord(UVCoord(polygon[i].uv[0], polygon[i].uv[1]));
+	}
+
+	return count;
+}
+
+// Sutherland-Hodgman against one plane: walks the edges of the polygon, keeping the vertices inside it and
+// adding a vertex wherever an edge crosses it
+
+int PolygonClipper::ClipAgainstPlane(const ClipVertex* input, int count, ClipVertex* output, const float plane[5]) const
+{
+	int outputCount = 0;
+
+	const ClipVertex* previous = &input[count - 1];
+	float previousDistance = plane[0] * previous->position[0] + plane[1] * previous->position[1] + plane[2] * previous->position[2] + plane[3] * previous->position[3] + plane[4];
+
+	for (int i = 0; i < count; i++)
+	{
+		const ClipVertex* current = &input[i];
+		float currentDistance = plane[0] * current->position[0] + plane[1] * current->position[1] + plane[2] * current->position[2] + plane[3] * current->position[3] + plane[4];
+
+		//the crossing is found from the previous vertex towards the current one, or the other way, always from the inside,
+		//so that an edge shared by two triangles is split at exactly the same point in both
+		if ((previousDistance >= 0) != (currentDistance >= 0))
+		{
+			const ClipVertex* from = previousDistance >= 0 ? previous : current;
+			const ClipVertex* to = previousDistance >= 0 ? current : previous;
+			float fromDistance = previousDistance >= 0 ? previousDistance : currentDistance;
+			float toDistance = previousDistance >= 0 ? currentDistance : previousDistance;
+			float t = fromDistance / (fromDistance - toDistance);
+
+			ClipVertex& crossing = output[outputCount++];
+			for (int j = 0; j < 4; j++)
+			{
+				crossing.position[j] = from->position[j] + t * (to->position[j] - from->position[j]);
+			}
+			for (int j = 0; j < 3; j++)
+			{
+				crossing.colour[j] = from->colour[j] + t * (to->colour[j] - from->colour[j]);
+			}
+			for (int j = 0; j < 2; j++)
+			{
+				crossing.uv[j] = from->uv[j] + t * (to->uv[j] - from->uv[j]);
+			}
+		}
+
+		if (currentDistance >= 0)
+		{
+			output[outputCount++] = *current;
+		}
+
+		previous = current;
+		previousDistance = currentDistance;
+	}
+
+	return outputCount;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "Matrix.h"
+#include "Vertex.h"
+#include "VertexStream.h"
+
+/*
+Clips the triangles of a model in homogeneous clip space, between projecting them and filling them.
+
+The projection divides by w, so a vertex at or behind the camera lands at a huge or mirrored
+point on the screen. Triangles with a vertex nearer than the near plane are clipped against
+it with Sutherland-Hodgman, before the divide, and so are never filled from such points.
+
+The other planes use a guard band instead. A triangle that crosses the edge of the screen is
+left whole as long as it stays inside a band around the screen GuardBand times its size, and
+the fillers scissor its spans to the screen, which costs less than clipping it. Only a
+triangle that reaches beyond the band is clipped to the band's edges, which keeps every
+coordinate the fillers see small enough to step through quickly and to hold in fixed point.
+A triangle wholly off one side of the screen is rejected outright.
+
+Triangles entirely in front of the near plane and inside the band, which are nearly all of
+them, are checked from the screen position and 1/w they already have and passed through
+untouched. Only the rest go back to their world space positions to be clipped, with colour
+and UV interpolated along the clipped edges.
+*/
+
+class PolygonClipper
+{
+public:
+
+	/*
+	The most vertices a clipped triangle can have, one more than the triangle for each plane that cuts it
+	*/
+
+	static const int MaxVertices = 8;
+
+	/*
+	How far the guard band reaches, as a multiple of the distance from the centre of the screen to its edge
+	*/
+
+	static const float GuardBand;
+
+	/*
+	Creates a clipper that takes world space to clip space with clipMatrix and clip space after the
+	divide to the screen with screenMatrix, with the near plane at nearW
+	*/
+
+	PolygonClipper(const Matrix& clipMatrix, const Matrix& screenMatrix, float nearW);
+
+	/*
+	Clips the triangle whose screen space vertices, with 1/w, colour and UV set, are the first 3 in vertices,
+	given the indices of those vertices in the world space positions. The clipped polygon is convex and is
+	written back into vertices, returning how many it has: 3 when the triangle needs no clipping and 0 when
+	none of it can be seen
+	*/
+
+	int Clip(Vertex* vertices, const int indices[3], const VertexStream& worldPositions) const;
+
+private:
+
+	/*
+	A vertex in clip space, with the values that are interpolated along a clipped edge
+	*/
+
+	struct ClipVertex
+	{
+		float position[4];
+		float colour[3];
+		float uv[2];
+	};
+
+	int ClipAgainstPlane(const ClipVertex* input, int count, ClipVertex* output, const float plane[5]) const;
+
+	/*
+	The matrices and near plane, and the screen and guard band as ranges of screen coordinates
+	*/
+
+	Matrix _clipMatrix;
+	Matrix _screenMatrix;
+	float _nearW;
+
+	float _screenMinX, _screenMaxX, _screenMinY, _screenMaxY;
+	float _bandMinX, _bandMaxX, _bandMinY, _bandMaxY;
+};
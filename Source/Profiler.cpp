@@ -0,0 +1,175 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+const size_t Profiler::HistoryLength;
+const size_t Profiler::MaxTraceEvents;
+const size_t Profiler::StageCount;
+
+static const char* const stageNames[] =
+{
+	"Frame",
+	"Clear",
+	"FrustumCull",
+	"OcclusionCull",
+	"LocalTransform",
+	"Backfaces",
+	"NormalTransform",
+	"PolygonLightingAmbient",
+	"PolygonLightingDirectional",
+	"PolygonLightingPoint",
+	"VertexLightingAmbient",
+	"VertexLightingDirectional",
+	"VertexLightingPoint",
+	"ScreenTransform",
+	"ViewTransform",
+	"Projection",
+	"Dehomogenise",
+	"Viewport",
+	"Sort",
+	"DrawWireFrame",
+	"DrawSolidFlat",
+	"DrawFlat",
+	"DrawGouraud",
+	"DrawTextured",
+	"TileFill"
+};
+
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == static_cast<size_t>(ProfileStage::Count), "every profile stage needs a name");
+
+void Profiler::SetEnabled(bool enabled)
+{
+	_enabled = enabled;
+
+	if (enabled)
+	{
+		//everything is allocated up front, so recording never allocates during a frame
+		_history.assign(HistoryLength * StageCount, -1.0);
+		_historyFrames = 0;
+		_events.clear();
+		_events.reserve(MaxTraceEvents);
+		_origin = Clock::now();
+		_frame = 0;
+		std::fill(_currentFrame, _currentFrame + StageCount, -1.0);
+	}
+}
+
+void Profiler::BeginFrame()
+{
+	if (!_enabled)
+	{
+		return;
+	}
+
+	std::fill(_currentFrame, _currentFrame + StageCount, -1.0);
+	_frameStart = Clock::now();
+}
+
+void Profiler::EndFrame()
+{
+	if (!_enabled)
+	{
+		return;
+	}
+
+	//the frame itself is timed from BeginFrame, so that it contains every other stage
+	Record(ProfileStage::Frame, _frameStart, Clock::now());
+
+	//overwrites the oldest frame once the history is full
+	double* history = _history.data() + (_historyFrames % HistoryLength) * StageCount;
+	std::copy(_currentFrame, _currentFrame + StageCount, history);
+	_historyFrames++;
+	_frame++;
+}
+
+void Profiler::Record(ProfileStage stage, Clock::time_point start, Clock::time_point end)
+{
+	size_t index = static_cast<size_t>(stage);
+	double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	//a stage that runs more than once in a frame is totalled
+	_currentFrame[index] = _currentFrame[index] < 0.0 ? milliseconds : _currentFrame[index] + milliseconds;
+
+	//once the trace is full, later scopes are only counted in the statistics
+	if (_events.size() < _events.capacity())
+	{
+		TraceEvent event;
+		event.stage = stage;
+		event.frame = _frame;
+		event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - _origin).count();
+		event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		_events.push_back(event);
+	}
+}
+
+StageStatistics Profiler::GetStatistics(ProfileStage stage) const
+{
+	StageStatistics statistics;
+	size_t index = static_cast<size_t>(stage);
+	size_t frames = _historyFrames < HistoryLength ? _historyFrames : HistoryLength;
+
+	//gathers the frames in which the stage ran
+	std::vector<double> durations;
+	durations.reserve(frames);
+	for (size_t i = 0; i < frames; i++)
+	{
+		double duration = _history[i * StageCount + index];
+		if (duration >= 0.0)
+		{
+			durations.push_back(duration);
+		}
+	}
+
+	if (durations.empty())
+	{
+		return statistics;
+	}
+
+	std::sort(durations.begin(), durations.end());
+
+	double total = 0.0;
+	for (size_t i = 0; i < durations.size(); i++)
+	{
+		total += durations[i];
+	}
+
+	//nearest rank percentile
+	size_t rank = (durations.size() * 99 + 99) / 100;
+
+	statistics.frames = static_cast<unsigned int>(durations.size());
+	statistics.minimum = durations.front();
+	statistics.mean = total / durations.size();
+	statistics.p99 = durations[rank - 1];
+	return statistics;
+}
+
+const char* Profiler::GetStageName(ProfileStage stage)
+{
+	return stageNames[static_cast<size_t>(stage)];
+}
+
+bool Profiler::ExportChromeTrace(const char* filename) const
+{
+	std::ofstream file(filename);
+	if (!file)
+	{
+		return false;
+	}
+
+	//complete ("X") events on a single thread, with times in microseconds
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (size_t i = 0; i < _events.size(); i++)
+	{
+		const TraceEvent& event = _events[i];
+		char line[256];
+		snprintf(line, sizeof(line),
+			"{\"name\":\"%s\",\"cat\":\"render\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}%s\n",
+			GetStageName(event.stage), event.start / 1000.0, event.duration / 1000.0, event.frame,
+			i + 1 < _events.size() ? "," : "");
+		file << line;
+	}
+	file << "]}\n";
+
+	return file.good();
+}
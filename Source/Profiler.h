@@ -0,0 +1,168 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+/*
+The parts of a frame that are timed. Frame runs from BeginFrame to EndFrame, covering all of
+Rasteriser::Render, and the tile fill stage is nested inside the draw stage that fills the tiles
+*/
+
+enum class ProfileStage
+{
+	Frame,
+	Clear,
+	FrustumCull,
+	OcclusionCull,
+	LocalTransform,
+	Backfaces,
+	NormalTransform,
+	PolygonLightingAmbient,
+	PolygonLightingDirectional,
+	PolygonLightingPoint,
+	VertexLightingAmbient,
+	VertexLightingDirectional,
+	VertexLightingPoint,
+	ScreenTransform,
+	ViewTransform,
+	Projection,
+	Dehomogenise,
+	Viewport,
+	Sort,
+	DrawWireFrame,
+	DrawSolidFlat,
+	DrawFlat,
+	DrawGouraud,
+	DrawTextured,
+	TileFill,
+	Count
+};
+
+/*
+Summary of how long a stage took over the frames that have been profiled, in milliseconds
+*/
+
+struct StageStatistics
+{
+	unsigned int frames{ 0 };
+	double minimum{ 0 };
+	double mean{ 0 };
+	double p99{ 0 };
+};
+
+/*
+Collects how long each stage of the frame takes, from ProfileScope timers placed around them.
+
+Each stage's time is totalled per frame, and the last HistoryLength frames are kept to give the
+minimum, mean and 99th percentile. Every timed scope is also kept as an event (up to
+MaxTraceEvents of them) that can be exported as Chrome trace JSON and viewed as a timeline in
+chrome://tracing or Perfetto.
+
+The profiler starts disabled, and then a scope costs one test of a flag. All the memory is
+allocated when it is enabled, so profiling does not add allocations to the frames themselves.
+The scopes must all be on the thread that calls BeginFrame and EndFrame.
+*/
+
+class Profiler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static const size_t HistoryLength = 4096;
+	static const size_t MaxTraceEvents = 1 << 18;
+
+	/*
+	Accesses / mutates whether timings are collected. Enabling clears anything collected before
+	*/
+
+	bool IsEnabled() const
+	{
+		return _enabled;
+	}
+
+	void SetEnabled(bool enabled);
+
+	/*
+	Marks the start and end of a frame, timing the frame as a whole and totalling the stage times recorded in between
+	*/
+
+	void BeginFrame();
+	void EndFrame();
+
+	/*
+	Adds the time of one scope to the current frame. Called by ProfileScope
+	*/
+
+	void Record(ProfileStage stage, Clock::time_point start, Clock::time_point end);
+
+	/*
+	Accesses the statistics of each stage, and the name it is shown with
+	*/
+
+	StageStatistics GetStatistics(ProfileStage stage) const;
+	static const char* GetStageName(ProfileStage stage);
+
+	/*
+	Writes every recorded scope to a Chrome trace event JSON file
+	*/
+
+	bool ExportChromeTrace(const char* filename) const;
+
+private:
+	struct TraceEvent
+	{
+		ProfileStage stage;
+		unsigned int frame;
+		long long start;
+		long long duration;
+	};
+
+	static const size_t StageCount = static_cast<size_t>(ProfileStage::Count);
+
+	bool _enabled{ false };
+	Clock::time_point _origin;
+	Clock::time_point _frameStart;
+	unsigned int _frame{ 0 };
+
+	//time of each stage in the frame being recorded, negative for stages that have not run
+	double _currentFrame[StageCount];
+
+	//ring of the last HistoryLength frames, each StageCount durations long
+	std::vector<double> _history;
+	size_t _historyFrames{ 0 };
+
+	std::vector<TraceEvent> _events;
+};
+
+/*
+Times the scope it is declared in, adding the time to the profiler when it goes out of scope
+*/
+
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler& profiler, ProfileStage stage) : _profiler(profiler), _stage(stage), _active(profiler.IsEnabled())
+	{
+		if (_active)
+		{
+			_start = Profiler::Clock::now();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (_active)
+		{
+			_profiler.Record(_stage, _start, Profiler::Clock::now());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler& _profiler;
+	ProfileStage _stage;
+	bool _active;
+	Profiler::Clock::time_point _start;
+};
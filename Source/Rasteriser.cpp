@@ -6,7 +6,10 @@
 //define the value of pi to use later
 #define PI 3.14159265
 
+//the windowed application runs this instance, the command line renderer creates its own
+#ifdef _WIN32
 Rasteriser app;
+#endif
 
 //define starting values for demonstration
 float angle = 0.0f;
@@ -14,7 +17,7 @@ float translateValue = 0.0f;
 float scaleValue = 0.0f;
 int renderCount = 0;
 
-bool Rasteriser::Initialise()
+Rasteriser::Rasteriser()
 {
 	//create camera
 	Vertex position = Vertex(0, 0, -50, 1);
@@ -25,20 +28,93 @@ bool Rasteriser::Initialise()
 
 	_lightingPoints.push_back(PointLighting(255, 255, 255, (Vertex(0, 0, -50, 1)), 0.0f, 1.0f, 0.0f));
 
-	//load the model and texture, populate collections with vertices, polygons and coords
-	if (!MD2Loader::LoadModel("MD2 Files\\marvin.md2" , "Texture Files\\marvin.pcx" , _model,
-		&Model::AddPolygon,
-		&Model::AddVertex,
-		&Model::AddTextureUV))
-	{
-		return false;
-	}
+	//start with the model untransformed
+	_currentModelTransformation = { 1, 0, 0, 0,
+									0, 1, 0, 0,
+									0, 0, 1, 0,
+									0, 0, 0, 1 };
+}
 
+bool Rasteriser::Initialise()
+{
+	//the window opens straight away and the model appears once it has loaded
+	LoadModelAsync("MD2 Files\\marvin.md2", "Texture Files\\marvin.pcx");
 	return true;
-
 } 
 
+bool Rasteriser::LoadModel(const char* modelFile, const char* textureFile, const char* cacheFile)
+{
+	return AssetLoader::Load(modelFile, textureFile, cacheFile, _model);
+}
+
+void Rasteriser::LoadModelAsync(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile)
+{
+	//the callback runs from DeliverCompleted in Update, so the model is never swapped partway through a frame
+	_assetLoader.LoadModel(modelFile, textureFile, cacheFile, [this, modelFile](AssetLoader::ModelPointer model)
+	{
+		if (model)
+		{
+			_model = std::move(*model);
+		}
+		else
+		{
+			_loadError = "Unable to load " + modelFile;
+		}
+	});
+}
+
+AssetLoader& Rasteriser::GetAssetLoader()
+{
+	return _assetLoader;
+}
+
+void Rasteriser::SetModelTransformation(const Matrix& transformation)
+{
+	_currentModelTransformation = transformation;
+}
+
+void Rasteriser::SetCamera(const Camera& camera)
+{
+	_camera = camera;
+}
+
+void Rasteriser::SetAnimationPose(const AnimationState& state)
+{
+	_model.SetAnimationPose(state);
+}
+
 void Rasteriser::Update(const Bitmap& bitmap)
+{
+	//swap in any models that have finished loading in the background
+	_assetLoader.DeliverCompleted();
+
+	//without its model the window has nothing to show, so a failed load closes it as a failed Initialise used to
+	if (!_loadError.empty())
+	{
+		Close(_loadError.c_str());
+		_loadError.clear();
+	}
+
+	//the demo moves the model itself, otherwise the transformation is left as it was set
+	if (_settings.shadingMode == ShadingMode::DemoCycle)
+	{
+		UpdateDemoCycle();
+	}
+
+	_d = 1;
+
+	//calculate the aspect ratio of window to consider when multiplying matrices
+	_width = bitmap.GetWidth();
+	_height = bitmap.GetHeight();
+
+	_aspectRatio = float(_width) / float(_height);
+
+	//generate the relevant matrices dependant on these values
+	GeneratePerspectiveMatrix(_d, _aspectRatio);
+	GenerateViewMatrix(_d, _width, _height);
+}
+
+void Rasteriser::UpdateDemoCycle()
 {
 
 	//convert angle to radians for matrix maths
@@ -93,18 +169,6 @@ void Rasteriser::Update(const Bitmap& bitmap)
 										 0, 0, 0, 1 };
 	}
 
-	_d = 1;
-
-	//calculate the aspect ratio of window to consider when multiplying matrices
-	_width = bitmap.GetWidth();
-	_height = bitmap.GetHeight();
-
-	_aspectRatio = float(_width) / float(_height);
-
-	//generate the relevant matrices dependant on these values
-	GeneratePerspectiveMatrix(_d, _aspectRatio);
-	GenerateViewMatrix(_d, _width, _height);
-
 	//increment the transformation values
 	angle++;
 	translateValue++;
@@ -113,25 +177,286 @@ void Rasteriser::Update(const Bitmap& bitmap)
 
 void Rasteriser::Render(const Bitmap& bitmap)
 {
-	//clear window of old drawings
-	bitmap.Clear(RGB (0, 0, 0));
-
-	//apply transformations, back-face culling, sorting, lighting, and dehomogenization to all relevant collections before drawing
-	_model.ApplyTransformToLocalVertices(_currentModelTransformation);
-	_model.CalculateBackfaces(_camera);
-	_model.CalculateVertexNormal();
-	_model.CalculateLightingAmbient(AmbientLighting(32, 32, 32));
-	_model.CalculateLightingDirectional(_lightingVectors);
-	_model.CalculateLightingPoint(_lightingPoints);
-	_model.CalculateVertexLightingAmbient(AmbientLighting(32, 32, 32));
-	_model.CalculateVertexLightingDirectional(_lightingVectors);
-	_model.CalculateVertexLightingPoint(_lightingPoints);
-	_model.ApplyTransformToTransformedVertices(_camera.CreateViewingMatrix());
-	_model.Sort();
-	_model.ApplyTransformToTransformedVertices(perspectiveTransformationMatrix);
-	_model.Dehomogenized();
-	_model.ApplyTransformToTransformedVertices(viewTransformationMatrix);
+	unsigned long long allocationCount = AllocationCounter::GetAllocationCount();
+	_profiler.BeginFrame();
+
+	{
+		ProfileScope scope(_profiler, ProfileStage::Clear);
+
+		//clear window of old drawings
+		bitmap.Clear(RGB (0, 0, 0));
+
+		//clear the depth buffer to the furthest possible 1/w, resizing it if the window has changed
+		if (_settings.depthMode == DepthMode::ZBuffer)
+		{
+			_depthBuffer.resize(bitmap.GetStride() * bitmap.GetHeight());
+			std::fill(_depthBuffer.begin(), _depthBuffer.end(), 0.0f);
+		}
+	}
+
+	//resize the thread pool if the thread count has changed, 0 meaning one thread per core
+	unsigned int threadCount = _settings.threadCount;
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	_threadPool.SetThreadCount(threadCount);
+	_tileBinner.ResetTimings();
+
+	//the demo moves and labels a single model, so instances are only drawn in the other modes
+	if (_instances.empty() || _settings.shadingMode == ShadingMode::DemoCycle)
+	{
+		DrawModel(bitmap);
+	}
+	else
+	{
+		DrawInstances(bitmap);
+	}
+
+	//the draw loops work on references and stack triangles, so this should stay at zero from frame to frame
+	_frameAllocationCount = AllocationCounter::GetAllocationCount() - allocationCount;
+	_profiler.EndFrame();
+}
+
+void Rasteriser::DrawModel(const Bitmap& bitmap)
+{
+	//a model entirely outside the view is rejected from its bounds, and none of its vertices or polygons are touched
+	bool visible;
+	{
+		ProfileScope scope(_profiler, ProfileStage::FrustumCull);
+		visible = IsModelInView();
+	}
+	if (visible)
+	{
+		PrepareModel();
+	}
+	else
+	{
+		_model.CullAll();
+	}
+
+	//draw the model the way the settings ask for
+	switch (_settings.shadingMode)
+	{
+	case ShadingMode::DemoCycle:
+		RenderDemoCycle(bitmap);
+		break;
+	case ShadingMode::Wireframe:
+		DrawWireFrame(bitmap);
+		break;
+	case ShadingMode::Flat:
+		MyDrawSolidFlat(bitmap);
+		break;
+	case ShadingMode::Gouraud:
+		GouraudShading(bitmap);
+		break;
+	case ShadingMode::Textured:
+		DrawSolidTextured(bitmap);
+		break;
+	}
+}
+
+void Rasteriser::DrawInstances(const Bitmap& bitmap)
+{
+	Matrix modelTransformation = _currentModelTransformation;
+	Matrix viewingMatrix = _camera.CreateViewingMatrix();
+
+	Vector3D centre;
+	float radius;
+	_model.GetBoundingSphere(centre, radius);
+
+	//orders the instances nearest first by the depth of their bounding sphere's centre, so that the nearest are drawn
+	//first as the occluders, and the rest are tested from front to back
+	_instanceOrder.resize(_instances.size());
+	for (size_t i = 0; i < _instances.size(); i++)
+	{
+		Vertex viewCentre = viewingMatrix * _instances[i] * modelTransformation * Vertex(centre.GetX(), centre.GetY(), centre.GetZ(), 1);
+		_instanceOrder[i].depth = viewCentre.GetZ();
+		_instanceOrder[i].index = static_cast<int>(i);
+	}
+	std::sort(_instanceOrder.begin(), _instanceOrder.end(), [](const InstanceDepth& lhs, const InstanceDepth& rhs)
+	{
+		return lhs.depth < rhs.depth || (lhs.depth == rhs.depth && lhs.index < rhs.index);
+	});
+
+	//occlusion needs the depth buffer, which the painters' sort does not keep
+	bool occlusionCulling = _settings.occlusionCulling && _settings.depthMode == DepthMode::ZBuffer;
+	size_t occluderCount = _settings.occluderCount;
+	_occludedInstanceCount = 0;
+
+	for (size_t n = 0; n < _instanceOrder.size(); n++)
+	{
+		_currentModelTransformation = _instances[_instanceOrder[n].index] * modelTransformation;
+
+		if (occlusionCulling && n >= occluderCount)
+		{
+			bool occluded;
+			{
+				ProfileScope scope(_profiler, ProfileStage::OcclusionCull);
+
+				//the pyramid is built once, from the depth the occluders left, and every later instance is tested against it
+				if (n == occluderCount)
+				{
+					_depthPyramid.Build(_depthBuffer.data(), bitmap.GetStride(), bitmap.GetWidth(), bitmap.GetHeight());
+				}
+				occluded = IsModelOccluded();
+			}
+			if (occluded)
+			{
+				_occludedInstanceCount++;
+				continue;
+			}
+		}
+
+		DrawModel(bitmap);
+	}
+
+	_currentModelTransformation = modelTransformation;
+}
+
+bool Rasteriser::IsModelOccluded()
+{
+	//projects the corners of the box around the model, which hold every point of it, to find the rectangle of the
+	//screen it can cover and the nearest 1/w it can have there
+	Matrix clipMatrix = perspectiveTransformationMatrix * _camera.CreateViewingMatrix() * _currentModelTransformation;
+	Matrix screenMatrix = CreateScreenMatrix();
+	float nearW = _d * _settings.nearPlane;
+
+	Vector3D minimum, maximum;
+	_model.GetBoundingBox(minimum, maximum);
+
+	float minX = 0, minY = 0, maxX = 0, maxY = 0, nearest = 0;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		Vertex position((corner & 1) ? maximum.GetX() : minimum.GetX(),
+						(corner & 2) ? maximum.GetY() : minimum.GetY(),
+						(corner & 4) ? maximum.GetZ() : minimum.GetZ(), 1);
+		Vertex clip = clipMatrix * position;
+
+		//a box reaching in front of the near plane could cover any part of the screen, so it is never treated as hidden
+		if (!(clip.GetW() >= nearW))
+		{
+			return false;
+		}
+
+		float reciprocalW = 1.0f / clip.GetW();
+		Vertex screen = screenMatrix * Vertex(clip.GetX() * reciprocalW, clip.GetY() * reciprocalW, clip.GetZ() * reciprocalW, 1);
+
+		minX = corner == 0 || screen.GetX() < minX ? screen.GetX() : minX;
+		minY = corner == 0 || screen.GetY() < minY ? screen.GetY() : minY;
+		maxX = corner == 0 || screen.GetX() > maxX ? screen.GetX() : maxX;
+		maxY = corner == 0 || screen.GetY() > maxY ? screen.GetY() : maxY;
+		nearest = reciprocalW > nearest ? reciprocalW : nearest;
+	}
+
+	//widened to whole pixels, so every pixel whose centre the model could cover is tested
+	return _depthPyramid.IsOccluded((int)floor(minX), (int)floor(minY), (int)ceil(maxX), (int)ceil(maxY), nearest);
+}
+
+bool Rasteriser::IsModelInView()
+{
+	if (!_settings.frustumCulling)
+	{
+		return true;
+	}
+
+	//the planes are taken from the whole transformation to clip space, so they come out in the model's space, where its bounds are
+	Matrix clipMatrix = perspectiveTransformationMatrix * _camera.CreateViewingMatrix() * _currentModelTransformation;
+	Frustum frustum(clipMatrix, _d * _settings.nearPlane, _d * _settings.farPlane);
+
+	Vector3D minimum, maximum, centre;
+	float radius;
+	_model.GetBoundingBox(minimum, maximum);
+	_model.GetBoundingSphere(centre, radius);
+
+	return frustum.TestBounds(minimum, maximum, centre, radius) != FrustumTest::Outside;
+}
+
+void Rasteriser::PrepareModel()
+{
+	//apply back-face culling, transformations, sorting, lighting, and dehomogenization to all relevant collections before drawing,
+	//timing each one separately. Culling comes first, so that the rest only work on the polygons that can be seen
+	{
+		ProfileScope scope(_profiler, ProfileStage::Backfaces);
+		_model.CalculateBackfaces(_currentModelTransformation, _camera);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::LocalTransform);
+		_model.ApplyTransformToLocalVertices(_currentModelTransformation);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::NormalTransform);
+		_model.TransformVertexNormals(_currentModelTransformation);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::PolygonLightingAmbient);
+		_model.CalculateLightingAmbient(AmbientLighting(32, 32, 32));
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::PolygonLightingDirectional);
+		_model.CalculateLightingDirectional(_lightingVectors);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::PolygonLightingPoint);
+		_model.CalculateLightingPoint(_lightingPoints);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::VertexLightingAmbient);
+		_model.CalculateVertexLightingAmbient(AmbientLighting(32, 32, 32));
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::VertexLightingDirectional);
+		_model.CalculateVertexLightingDirectional(_lightingVectors);
+	}
+	{
+		ProfileScope scope(_profiler, ProfileStage::VertexLightingPoint);
+		_model.CalculateVertexLightingPoint(_lightingPoints);
+	}
+
+	//take the vertices to the screen, either in one pass or a stage at a time
+	if (_settings.transformPipeline == TransformPipeline::Fused)
+	{
+		ProfileScope scope(_profiler, ProfileStage::ScreenTransform);
+
+		_model.ApplyTransformToScreen(CreateScreenMatrix() * perspectiveTransformationMatrix * _camera.CreateViewingMatrix() * _currentModelTransformation);
+	}
+	else
+	{
+		{
+			ProfileScope scope(_profiler, ProfileStage::ViewTransform);
+			_model.ApplyTransformToWorldVertices(_camera.CreateViewingMatrix());
+		}
+		{
+			ProfileScope scope(_profiler, ProfileStage::Projection);
+			_model.ApplyTransformToTransformedVertices(perspectiveTransformationMatrix);
+		}
+		{
+			ProfileScope scope(_profiler, ProfileStage::Dehomogenise);
+			_model.Dehomogenized();
+		}
+		{
+			ProfileScope scope(_profiler, ProfileStage::Viewport);
+			_model.ApplyTransformToTransformedVertices(viewTransformationMatrix);
+		}
+	}
 
+	//the painters' sort is only needed when there is no depth buffer to resolve overlaps
+	if (_settings.depthMode == DepthMode::PaintersSort)
+	{
+		ProfileScope scope(_profiler, ProfileStage::Sort);
+		if (_settings.depthSort == DepthSort::Radix)
+		{
+			_model.SortByDepth();
+		}
+		else
+		{
+			_model.Sort();
+		}
+	}
+}
+
+void Rasteriser::RenderDemoCycle(const Bitmap& bitmap)
+{
 	//Draw specific model type dependant on the frame counter. Resets when last model has been drawn and rotated around a little
 
 	if (renderCount <= 360) 
@@ -177,13 +502,288 @@ void Rasteriser::Render(const Bitmap& bitmap)
 		translateValue = 0;
 		scaleValue = 0.0f;
 	}
-
 }
 
 void Rasteriser::Shutdown()
 {
 }
 
+const RenderSettings& Rasteriser::GetSettings() const
+{
+	return _settings;
+}
+
+void Rasteriser::SetSettings(const RenderSettings& settings)
+{
+	_settings = settings;
+}
+
+void Rasteriser::SetInstances(const std::vector<Matrix>& instances)
+{
+	_instances = instances;
+}
+
+unsigned int Rasteriser::GetOccludedInstanceCount() const
+{
+	return _occludedInstanceCount;
+}
+
+const Model& Rasteriser::GetModel() const
+{
+	return _model;
+}
+
+Profiler& Rasteriser::GetProfiler()
+{
+	return _profiler;
+}
+
+const TileBinner& Rasteriser::GetTileBinner() const
+{
+	return _tileBinner;
+}
+
+unsigned long long Rasteriser::GetFrameAllocationCount() const
+{
+	return _frameAllocationCount;
+}
+
+Matrix Rasteriser::CreateScreenMatrix() const
+{
+	//the viewport's last row only moves z into w after the divide, so it is made affine to keep w for the divide itself
+	Matrix screenMatrix = viewTransformationMatrix;
+	screenMatrix.SetM(3, 2, 0);
+	screenMatrix.SetM(3, 3, 1);
+
+	return screenMatrix;
+}
+
+PolygonClipper Rasteriser::CreateClipper()
+{
+	//the clipper starts from world space, as the model transformation has already been applied to the positions it reads
+	return PolygonClipper(perspectiveTransformationMatrix * _camera.CreateViewingMatrix(), CreateScreenMatrix(), _d * _settings.nearPlane);
+}
+
+RenderTarget Rasteriser::CreateRenderTarget(const Bitmap& bitmap)
+{
+	RenderTarget target = bitmap.GetRenderTarget();
+
+	if (_settings.depthMode == DepthMode::ZBuffer)
+	{
+		target.depth = _depthBuffer.data();
+	}
+
+	return target;
+}
+
+void Rasteriser::BeginTriangles(const RenderTarget& target)
+{
+	if (_threadPool.GetThreadCount() > 1)
+	{
+		_tileBinner.Begin(target, _settings.tileSize);
+	}
+}
+
+void Rasteriser::SubmitTriangle(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour, TriangleShading shading)
+{
+	//with a single thread there is nothing to gain from binning, so fill straight away
+	if (_threadPool.GetThreadCount() <= 1)
+	{
+		FillTriangle(target, currentPolygonVertices, currentColour, shading);
+		return;
+	}
+
+	_tileBinner.AddTriangle(currentPolygonVertices[0], currentPolygonVertices[1], currentPolygonVertices[2], currentColour, shading);
+}
+
+void Rasteriser::SubmitPolygon(const RenderTarget& target, Vertex* polygonVertices, int count, const COLORREF& currentColour, TriangleShading shading)
+{
+	//the clipped polygon is convex, so it is filled as a fan of triangles around its first vertex
+	for (int j = 1; j + 1 < count; j++)
+	{
+		Vertex currentPolygonVertices[3] = { polygonVertices[0], polygonVertices[j], polygonVertices[j + 1] };
+		SubmitTriangle(target, currentPolygonVertices, currentColour, shading);
+	}
+}
+
+void Rasteriser::FlushTriangles()
+{
+	if (_threadPool.GetThreadCount() <= 1)
+	{
+		return;
+	}
+
+	ProfileScope scope(_profiler, ProfileStage::TileFill);
+	_tileBinner.Rasterise(_threadPool, [this](const RenderTarget& tileTarget, const BinnedTriangle& triangle)
+	{
+		//the fill methods sort the vertices in place, so each tile works on its own copy
+		Vertex currentPolygonVertices[3] = { triangle.vertices[0], triangle.vertices[1], triangle.vertices[2] };
+		FillTriangle(tileTarget, currentPolygonVertices, triangle.colour, triangle.shading);
+	});
+}
+
+void Rasteriser::FillTriangle(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour, TriangleShading shading)
+{
+	switch (shading)
+	{
+	case TriangleShading::Flat:
+		FillPolygonFlat(target, currentPolygonVertices, currentColour);
+		break;
+	case TriangleShading::Gouraud:
+		FillPolygonGouraud(target, currentPolygonVertices);
+		break;
+	case TriangleShading::Textured:
+		FillSolidTextured(target, currentPolygonVertices);
+		break;
+	}
+}
+
+void Rasteriser::DrawLabel(const Bitmap& bitmap, const wchar_t* text)
+{
+	//labels describe the steps of the demo, and need GDI to draw the text
+#ifdef _WIN32
+	if (_settings.shadingMode != ShadingMode::DemoCycle)
+	{
+		return;
+	}
+
+	HDC hdc = bitmap.GetDC();
+	SetTextColor(hdc, RGB(255, 255, 255));
+	SetBkMode(hdc, TRANSPARENT);
+	TextOut(hdc, 0, 0, text, lstrlen(text));
+#else
+	(void)bitmap;
+	(void)text;
+#endif
+}
+
+static int ClampLineCoordinate(float value, int minimum, int maximum)
+{
+	int coordinate = (int)value;
+	return coordinate < minimum ? minimum : (coordinate > maximum ? maximum : coordinate);
+}
+
+void Rasteriser::DrawLine(const RenderTarget& target, float x1, float y1, float x2, float y2, const COLORREF& colour)
+{
+	//a vertex that could not be projected has no sensible line to draw
+	if (!std::isfinite(x1) || !std::isfinite(y1) || !std::isfinite(x2) || !std::isfinite(y2))
+	{
+		return;
+	}
+
+	//clips the line to the scissor rectangle first, so lines running far off screen cost nothing
+	float minX = (float)target.minX;
+	float minY = (float)target.minY;
+	float maxX = (float)target.maxX;
+	float maxY = (float)target.maxY;
+
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+	float dx = x2 - x1;
+	float dy = y2 - y1;
+	float p[4] = { -dx, dx, -dy, dy };
+	float q[4] = { x1 - minX, maxX - x1, y1 - minY, maxY - y1 };
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0.0f)
+		{
+			//parallel to this edge, so either wholly inside or wholly outside it
+			if (!(q[i] >= 0.0f))
+			{
+				return;
+			}
+			continue;
+		}
+
+		float t = q[i] / p[i];
+		if (p[i] < 0.0f)
+		{
+			t0 = t > t0 ? t : t0;
+		}
+		else
+		{
+			t1 = t < t1 ? t : t1;
+		}
+	}
+
+	if (t0 > t1)
+	{
+		return;
+	}
+
+	//walks the clipped line with Bresenham's algorithm, clamping away any rounding error from the clip
+	int currentX = ClampLineCoordinate(x1 + t0 * dx, target.minX, target.maxX);
+	int currentY = ClampLineCoordinate(y1 + t0 * dy, target.minY, target.maxY);
+	int endX = ClampLineCoordinate(x1 + t1 * dx, target.minX, target.maxX);
+	int endY = ClampLineCoordinate(y1 + t1 * dy, target.minY, target.maxY);
+
+	int stepX = currentX < endX ? 1 : -1;
+	int stepY = currentY < endY ? 1 : -1;
+	int distanceX = currentX < endX ? endX - currentX : currentX - endX;
+	int distanceY = currentY < endY ? currentY - endY : endY - currentY;
+	int error = distanceX + distanceY;
+
+	unsigned int pixel = Bitmap::ToPixel(colour);
+
+	while (true)
+	{
+		target.pixels[currentY * target.stride + currentX] = pixel;
+
+		if (currentX == endX && currentY == endY)
+		{
+			break;
+		}
+
+		int doubleError = 2 * error;
+		if (doubleError >= distanceY)
+		{
+			error += distanceY;
+			currentX += stepX;
+		}
+		if (doubleError <= distanceX)
+		{
+			error += distanceX;
+			currentY += stepY;
+		}
+	}
+}
+
+bool Rasteriser::FillPolygonGDI(const Bitmap& bitmap, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour)
+{
+#ifdef _WIN32
+	HDC hdc = bitmap.GetDC();
+
+	//creates 3 POINT objects for the polygon fill method
+	POINT points[3];
+	points[0] = { long(vertex1.GetX()) , long(vertex1.GetY()) };
+	points[1] = { long(vertex2.GetX()) , long(vertex2.GetY()) };
+	points[2] = { long(vertex3.GetX()) , long(vertex3.GetY()) };
+
+	//creates brush as a colour decided above
+	HBRUSH fillBrush = CreateSolidBrush(currentColour);
+	HPEN polygonPen = CreatePen(PS_SOLID, 2, currentColour);
+
+	SelectObject(hdc, polygonPen);
+	SelectObject(hdc, fillBrush);
+
+	//fills polygons with correct colour
+	Polygon(hdc, points, 3);
+
+	DeleteObject(polygonPen);
+	DeleteObject(fillBrush);
+
+	return true;
+#else
+	(void)bitmap;
+	(void)vertex1;
+	(void)vertex2;
+	(void)vertex3;
+	(void)currentColour;
+	return false;
+#endif
+}
+
 void Rasteriser::GeneratePerspectiveMatrix(float d, float aspectRatio)
 {
 	_aspectRatio = aspectRatio;
@@ -207,233 +807,201 @@ void Rasteriser::GenerateViewMatrix(float d, int width, int height)
 
 void Rasteriser::DrawWireFrame(const Bitmap& bitmap)
 {
-	//gets device context
-	HDC hdc = bitmap.GetDC();
+	ProfileScope scope(_profiler, ProfileStage::DrawWireFrame);
+
+	//gets the pixel memory to draw the lines into
+	RenderTarget target = bitmap.GetRenderTarget();
 
 	//draws specific label depending on which transformation is shown
 	if (renderCount <= 72)
 	{
-		const wchar_t* text = L"Wireframe with Culling and Depth Sorting, Shows Translation in all 3 Axis";
-		SetTextColor(hdc, RGB(255, 255, 255));
-		SetBkMode(hdc, TRANSPARENT);
-		TextOut(hdc, 0, 0, text, lstrlen(text));
+		DrawLabel(bitmap, L"Wireframe with Culling and Depth Sorting, Shows Translation in all 3 Axis");
 	}
 	else if (renderCount > 72 && renderCount <= 144)
 	{
-		const wchar_t* text = L"Wireframe with Culling and Depth Sorting, Shows Scaling in all 3 Axis";
-		SetTextColor(hdc, RGB(255, 255, 255));
-		SetBkMode(hdc, TRANSPARENT);
-		TextOut(hdc, 0, 0, text, lstrlen(text));
+		DrawLabel(bitmap, L"Wireframe with Culling and Depth Sorting, Shows Scaling in all 3 Axis");
 	}
 	else if (renderCount > 144 && renderCount <= 216)
 	{
-		const wchar_t* text = L"Wireframe with Culling and Depth Sorting, Shows X Rotation";
-		SetTextColor(hdc, RGB(255, 255, 255));
-		SetBkMode(hdc, TRANSPARENT);
-		TextOut(hdc, 0, 0, text, lstrlen(text));
+		DrawLabel(bitmap, L"Wireframe with Culling and Depth Sorting, Shows X Rotation");
 	}
 	else if (renderCount > 216 && renderCount <= 288)
 	{
-		const wchar_t* text = L"Wireframe with Culling and Depth Sorting, Shows Y Rotation";
-		SetTextColor(hdc, RGB(255, 255, 255));
-		SetBkMode(hdc, TRANSPARENT);
-		TextOut(hdc, 0, 0, text, lstrlen(text));
+		DrawLabel(bitmap, L"Wireframe with Culling and Depth Sorting, Shows Y Rotation");
 	}
 	else if (renderCount > 288 && renderCount <= 360)
 	{
-		const wchar_t* text = L"Wireframe with Culling and Depth Sorting, Shows Z Rotation";
-		SetTextColor(hdc, RGB(255, 255, 255));
-		SetBkMode(hdc, TRANSPARENT);
-		TextOut(hdc, 0, 0, text, lstrlen(text));
+		DrawLabel(bitmap, L"Wireframe with Culling and Depth Sorting, Shows Z Rotation");
 	}
 
-	//create vector list of polygons using GetPolygons method
-
-	std::vector<Polygon3D> localPolygonList = _model.GetPolygons();
+	//gets a reference to the polygon list, rather than copying it
 
-	//create vector list of vertices using GetVertices method
+	const std::vector<Polygon3D>& localPolygonList = _model.GetPolygons();
+	const std::vector<int>& drawOrder = _model.GetDrawOrder();
+	PolygonClipper clipper = CreateClipper();
 
-	std::vector<Vertex> localVerticesCollection = _model.GetTransVertices();
+	//loop through each polygon that survived culling, in the order they are drawn
 
-	//loop through each polygon in this collection
-
-	for (int i = 0; i < localPolygonList.size(); i++)
+	for (size_t n = 0; n < drawOrder.size(); n++)
 	{
-		if (localPolygonList[i].GetCullState() == false) {
-
-			//get the index of each vertex in the polygon list
-
-			int i0 = localPolygonList[i].GetIndex(0);
-			int i1 = localPolygonList[i].GetIndex(1);
-			int i2 = localPolygonList[i].GetIndex(2);
-
-			//save the vertices, referenced with the indices above, into unique variables.
-
-			Vertex vertex1 = localVerticesCollection[i0];
-			Vertex vertex2 = localVerticesCollection[i1];
-			Vertex vertex3 = localVerticesCollection[i2];
+		int i = drawOrder[n];
 
-			std::vector<Vertex> localPolygonVertexCollection;
+		//get the index of each vertex in the polygon list
 
-			localPolygonVertexCollection.push_back(vertex1);
-			localPolygonVertexCollection.push_back(vertex2);
-			localPolygonVertexCollection.push_back(vertex3);
+		int i0 = localPolygonList[i].GetIndex(0);
+		int i1 = localPolygonList[i].GetIndex(1);
+		int i2 = localPolygonList[i].GetIndex(2);
 
-			//draw the polygon
+		//save the vertices, referenced with the indices above, into unique variables.
 
+		Vertex vertex1 = _model.GetScreenVertex(i0);
+		Vertex vertex2 = _model.GetScreenVertex(i1);
+		Vertex vertex3 = _model.GetScreenVertex(i2);
 
-			SelectObject(hdc, GetStockObject(WHITE_PEN));
+		//clip the polygon, then draw its outline
 
-			for (int j = 0; j <= 2; j++)
-			{
-				if (j == 0)
-				{
-					MoveToEx(hdc, (int)localPolygonVertexCollection[j].GetX(), (int)localPolygonVertexCollection[j].GetY(), NULL);
-				}
-				else
-				{
-					LineTo(hdc, (int)localPolygonVertexCollection[j].GetX(), (int)localPolygonVertexCollection[j].GetY());
-				}
-			}
-			LineTo(hdc, (int)localPolygonVertexCollection[0].GetX(), (int)localPolygonVertexCollection[0].GetY());
-
-			DeleteObject(GetStockObject(WHITE_PEN));
+		Vertex polygonVertices[PolygonClipper::MaxVertices] = { vertex1, vertex2, vertex3 };
+		int indices[3] = { i0, i1, i2 };
+		int count = clipper.Clip(polygonVertices, indices, _model.GetWorldPositions());
 
+		for (int j = 0; j < count; j++)
+		{
+			const Vertex& from = polygonVertices[j];
+			const Vertex& to = polygonVertices[(j + 1) % count];
+			DrawLine(target, from.GetX(), from.GetY(), to.GetX(), to.GetY(), RGB(255, 255, 255));
 		}
 	}
 }
 
 void Rasteriser::DrawSolidFlat(const Bitmap& bitmap)
 {
+	ProfileScope scope(_profiler, ProfileStage::DrawSolidFlat);
+
 
 	//define current colour
 	COLORREF currentColour = (0, 0, 0);
 
+	//gets the pixel memory to fill into
+	RenderTarget target = CreateRenderTarget(bitmap);
+	BeginTriangles(target);
+
 	//gets polygons
-	std::vector<Polygon3D> localPolygonList = _model.GetPolygons();
+	const std::vector<Polygon3D>& localPolygonList = _model.GetPolygons();
+	const std::vector<int>& drawOrder = _model.GetDrawOrder();
+	PolygonClipper clipper = CreateClipper();
 
-	//loop though all polygons, draw if not culled
-	for (int i = 0; i < localPolygonList.size(); i++) 
+	//loop though the polygons that are not culled, in draw order
+	for (size_t n = 0; n < drawOrder.size(); n++)
 	{
-		if (localPolygonList[i].GetCullState() == false) 
-		{
+		int i = drawOrder[n];
 
-			//gets index of vertex
-			int i0 = localPolygonList[i].GetIndex(0);
-			int i1 = localPolygonList[i].GetIndex(1);
-			int i2 = localPolygonList[i].GetIndex(2);
+		//gets index of vertex
+		int i0 = localPolygonList[i].GetIndex(0);
+		int i1 = localPolygonList[i].GetIndex(1);
+		int i2 = localPolygonList[i].GetIndex(2);
 
-			//create vector list of vertices using GetVertices method
+		//save the vertices, referenced with the indices above, into unique variables.
 
-			std::vector<Vertex> localVerticesCollection = _model.GetTransVertices();
+		Vertex vertex1 = _model.GetScreenVertex(i0);
+		Vertex vertex2 = _model.GetScreenVertex(i1);
+		Vertex vertex3 = _model.GetScreenVertex(i2);
 
-			//save the vertices, referenced with the indices above, into unique variables.
-
-			Vertex vertex1 = localVerticesCollection[i0];
-			Vertex vertex2 = localVerticesCollection[i1];
-			Vertex vertex3 = localVerticesCollection[i2];
-
-			//creates 3 POINT objects for the polygon fill method
-			POINT points[3];
-			points[0] = { long(vertex1.GetX()) , long(vertex1.GetY()) };
-			points[1] = { long(vertex2.GetX()) , long(vertex2.GetY()) };
-			points[2] = { long(vertex3.GetX()) , long(vertex3.GetY()) };
-
-			//gets DC
-			HDC hdc = bitmap.GetDC();
-
-			//changes the label/colour depending on the currently shown model type
-			if (renderCount <= 480) {
-
-				const wchar_t* text = L"Flat Shading with Constant Colour";
-				SetTextColor(hdc, RGB(255, 255, 255));
-				SetBkMode(hdc, TRANSPARENT);
-				TextOut(hdc, 0, 0, text, lstrlen(text));
+		//changes the colour depending on the currently shown model type
+		if (renderCount <= 480) {
+			currentColour = RGB(0, 255, 255);
+		}
+		else {
+			currentColour = localPolygonList[i].GetRGBValue();
+		}
 
-				currentColour = RGB(0, 255, 255);
-			}
-			else {
-				const wchar_t* text = L"Flat Shading with Ambient, Directional and Point Lighting Accounted For";
-				SetTextColor(hdc, RGB(255, 255, 255));
-				SetBkMode(hdc, TRANSPARENT);
-				TextOut(hdc, 0, 0, text, lstrlen(text));
+		Vertex polygonVertices[PolygonClipper::MaxVertices] = { vertex1, vertex2, vertex3 };
+		int indices[3] = { i0, i1, i2 };
+		int count = clipper.Clip(polygonVertices, indices, _model.GetWorldPositions());
 
-				currentColour = localPolygonList[i].GetRGBValue();
+		//GDI cannot depth test, so when the depth buffer is in use (or there is no window) the polygon is filled with my own method
+		if (_settings.depthMode == DepthMode::PaintersSort && count >= 3 && FillPolygonGDI(bitmap, polygonVertices[0], polygonVertices[1], polygonVertices[2], currentColour))
+		{
+			for (int j = 2; j + 1 < count; j++)
+			{
+				FillPolygonGDI(bitmap, polygonVertices[0], polygonVertices[j], polygonVertices[j + 1], currentColour);
 			}
+			continue;
+		}
 
-			//creates brush as a colour decided above
-			HBRUSH fillBrush = CreateSolidBrush(currentColour);
-			HPEN polygonPen = CreatePen(PS_SOLID, 2, currentColour);
-
-			SelectObject(hdc, polygonPen);
-			SelectObject(hdc, fillBrush);
-
-			//fills polygons with correct colour
-			Polygon(hdc, points, 3);
+		SubmitPolygon(target, polygonVertices, count, currentColour, TriangleShading::Flat);
+	}
 
-			DeleteObject(polygonPen);
-			DeleteObject(fillBrush);
+	//fills any triangles that were binned for the worker threads
+	FlushTriangles();
 
-		}
+	//changes the label depending on the currently shown model type
+	if (renderCount <= 480) {
+		DrawLabel(bitmap, L"Flat Shading with Constant Colour");
+	}
+	else {
+		DrawLabel(bitmap, L"Flat Shading with Ambient, Directional and Point Lighting Accounted For");
 	}
 
 }
 
 void Rasteriser::MyDrawSolidFlat(const Bitmap& bitmap)
-{
-	//gets polygons
-	std::vector<Polygon3D> localPolygonList = _model.GetPolygons();
-
-	//loops through polygons, draws if culling is false
-	for (int i = 0; i < localPolygonList.size(); i++)
-	{
-		if (localPolygonList[i].GetCullState() == false)
-		{
+{
+	ProfileScope scope(_profiler, ProfileStage::DrawFlat);
 
-			int i0 = localPolygonList[i].GetIndex(0);
-			int i1 = localPolygonList[i].GetIndex(1);
-			int i2 = localPolygonList[i].GetIndex(2);
+	//gets the pixel memory to fill into
+	RenderTarget target = CreateRenderTarget(bitmap);
+	BeginTriangles(target);
 
-			//create vector list of vertices using GetVertices method
+	//gets polygons
+	const std::vector<Polygon3D>& localPolygonList = _model.GetPolygons();
+	const std::vector<int>& drawOrder = _model.GetDrawOrder();
+	PolygonClipper clipper = CreateClipper();
 
-			std::vector<Vertex> localVerticesCollection = _model.GetTransVertices();
+	//loops through the polygons that are not culled, in draw order
+	for (size_t n = 0; n < drawOrder.size(); n++)
+	{
+		int i = drawOrder[n];
 
-			//save the vertices, referenced with the indices above, into unique variables.
+		int i0 = localPolygonList[i].GetIndex(0);
+		int i1 = localPolygonList[i].GetIndex(1);
+		int i2 = localPolygonList[i].GetIndex(2);
 
-			Vertex vertex1 = localVerticesCollection[i0];
-			Vertex vertex2 = localVerticesCollection[i1];
-			Vertex vertex3 = localVerticesCollection[i2];
+		//save the vertices, referenced with the indices above, into unique variables.
 
-			std::vector<Vertex> currentPolygonVertices;
+		Vertex vertex1 = _model.GetScreenVertex(i0);
+		Vertex vertex2 = _model.GetScreenVertex(i1);
+		Vertex vertex3 = _model.GetScreenVertex(i2);
 
-			currentPolygonVertices.push_back(vertex1);
-			currentPolygonVertices.push_back(vertex2);
-			currentPolygonVertices.push_back(vertex3);
+		Vertex polygonVertices[PolygonClipper::MaxVertices] = { vertex1, vertex2, vertex3 };
+		int indices[3] = { i0, i1, i2 };
+		int count = clipper.Clip(polygonVertices, indices, _model.GetWorldPositions());
 
-			//gets DC
-			HDC hdc = bitmap.GetDC();
+		//decides current colour
+		COLORREF currentColour = localPolygonList[i].GetRGBValue();
 
-			//sets label to show what is happening
-			const wchar_t* text = L"Flat Shading / Lighting with My Own Polygon Fill Method";
-			SetTextColor(hdc, RGB(255, 255, 255));
-			SetBkMode(hdc, TRANSPARENT);
-			TextOut(hdc, 0, 0, text, lstrlen(text));
+		//uses my method to fill a polygon (flat shaded)
+		SubmitPolygon(target, polygonVertices, count, currentColour, TriangleShading::Flat);
+	}
 
-			//decides current colour
-			COLORREF currentColour = localPolygonList[i].GetRGBValue();
+	//fills any triangles that were binned for the worker threads
+	FlushTriangles();
 
-			//uses my method to fill a polygon (flat shaded)
-			FillPolygonFlat(hdc, currentPolygonVertices, currentColour);
-		}
-	}
+	//sets label to show what is happening, drawn last so that it sits on top of the model
+	DrawLabel(bitmap, L"Flat Shading / Lighting with My Own Polygon Fill Method");
 
 }
 
-void Rasteriser::FillPolygonFlat(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices, const COLORREF& currentColour)
+void Rasteriser::FillPolygonFlat(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour)
 {
+	//the half-space fill handles the whole triangle at once, so needs no sorting or splitting
+	if (_settings.triangleFill == TriangleFill::HalfSpace)
+	{
+		HalfSpaceRasteriser::FillFlat(target, currentPolygonVertices[0], currentPolygonVertices[1], currentPolygonVertices[2], currentColour);
+		return;
+	}
 
 	//sorts vertices by Y
-	sort(currentPolygonVertices.begin(), currentPolygonVertices.end(), SortByAscY);
+	sort(currentPolygonVertices, currentPolygonVertices + 3, SortByAscY);
 
 	//gets the 3 vertices
 	Vertex vertex1 = currentPolygonVertices[0];
@@ -443,11 +1011,11 @@ void Rasteriser::FillPolygonFlat(const HDC& hdc, std::vector<Vertex>& currentPol
 	//decides whether a polygon needs to be split
 	if (vertex2.GetY() == vertex3.GetY())
 	{
-		FillBottomFlatTriangle(hdc, vertex1, vertex2, vertex3, currentColour);
+		FillBottomFlatTriangle(target, vertex1, vertex2, vertex3, currentColour);
 	}
 	else if (vertex1.GetY() == vertex2.GetY())
 	{
-		FillTopFlatTriangle(hdc, vertex1, vertex2, vertex3, currentColour);
+		FillTopFlatTriangle(target, vertex1, vertex2, vertex3, currentColour);
 	}
 	else
 	{
@@ -458,9 +1026,12 @@ void Rasteriser::FillPolygonFlat(const HDC& hdc, std::vector<Vertex>& currentPol
 								(vertex3.GetIntX() - vertex1.GetIntX())), 
 								(float)vertex2.GetIntY(), 1, 1);
 
+		//interpolates 1/w at the 4th vertex for depth testing
+		vertex4.SetZR(vertex1.GetZR() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetZR() - vertex1.GetZR()));
+
 		//calls both methods
-		FillBottomFlatTriangle(hdc, vertex1, vertex2, vertex4, currentColour);
-		FillTopFlatTriangle(hdc, vertex2, vertex4, vertex3, currentColour);
+		FillBottomFlatTriangle(target, vertex1, vertex2, vertex4, currentColour);
+		FillTopFlatTriangle(target, vertex2, vertex4, vertex3, currentColour);
 
 	}
 
@@ -474,15 +1045,21 @@ bool Rasteriser::SortByAscY(const Vertex& lhs, const Vertex& rhs)
 
 }
 
-void Rasteriser::FillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour)
+void Rasteriser::FillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour)
 {
 	//gets gradient of change for triangel slopes
 	float invSlope1 = (float)(vertex2.GetIntX() - vertex1.GetIntX()) / (float)(vertex2.GetIntY() - vertex1.GetIntY());
 	float invSlope2 = (float)(vertex3.GetIntX() - vertex1.GetIntX()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
 
-	//gets starting X values
+	//gets gradient of change in 1/w down each slope for depth testing
+	float zrSlope1 = (vertex2.GetZR() - vertex1.GetZR()) / (float)(vertex2.GetIntY() - vertex1.GetIntY());
+	float zrSlope2 = (vertex3.GetZR() - vertex1.GetZR()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
+
+	//gets starting X and 1/w values
 	float currentX1 = (float)vertex1.GetIntX();
 	float currentX2 = (float)vertex1.GetIntX() + 0.5f;
+	float cZ1 = vertex1.GetZR();
+	float cZ2 = vertex1.GetZR();
 
 	//switches slope if they are backwards
 	if (invSlope2 < invSlope1)
@@ -490,34 +1067,83 @@ void Rasteriser::FillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, c
 		float slopeTemp = invSlope1;
 		invSlope1 = invSlope2;
 		invSlope2 = slopeTemp;
+
+		slopeTemp = zrSlope1;
+		zrSlope1 = zrSlope2;
+		zrSlope2 = slopeTemp;
+	}
+
+	//converts the colour once into the layout used by the pixel memory
+	unsigned int pixel = Bitmap::ToPixel(currentColour);
+
+	//rows above the target are stepped over in one go and the loop stops at its bottom, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex1.GetIntY();
+	int lastY = vertex2.GetIntY() < target.maxY ? vertex2.GetIntY() : target.maxY;
+	if (firstY < target.minY)
+	{
+		float skipped = (float)(target.minY - firstY);
+		currentX1 += invSlope1 * skipped;
+		currentX2 += invSlope2 * skipped;
+		cZ1 += zrSlope1 * skipped;
+		cZ2 += zrSlope2 * skipped;
+		firstY = target.minY;
 	}
 
 	//loops through all rows to set each pixel to the relevant colour
-	for (int scanlineY = int(vertex1.GetIntY()); scanlineY <= vertex2.GetIntY(); scanlineY++)
+	for (int scanlineY = firstY; scanlineY <= lastY; scanlineY++)
 	{
 
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
+
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
 		{
-			SetPixel(hdc, xPos, scanlineY, currentColour);
+			startX = target.minX;
+		}
+
+		for (int xPos = startX; xPos < currentX2 && xPos <= target.maxX; xPos++)
+		{
+			//skips the pixel if something nearer has already been drawn there
+			if (depthRow != nullptr)
+			{
+				float t = (xPos - currentX1) / (currentX2 - currentX1);
+				float zr = (1 - t) * cZ1 + t * cZ2;
+				if (zr <= depthRow[xPos])
+				{
+					continue;
+				}
+				depthRow[xPos] = zr;
+			}
+			row[xPos] = pixel;
 		}
 
 		//increments x value to go to next one
 		currentX1 += invSlope1;
 		currentX2 += invSlope2;
+		cZ1 += zrSlope1;
+		cZ2 += zrSlope2;
 
 	}
 
 }
 
-void Rasteriser::FillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour)
+void Rasteriser::FillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour)
 {
 	//gets gradient of change for triangel slopes
 	float invSlope1 = (float)(vertex3.GetIntX() - vertex1.GetIntX()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
 	float invSlope2 = (float)(vertex3.GetIntX() - vertex2.GetIntX()) / (float)(vertex3.GetIntY() - vertex2.GetIntY());
 
-	//gets starting X values
+	//gets gradient of change in 1/w up each slope for depth testing
+	float zrSlope1 = (vertex3.GetZR() - vertex1.GetZR()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
+	float zrSlope2 = (vertex3.GetZR() - vertex2.GetZR()) / (float)(vertex3.GetIntY() - vertex2.GetIntY());
+
+	//gets starting X and 1/w values
 	float currentX1 = (float)vertex3.GetIntX();
 	float currentX2 = (float)vertex3.GetIntX() + 0.5f;
+	float cZ1 = vertex3.GetZR();
+	float cZ2 = vertex3.GetZR();
 
 	//flips grandients if backwards
 	if (invSlope1 < invSlope2)
@@ -525,20 +1151,63 @@ void Rasteriser::FillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, cons
 		float slopeTemp = invSlope1;
 		invSlope1 = invSlope2;
 		invSlope2 = slopeTemp;
+
+		slopeTemp = zrSlope1;
+		zrSlope1 = zrSlope2;
+		zrSlope2 = slopeTemp;
+	}
+
+	//converts the colour once into the layout used by the pixel memory
+	unsigned int pixel = Bitmap::ToPixel(currentColour);
+
+	//rows below the target are stepped over in one go and the loop stops at its top, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex3.GetIntY();
+	int lastY = vertex1.GetIntY() > target.minY - 1 ? vertex1.GetIntY() : target.minY - 1;
+	if (firstY > target.maxY)
+	{
+		float skipped = (float)(firstY - target.maxY);
+		currentX1 -= invSlope1 * skipped;
+		currentX2 -= invSlope2 * skipped;
+		cZ1 -= zrSlope1 * skipped;
+		cZ2 -= zrSlope2 * skipped;
+		firstY = target.maxY;
 	}
 
 	//loops though each row and pixel to set colour
-	for (int scanlineY = int(vertex3.GetIntY()); scanlineY > vertex1.GetIntY(); scanlineY--)
+	for (int scanlineY = firstY; scanlineY > lastY; scanlineY--)
 	{
 
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
+
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
 		{
-			SetPixel(hdc, xPos, scanlineY, currentColour);
+			startX = target.minX;
+		}
+
+		for (int xPos = startX; xPos < currentX2 && xPos <= target.maxX; xPos++)
+		{
+			//skips the pixel if something nearer has already been drawn there
+			if (depthRow != nullptr)
+			{
+				float t = (xPos - currentX1) / (currentX2 - currentX1);
+				float zr = (1 - t) * cZ1 + t * cZ2;
+				if (zr <= depthRow[xPos])
+				{
+					continue;
+				}
+				depthRow[xPos] = zr;
+			}
+			row[xPos] = pixel;
 		}
 
 		//decrements X value for next value
 		currentX1 -= invSlope1;
 		currentX2 -= invSlope2;
+		cZ1 -= zrSlope1;
+		cZ2 -= zrSlope2;
 
 	}
 
@@ -546,54 +1215,58 @@ void Rasteriser::FillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, cons
 
 void Rasteriser::GouraudShading(const Bitmap& bitmap)
 {
-	//gets polygons
-	std::vector<Polygon3D> localPolygonList = _model.GetPolygons();
-
-	//for each polygon, if not culled
-	for (int i = 0; i < localPolygonList.size(); i++)
-	{
-		if (localPolygonList[i].GetCullState() == false)
-		{
+	ProfileScope scope(_profiler, ProfileStage::DrawGouraud);
 
-			int i0 = localPolygonList[i].GetIndex(0);
-			int i1 = localPolygonList[i].GetIndex(1);
-			int i2 = localPolygonList[i].GetIndex(2);
+	//gets the pixel memory to fill into
+	RenderTarget target = CreateRenderTarget(bitmap);
+	BeginTriangles(target);
 
-			//create vector list of vertices using GetVertices method
+	//gets polygons
+	const std::vector<Polygon3D>& localPolygonList = _model.GetPolygons();
+	const std::vector<int>& drawOrder = _model.GetDrawOrder();
+	PolygonClipper clipper = CreateClipper();
 
-			std::vector<Vertex> localVerticesCollection = _model.GetTransVertices();
+	//for each polygon that is not culled, in draw order
+	for (size_t n = 0; n < drawOrder.size(); n++)
+	{
+		int i = drawOrder[n];
 
-			//save the vertices, referenced with the indices above, into unique variables.
+		int i0 = localPolygonList[i].GetIndex(0);
+		int i1 = localPolygonList[i].GetIndex(1);
+		int i2 = localPolygonList[i].GetIndex(2);
 
-			Vertex vertex1 = localVerticesCollection[i0];
-			Vertex vertex2 = localVerticesCollection[i1];
-			Vertex vertex3 = localVerticesCollection[i2];
+		//save the vertices, referenced with the indices above, into unique variables.
 
-			std::vector<Vertex> currentPolygonVertices;
+		Vertex vertex1 = _model.GetScreenVertex(i0);
+		Vertex vertex2 = _model.GetScreenVertex(i1);
+		Vertex vertex3 = _model.GetScreenVertex(i2);
 
-			currentPolygonVertices.push_back(vertex1);
-			currentPolygonVertices.push_back(vertex2);
-			currentPolygonVertices.push_back(vertex3);
+		Vertex polygonVertices[PolygonClipper::MaxVertices] = { vertex1, vertex2, vertex3 };
+		int indices[3] = { i0, i1, i2 };
+		int count = clipper.Clip(polygonVertices, indices, _model.GetWorldPositions());
 
-			//gets DC
-			HDC hdc = bitmap.GetDC();
+		//calls my method to fill a polygon with smooth shaded colours
+		SubmitPolygon(target, polygonVertices, count, 0, TriangleShading::Gouraud);
+	}
 
-			//draws a label to show what is drawn
-			const wchar_t* text = L"Gouraud Smooth Shading with Lighting Accounted For";
-			SetTextColor(hdc, RGB(255, 255, 255));
-			SetBkMode(hdc, TRANSPARENT);
-			TextOut(hdc, 0, 0, text, lstrlen(text));
+	//fills any triangles that were binned for the worker threads
+	FlushTriangles();
 
-			//calls my method to fill a polygon with smooth shaded colours
-			FillPolygonGouraud(hdc, currentPolygonVertices);
-		}
-	}
+	//draws a label to show what is drawn
+	DrawLabel(bitmap, L"Gouraud Smooth Shading with Lighting Accounted For");
 }
 
-void Rasteriser::FillPolygonGouraud(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices)
+void Rasteriser::FillPolygonGouraud(const RenderTarget& target, Vertex* currentPolygonVertices)
 {
+	//the half-space fill handles the whole triangle at once, so needs no sorting or splitting
+	if (_settings.triangleFill == TriangleFill::HalfSpace)
+	{
+		HalfSpaceRasteriser::FillGouraud(target, currentPolygonVertices[0], currentPolygonVertices[1], currentPolygonVertices[2]);
+		return;
+	}
+
 	//sorts vertices by asc Y
-	sort(currentPolygonVertices.begin(), currentPolygonVertices.end(), SortByAscY);
+	sort(currentPolygonVertices, currentPolygonVertices + 3, SortByAscY);
 
 	//gets vertices
 	Vertex vertex1 = currentPolygonVertices[0];
@@ -608,11 +1281,11 @@ void Rasteriser::FillPolygonGouraud(const HDC& hdc, std::vector<Vertex>& current
 	//decided what type of triangle we are dealing with
 	if (vertex2.GetIntY() == vertex3.GetIntY())
 	{
-		GouraudFillBottomFlatTriangle(hdc, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
+		GouraudFillBottomFlatTriangle(target, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
 	}
 	else if (vertex1.GetIntY() == vertex2.GetIntY())
 	{
-		GouraudFillTopFlatTriangle(hdc, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
+		GouraudFillTopFlatTriangle(target, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
 	}
 	else
 	{
@@ -625,14 +1298,17 @@ void Rasteriser::FillPolygonGouraud(const HDC& hdc, std::vector<Vertex>& current
 		float cGreen = GetGValue(vertColour1) + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (GetGValue(vertColour3) - GetGValue(vertColour1));
 		COLORREF cTmp = RGB(cRed, cGreen, cBlue);
 
+		//interpolates 1/w at the 4th vertex for depth testing
+		vTmp.SetZR(vertex1.GetZR() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetZR() - vertex1.GetZR()));
+
 		//calls methods to fill
-		GouraudFillBottomFlatTriangle(hdc, vertex1, vertex2, vTmp, vertColour1, vertColour2, cTmp);
-		GouraudFillTopFlatTriangle(hdc, vertex2, vTmp, vertex3, vertColour2, cTmp, vertColour3);
+		GouraudFillBottomFlatTriangle(target, vertex1, vertex2, vTmp, vertColour1, vertColour2, cTmp);
+		GouraudFillTopFlatTriangle(target, vertex2, vTmp, vertex3, vertColour2, cTmp, vertColour3);
 
 	}
 }
 
-void Rasteriser::GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
+void Rasteriser::GouraudFillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
 {
 	//gets slope of change in x
 	float invSlope1 = (float)(vertex2.GetIntX() - vertex1.GetIntX()) / (float)(vertex2.GetIntY() - vertex1.GetIntY());
@@ -647,11 +1323,13 @@ void Rasteriser::GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& ver
 	float colorSlopeBlue1 = (float)(GetBValue(vertColour2) - GetBValue(vertColour1)) / v2v1Diff;
 	float colorSlopeRed1 = (float)(GetRValue(vertColour2) - GetRValue(vertColour1)) / v2v1Diff;
 	float colorSlopeGreen1 = (float)(GetGValue(vertColour2) - GetGValue(vertColour1)) / v2v1Diff;
+	float zrSlope1 = (vertex2.GetZR() - vertex1.GetZR()) / v2v1Diff;
 
 	float v3v1Diff = (float)(vertex3.GetIntY() - vertex1.GetIntY());
 	float colorSlopeBlue2 = (float)(GetBValue(vertColour3) - GetBValue(vertColour1)) / v3v1Diff;
 	float colorSlopeRed2 = (float)(GetRValue(vertColour3) - GetRValue(vertColour1)) / v3v1Diff;
 	float colorSlopeGreen2 = (float)(GetGValue(vertColour3) - GetGValue(vertColour1)) / v3v1Diff;
+	float zrSlope2 = (vertex3.GetZR() - vertex1.GetZR()) / v3v1Diff;
 
 	//sets colours to start with
 	float cBlue1 = GetBValue(vertColour1);
@@ -660,6 +1338,8 @@ void Rasteriser::GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& ver
 	float cBlue2 = GetBValue(vertColour1);
 	float cRed2 = GetRValue(vertColour1);
 	float cGreen2 = GetGValue(vertColour1);
+	float cZ1 = vertex1.GetZR();
+	float cZ2 = vertex1.GetZR();
 
 	//switches slopes if wrong way round
 	if (invSlope2 < invSlope1)
@@ -679,24 +1359,66 @@ void Rasteriser::GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& ver
 		slopeTemp = colorSlopeBlue1;
 		colorSlopeBlue1 = colorSlopeBlue2;
 		colorSlopeBlue2 = slopeTemp;
+
+		slopeTemp = zrSlope1;
+		zrSlope1 = zrSlope2;
+		zrSlope2 = slopeTemp;
+	}
+
+	//rows above the target are stepped over in one go and the loop stops at its bottom, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex1.GetIntY();
+	int lastY = vertex2.GetIntY() < target.maxY ? vertex2.GetIntY() : target.maxY;
+	if (firstY < target.minY)
+	{
+		float skipped = (float)(target.minY - firstY);
+		currentX1 += invSlope1 * skipped;
+		currentX2 += invSlope2 * skipped;
+		cRed1 += colorSlopeRed1 * skipped;
+		cGreen1 += colorSlopeGreen1 * skipped;
+		cBlue1 += colorSlopeBlue1 * skipped;
+		cRed2 += colorSlopeRed2 * skipped;
+		cGreen2 += colorSlopeGreen2 * skipped;
+		cBlue2 += colorSlopeBlue2 * skipped;
+		cZ1 += zrSlope1 * skipped;
+		cZ2 += zrSlope2 * skipped;
+		firstY = target.minY;
 	}
 
 	//loops though every lines, every pixel on that line
-	for (int scanlineY = vertex1.GetIntY(); scanlineY <= vertex2.GetIntY(); scanlineY++)
+	for (int scanlineY = firstY; scanlineY <= lastY; scanlineY++)
 	{
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
+
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
+		{
+			startX = target.minX;
+		}
+
+		for (int xPos = startX; xPos < currentX2 && xPos <= target.maxX; xPos++)
 		{
 			float t = (xPos - currentX1) / (currentX2 - currentX1);
 
+			//skips the pixel if something nearer has already been drawn there
+			if (depthRow != nullptr)
+			{
+				float zr = (1 - t) * cZ1 + t * cZ2;
+				if (zr <= depthRow[xPos])
+				{
+					continue;
+				}
+				depthRow[xPos] = zr;
+			}
+
 			//interpolates colour
 			int red = (int)((1 - t) * cRed1 + t * cRed2);
 			int green = (int)((1 - t) * cGreen1 + t * cGreen2);
 			int blue = (int)((1 - t) * cBlue1 + t * cBlue2);
 
 			//sets pixel to colour
-			COLORREF currentPixelColour = RGB(red, green, blue);
-
-			SetPixel(hdc, xPos, scanlineY, currentPixelColour);
+			row[xPos] = Bitmap::ToPixel(red, green, blue);
 		}
 
 		//increments slopes for next pass
@@ -710,11 +1432,14 @@ void Rasteriser::GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& ver
 		cRed2 += colorSlopeRed2;
 		cGreen2 += colorSlopeGreen2;
 		cBlue2 += colorSlopeBlue2;
+
+		cZ1 += zrSlope1;
+		cZ2 += zrSlope2;
 	}
 
 }
 
-void Rasteriser::GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
+void Rasteriser::GouraudFillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
 {
 	//gets slopes for change in X
 	float invSlope1 = (float)(vertex3.GetIntX() - vertex1.GetIntX()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
@@ -729,11 +1454,13 @@ void Rasteriser::GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex
 	float colorSlopeBlue2 = (float)(GetBValue(vertColour3) - GetBValue(vertColour1)) / v3v1Diff;
 	float colorSlopeRed2 = (float)(GetRValue(vertColour3) - GetRValue(vertColour1)) / v3v1Diff;
 	float colorSlopeGreen2 = (float)(GetGValue(vertColour3) - GetGValue(vertColour1)) / v3v1Diff;
+	float zrSlope2 = (vertex3.GetZR() - vertex1.GetZR()) / v3v1Diff;
 
 	float v3v2Diff = (float)(vertex3.GetIntY() - vertex2.GetIntY());
 	float colorSlopeBlue1 = (float)(GetBValue(vertColour3) - GetBValue(vertColour2)) / v3v2Diff;
 	float colorSlopeRed1 = (float)(GetRValue(vertColour3) - GetRValue(vertColour2)) / v3v2Diff;
 	float colorSlopeGreen1 = (float)(GetGValue(vertColour3) - GetGValue(vertColour2)) / v3v2Diff;
+	float zrSlope1 = (vertex3.GetZR() - vertex2.GetZR()) / v3v2Diff;
 
 	//gets colours to start with
 	float cBlue1 = GetBValue(vertColour3);
@@ -742,6 +1469,8 @@ void Rasteriser::GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex
 	float cBlue2 = GetBValue(vertColour3);
 	float cRed2 = GetRValue(vertColour3);
 	float cGreen2 = GetGValue(vertColour3);
+	float cZ1 = vertex3.GetZR();
+	float cZ2 = vertex3.GetZR();
 
 	//if slopes are backwards, swap them
 	if (invSlope2 < invSlope1)
@@ -761,24 +1490,67 @@ void Rasteriser::GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex
 		slopeTemp = colorSlopeBlue1;
 		colorSlopeBlue1 = colorSlopeBlue2;
 		colorSlopeBlue2 = slopeTemp;
+
+		slopeTemp = zrSlope1;
+		zrSlope1 = zrSlope2;
+		zrSlope2 = slopeTemp;
+	}
+
+	//rows below the target are stepped over in one go and the loop stops at its top, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex3.GetIntY();
+	int lastY = vertex1.GetIntY() > target.minY - 1 ? vertex1.GetIntY() : target.minY - 1;
+	if (firstY > target.maxY)
+	{
+		float skipped = (float)(firstY - target.maxY);
+		currentX1 -= invSlope2 * skipped;
+		currentX2 -= invSlope1 * skipped;
+		cRed1 -= colorSlopeRed1 * skipped;
+		cGreen1 -= colorSlopeGreen1 * skipped;
+		cBlue1 -= colorSlopeBlue1 * skipped;
+		cRed2 -= colorSlopeRed2 * skipped;
+		cGreen2 -= colorSlopeGreen2 * skipped;
+		cBlue2 -= colorSlopeBlue2 * skipped;
+		cZ1 -= zrSlope1 * skipped;
+		cZ2 -= zrSlope2 * skipped;
+		firstY = target.maxY;
 	}
 
 	//for each pixel on each line
-	for (int scanlineY = vertex3.GetIntY(); scanlineY > vertex1.GetIntY(); scanlineY--)
+	for (int scanlineY = firstY; scanlineY > lastY; scanlineY--)
 	{
 
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
+
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
+		{
+			startX = target.minX;
+		}
+
+		for (int xPos = startX; xPos < currentX2 && xPos <= target.maxX; xPos++)
 		{
 			float t = (xPos - currentX1) / (currentX2 - currentX1);
 
+			//skips the pixel if something nearer has already been drawn there
+			if (depthRow != nullptr)
+			{
+				float zr = (1 - t) * cZ1 + t * cZ2;
+				if (zr <= depthRow[xPos])
+				{
+					continue;
+				}
+				depthRow[xPos] = zr;
+			}
+
 			//interpolate colour
 			int red = (int)((1 - t) * cRed1 + t * cRed2);
 			int green = (int)((1 - t) * cGreen1 + t * cGreen2);
 			int blue = (int)((1 - t) * cBlue1 + t * cBlue2);
 
 			//set pixel to colour
-			COLORREF currentPixelColour = RGB(red, green, blue);
-			SetPixel(hdc, xPos, scanlineY, currentPixelColour);
+			row[xPos] = Bitmap::ToPixel(red, green, blue);
 		}
 
 		//decrement slopes for next pass
@@ -792,134 +1564,134 @@ void Rasteriser::GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex
 		cRed2 -= colorSlopeRed2;
 		cGreen2 -= colorSlopeGreen2;
 		cBlue2 -= colorSlopeBlue2;
+
+		cZ1 -= zrSlope1;
+		cZ2 -= zrSlope2;
 	}
 
 }
 
 void Rasteriser::DrawSolidTextured(const Bitmap& bitmap)
 {
-	//gets polygons and UV coords
-	std::vector<Polygon3D> localPolygonList = _model.GetPolygons();
-	std::vector<UVCoord> localUVCoordList = _model.GetUVCoords();
+	ProfileScope scope(_profiler, ProfileStage::DrawTextured);
 
-	for (int i = 0; i < localPolygonList.size(); i++)
+	//a model loaded without its texture has no UV coords to map, so it is smooth shaded instead
+	if (_model.GetUVCoords().empty())
 	{
-		if (localPolygonList[i].GetCullState() == false)
-		{
-
-			int i0 = localPolygonList[i].GetIndex(0);
-			int i1 = localPolygonList[i].GetIndex(1);
-			int i2 = localPolygonList[i].GetIndex(2);
-
-			//create vector list of vertices using GetVertices method
+		GouraudShading(bitmap);
+		return;
+	}
 
-			std::vector<Vertex> localVerticesCollection = _model.GetTransVertices();
+	//gets the pixel memory to fill into
+	RenderTarget target = CreateRenderTarget(bitmap);
+	BeginTriangles(target);
 
-			//save the vertices, referenced with the indices above, into unique variables.
+	//gets polygons and UV coords
+	const std::vector<Polygon3D>& localPolygonList = _model.GetPolygons();
+	const std::vector<int>& drawOrder = _model.GetDrawOrder();
+	const std::vector<UVCoord>& localUVCoordList = _model.GetUVCoords();
+	PolygonClipper clipper = CreateClipper();
 
-			Vertex vertex1 = localVerticesCollection[i0];
-			Vertex vertex2 = localVerticesCollection[i1];
-			Vertex vertex3 = localVerticesCollection[i2];
+	//for each polygon that is not culled, in draw order
+	for (size_t n = 0; n < drawOrder.size(); n++)
+	{
+		int i = drawOrder[n];
 
-			//sets vertex UV coord temporarily
-			vertex1.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(0)]);
-			vertex2.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(1)]);
-			vertex3.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(2)]);
+		int i0 = localPolygonList[i].GetIndex(0);
+		int i1 = localPolygonList[i].GetIndex(1);
+		int i2 = localPolygonList[i].GetIndex(2);
 
-			std::vector<Vertex> currentPolygonVertices;
+		//save the vertices, referenced with the indices above, into unique variables.
 
-			currentPolygonVertices.push_back(vertex1);
-			currentPolygonVertices.push_back(vertex2);
-			currentPolygonVertices.push_back(vertex3);
+		Vertex vertex1 = _model.GetScreenVertex(i0);
+		Vertex vertex2 = _model.GetScreenVertex(i1);
+		Vertex vertex3 = _model.GetScreenVertex(i2);
 
-			//calculates interpolation values to be used per vertex
-			float uOverZ = currentPolygonVertices[0].GetUVCoord().GetIntU() / currentPolygonVertices[0].GetPreTranZ();
-			float vOverZ = currentPolygonVertices[0].GetUVCoord().GetIntV() / currentPolygonVertices[0].GetPreTranZ();
-			float zRecip = 1 / currentPolygonVertices[0].GetPreTranZ();
+		//sets vertex UV coord temporarily
+		vertex1.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(0)]);
+		vertex2.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(1)]);
+		vertex3.SetUVCoord(localUVCoordList[localPolygonList[i].GetUVIndex(2)]);
 
-			//sets these values
-			currentPolygonVertices[0].SetUOZ(uOverZ);
-			currentPolygonVertices[0].SetVOZ(vOverZ);
-			currentPolygonVertices[0].SetZR(zRecip);
+		//clips the polygon first, so that u and v are interpolated along any clipped edge before being divided
+		Vertex polygonVertices[PolygonClipper::MaxVertices] = { vertex1, vertex2, vertex3 };
+		int indices[3] = { i0, i1, i2 };
+		int count = clipper.Clip(polygonVertices, indices, _model.GetWorldPositions());
 
-			uOverZ = currentPolygonVertices[1].GetUVCoord().GetIntU() / currentPolygonVertices[1].GetPreTranZ();
-			vOverZ = currentPolygonVertices[1].GetUVCoord().GetIntV() / currentPolygonVertices[1].GetPreTranZ();
-			zRecip = 1 / currentPolygonVertices[1].GetPreTranZ();
+		//calculates interpolation values to be used per vertex, using the 1/w kept from the projection
+		for (int j = 0; j < count; j++)
+		{
+			float uOverZ = polygonVertices[j].GetUVCoord().GetIntU() * polygonVertices[j].GetZR();
+			float vOverZ = polygonVertices[j].GetUVCoord().GetIntV() * polygonVertices[j].GetZR();
 
-			currentPolygonVertices[1].SetUOZ(uOverZ);
-			currentPolygonVertices[1].SetVOZ(vOverZ);
-			currentPolygonVertices[1].SetZR(zRecip);
+			polygonVertices[j].SetUOZ(uOverZ);
+			polygonVertices[j].SetVOZ(vOverZ);
+		}
 
-			uOverZ = currentPolygonVertices[2].GetUVCoord().GetIntU() / currentPolygonVertices[2].GetPreTranZ();
-			vOverZ = currentPolygonVertices[2].GetUVCoord().GetIntV() / currentPolygonVertices[2].GetPreTranZ();
-			zRecip = 1 / currentPolygonVertices[2].GetPreTranZ();
+		//calls texture mapping method
+		SubmitPolygon(target, polygonVertices, count, 0, TriangleShading::Textured);
+	}
 
-			currentPolygonVertices[2].SetUOZ(uOverZ);
-			currentPolygonVertices[2].SetVOZ(vOverZ);
-			currentPolygonVertices[2].SetZR(zRecip);
+	//fills any triangles that were binned for the worker threads
+	FlushTriangles();
 
-			//gets DC
-			HDC hdc = bitmap.GetDC();
+	//Draws correct label
+	DrawLabel(bitmap, L"Texture Mapping to Model");
+}
 
-			//Draws correct label
-			const wchar_t* text = L"Texture Mapping to Model";
-			SetTextColor(hdc, RGB(255, 255, 255));
-			SetBkMode(hdc, TRANSPARENT);
-			TextOut(hdc, 0, 0, text, lstrlen(text));
+void Rasteriser::FillSolidTextured(const RenderTarget& target, Vertex* currentPolygonVertices)
+{
+	//the whole triangle is drawn from one level of the mip chain, picked from how far the texture is shrunk on it
+	const Texture& texture = _model.GetTexture();
+	if (texture.GetLevelCount() == 0)
+	{
+		return;
+	}
+	const TextureLevel& level = texture.GetLevel(texture.SelectMipLevel(currentPolygonVertices[0], currentPolygonVertices[1], currentPolygonVertices[2]));
 
-			//calls texture mapping method
-			FillSolidTextured(hdc, currentPolygonVertices);
-		}
+	//the half-space fill handles the whole triangle at once, so needs no sorting or splitting
+	if (_settings.triangleFill == TriangleFill::HalfSpace)
+	{
+		HalfSpaceRasteriser::FillTextured(target, currentPolygonVertices[0], currentPolygonVertices[1], currentPolygonVertices[2], level);
+		return;
 	}
-}
 
-void Rasteriser::FillSolidTextured(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices)
-{
 	//sorts vertices by ASC Y
-	sort(currentPolygonVertices.begin(), currentPolygonVertices.end(), SortByAscY);
+	sort(currentPolygonVertices, currentPolygonVertices + 3, SortByAscY);
 
 	Vertex vertex1 = currentPolygonVertices[0];
 	Vertex vertex2 = currentPolygonVertices[1];
 	Vertex vertex3 = currentPolygonVertices[2];
 
-	COLORREF vertColour1 = vertex1.GetVertexRGB();
-	COLORREF vertColour2 = vertex2.GetVertexRGB();
-	COLORREF vertColour3 = vertex3.GetVertexRGB();
-
 	//decides which colour we are dealing with
 	if (vertex2.GetIntY() == vertex3.GetIntY())
 	{
-		TexturedFillBottomFlatTriangle(hdc, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
+		TexturedFillBottomFlatTriangle(target, vertex1, vertex2, vertex3, level);
 	}
 	else if (vertex1.GetIntY() == vertex2.GetIntY())
 	{
-		TexturedFillTopFlatTriangle(hdc, vertex1, vertex2, vertex3, vertColour1, vertColour2, vertColour3);
+		TexturedFillTopFlatTriangle(target, vertex1, vertex2, vertex3, level);
 	}
 	else
 	{
-		//interpolates vertex 4, with colour and UV values
+		//interpolates vertex 4, with UV values
 		Vertex vertTmp = Vertex((vertex1.GetIntX() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetIntX() - vertex1.GetIntX())), (float)vertex2.GetIntY(), 1, 1);
 
-		float cBlue = GetBValue(vertColour1) + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (GetBValue(vertColour3) - GetBValue(vertColour1));
-		float cRed = GetRValue(vertColour1) + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (GetRValue(vertColour3) - GetRValue(vertColour1));
-		float cGreen = GetGValue(vertColour1) + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (GetGValue(vertColour3) - GetGValue(vertColour1));
-		COLORREF cTmp = RGB(cRed, cGreen, cBlue);
-
-		float uTmp = vertex1.GetUVCoord().GetIntU() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetUVCoord().GetIntU() - vertex1.GetUVCoord().GetIntU());
-		float vTmp = vertex1.GetUVCoord().GetIntV() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetUVCoord().GetIntV() - vertex1.GetUVCoord().GetIntV());
-		float preTranZTmp = vertex1.GetPreTranZ() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetPreTranZ() - vertex1.GetPreTranZ());
+		//u/z, v/z and 1/z are linear in screen space, so they are interpolated directly
+		float uOverZTmp = vertex1.GetUOZ() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetUOZ() - vertex1.GetUOZ());
+		float vOverZTmp = vertex1.GetVOZ() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetVOZ() - vertex1.GetVOZ());
+		float zRecipTmp = vertex1.GetZR() + ((float)(vertex2.GetIntY() - vertex1.GetIntY()) / (float)(vertex3.GetIntY() - vertex1.GetIntY())) * (vertex3.GetZR() - vertex1.GetZR());
 
-		vertTmp.SetUOZ(uTmp / preTranZTmp);
-		vertTmp.SetVOZ(vTmp / preTranZTmp);
-		vertTmp.SetZR(1 / preTranZTmp);
+		vertTmp.SetUOZ(uOverZTmp);
+		vertTmp.SetVOZ(vOverZTmp);
+		vertTmp.SetZR(zRecipTmp);
 
-		TexturedFillBottomFlatTriangle(hdc, vertex1, vertex2, vertTmp, vertColour1, vertColour2, cTmp);
-		TexturedFillTopFlatTriangle(hdc, vertex2, vertTmp, vertex3, vertColour2, cTmp, vertColour3);
+		TexturedFillBottomFlatTriangle(target, vertex1, vertex2, vertTmp, level);
+		TexturedFillTopFlatTriangle(target, vertex2, vertTmp, vertex3, level);
 
 	}
 }
 
-void Rasteriser::TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
+void Rasteriser::TexturedFillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level)
 {
 	//gets slope of change in X
 	float invSlope1 = (float)(vertex2.GetIntX() - vertex1.GetIntX()) / (float)(vertex2.GetIntY() - vertex1.GetIntY());
@@ -929,31 +1701,18 @@ void Rasteriser::TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& ve
 	float currentX1 = (float)vertex1.GetIntX();
 	float currentX2 = (float)vertex1.GetIntX() + 0.5f;
 
-	//gets colour and calculation slopes depending on change in Y
+	//gets calculation slopes depending on change in Y
 	float v2v1Diff = (float)(vertex2.GetIntY() - vertex1.GetIntY());
-	float colorSlopeBlue1 = (float)(GetBValue(vertColour2) - GetBValue(vertColour1)) / v2v1Diff;
-	float colorSlopeRed1 = (float)(GetRValue(vertColour2) - GetRValue(vertColour1)) / v2v1Diff;
-	float colorSlopeGreen1 = (float)(GetGValue(vertColour2) - GetGValue(vertColour1)) / v2v1Diff;
 	float uozSlope1 = (float)(vertex2.GetUOZ() - vertex1.GetUOZ()) / v2v1Diff;
 	float vozSlope1 = (float)(vertex2.GetVOZ() - vertex1.GetVOZ()) / v2v1Diff;
 	float zrSlope1 = (float)(vertex2.GetZR() - vertex1.GetZR()) / v2v1Diff;
 
 	float v3v1Diff = (float)(vertex3.GetIntY() - vertex1.GetIntY());
-	float colorSlopeBlue2 = (float)(GetBValue(vertColour3) - GetBValue(vertColour1)) / v3v1Diff;
-	float colorSlopeRed2 = (float)(GetRValue(vertColour3) - GetRValue(vertColour1)) / v3v1Diff;
-	float colorSlopeGreen2 = (float)(GetGValue(vertColour3) - GetGValue(vertColour1)) / v3v1Diff;
 	float uozSlope2 = (float)(vertex3.GetUOZ() - vertex1.GetUOZ()) / v3v1Diff;
 	float vozSlope2 = (float)(vertex3.GetVOZ() - vertex1.GetVOZ()) / v3v1Diff;
 	float zrSlope2 = (float)(vertex3.GetZR() - vertex1.GetZR()) / v3v1Diff;
 
-	//gets starting colour/calculation values
-	float cBlue1 = GetBValue(vertColour1);
-	float cRed1 = GetRValue(vertColour1);
-	float cGreen1 = GetGValue(vertColour1);
-	float cBlue2 = GetBValue(vertColour1);
-	float cRed2 = GetRValue(vertColour1);
-	float cGreen2 = GetGValue(vertColour1);
-
+	//gets starting calculation values
 	float cU1 = (float)vertex1.GetUOZ();
 	float cU2 = (float)vertex1.GetUOZ();
 	float cV1 = (float)vertex1.GetVOZ();
@@ -968,18 +1727,6 @@ void Rasteriser::TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& ve
 		invSlope1 = invSlope2;
 		invSlope2 = slopeTemp;
 
-		slopeTemp = colorSlopeRed1;
-		colorSlopeRed1 = colorSlopeRed2;
-		colorSlopeRed2 = slopeTemp;
-
-		slopeTemp = colorSlopeGreen1;
-		colorSlopeGreen1 = colorSlopeGreen2;
-		colorSlopeGreen2 = slopeTemp;
-
-		slopeTemp = colorSlopeBlue1;
-		colorSlopeBlue1 = colorSlopeBlue2;
-		colorSlopeBlue2 = slopeTemp;
-
 		slopeTemp = uozSlope1;
 		uozSlope1 = uozSlope2;
 		uozSlope2 = slopeTemp;
@@ -993,57 +1740,58 @@ void Rasteriser::TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& ve
 		zrSlope2 = slopeTemp;
 	}
 
-	//for each pixel on each line
-	for (int scanlineY = vertex1.GetIntY(); scanlineY <= vertex2.GetIntY(); scanlineY++)
+	//rows above the target are stepped over in one go and the loop stops at its bottom, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex1.GetIntY();
+	int lastY = vertex2.GetIntY() < target.maxY ? vertex2.GetIntY() : target.maxY;
+	if (firstY < target.minY)
 	{
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
-		{
-			float t = (xPos - currentX1) / (currentX2 - currentX1);
-
-			//interpolate colour and calculation values
-			int red = (int)((1 - t) * cRed1 + t * cRed2);
-			int green = (int)((1 - t) * cGreen1 + t * cGreen2);
-			int blue = (int)((1 - t) * cBlue1 + t * cBlue2);
-
-			float uoz = (1 - t) * cU1 + t * cU2;
-			float voz = (1 - t) * cV1 + t * cV2;
-			float zr = (1 - t) * cZ1 + t * cZ2;
-
-			//convert calc values back to UV coords
-			float u = uoz / zr;
-			float v = voz / zr;
-
-			COLORREF lightingColour = RGB(red, green, blue);
+		float skipped = (float)(target.minY - firstY);
+		currentX1 += invSlope1 * skipped;
+		currentX2 += invSlope2 * skipped;
+		cU1 += uozSlope1 * skipped;
+		cU2 += uozSlope2 * skipped;
+		cV1 += vozSlope1 * skipped;
+		cV2 += vozSlope2 * skipped;
+		cZ1 += zrSlope1 * skipped;
+		cZ2 += zrSlope2 * skipped;
+		firstY = target.minY;
+	}
 
-			//set pixel to match texture colour
-			COLORREF uvColour = _model.GetTexture().GetTextureValue((int)u, (int)v);
+	//for each pixel on each line
+	for (int scanlineY = firstY; scanlineY <= lastY; scanlineY++)
+	{
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
 
-			//code below modulates lighting into the model, is not currently implemented, but can be if comment removed
-			/*float modulationR = (float)GetRValue(lightingColour) / 255;
-			float modulationG = (float)GetGValue(lightingColour) / 255;
-			float modulationB = (float)GetBValue(lightingColour) / 255;
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
+		{
+			startX = target.minX;
+		}
 
-			float pixelR = GetRValue(uvColour) * modulationR;
-			float pixelG = GetRValue(uvColour) * modulationG;
-			float pixelB = GetRValue(uvColour) * modulationB;
+		//pixels are drawn up to the one before currentX2, and u/z, v/z and 1/w are stepped across the span from
+		//their values at its first pixel
+		int endX = (int)ceil(currentX2);
+		if (endX > target.maxX + 1)
+		{
+			endX = target.maxX + 1;
+		}
 
-			COLORREF currentPixelColour = RGB(pixelR, pixelG, pixelB);*/
+		if (startX < endX)
+		{
+			float uozStep = (cU2 - cU1) / (currentX2 - currentX1);
+			float vozStep = (cV2 - cV1) / (currentX2 - currentX1);
+			float zrStep = (cZ2 - cZ1) / (currentX2 - currentX1);
+			float offset = startX - currentX1;
 
-			SetPixel(hdc, xPos, scanlineY, uvColour);
+			DrawTexturedSpan(level, row, depthRow, startX, endX, cU1 + uozStep * offset, cV1 + vozStep * offset, cZ1 + zrStep * offset, uozStep, vozStep, zrStep);
 		}
 
 		//increment values for next pass
 		currentX1 += invSlope1;
 		currentX2 += invSlope2;
 
-		cRed1 += colorSlopeRed1;
-		cGreen1 += colorSlopeGreen1;
-		cBlue1 += colorSlopeBlue1;
-
-		cRed2 += colorSlopeRed2;
-		cGreen2 += colorSlopeGreen2;
-		cBlue2 += colorSlopeBlue2;
-
 		cU1 += uozSlope1;
 		cU2 += uozSlope2;
 		cV1 += vozSlope1;
@@ -1054,7 +1802,7 @@ void Rasteriser::TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& ve
 	
 }
 
-void Rasteriser::TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3)
+void Rasteriser::TexturedFillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level)
 {
 	//gets change in X slope
 	float invSlope1 = (float)(vertex3.GetIntX() - vertex1.GetIntX()) / (float)(vertex3.GetIntY() - vertex1.GetIntY());
@@ -1064,31 +1812,18 @@ void Rasteriser::TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& verte
 	float currentX1 = (float)vertex3.GetIntX();
 	float currentX2 = (float)vertex3.GetIntX() + 0.5f;
 
-	//gets colour/calculation value slopes depending on change in Y
+	//gets calculation value slopes depending on change in Y
 	float v3v1Diff = (float)(vertex3.GetIntY() - vertex1.GetIntY());
-	float colorSlopeBlue2 = (float)(GetBValue(vertColour3) - GetBValue(vertColour1)) / v3v1Diff;
-	float colorSlopeRed2 = (float)(GetRValue(vertColour3) - GetRValue(vertColour1)) / v3v1Diff;
-	float colorSlopeGreen2 = (float)(GetGValue(vertColour3) - GetGValue(vertColour1)) / v3v1Diff;
 	float uozSlope2 = (float)(vertex3.GetUOZ() - vertex1.GetUOZ()) / v3v1Diff;
 	float vozSlope2 = (float)(vertex3.GetVOZ() - vertex1.GetVOZ()) / v3v1Diff;
 	float zrSlope2 = (float)(vertex3.GetZR() - vertex1.GetZR()) / v3v1Diff;
 
 	float v3v2Diff = (float)(vertex3.GetIntY() - vertex2.GetIntY());
-	float colorSlopeBlue1 = (float)(GetBValue(vertColour3) - GetBValue(vertColour2)) / v3v2Diff;
-	float colorSlopeRed1 = (float)(GetRValue(vertColour3) - GetRValue(vertColour2)) / v3v2Diff;
-	float colorSlopeGreen1 = (float)(GetGValue(vertColour3) - GetGValue(vertColour2)) / v3v2Diff;
 	float uozSlope1 = (float)(vertex3.GetUOZ() - vertex2.GetUOZ()) / v3v2Diff;
 	float vozSlope1 = (float)(vertex3.GetVOZ() - vertex2.GetVOZ()) / v3v2Diff;
 	float zrSlope1 = (float)(vertex3.GetZR() - vertex2.GetZR()) / v3v2Diff;
 
-	//gets starting colour/calculation values
-	float cBlue1 = GetBValue(vertColour3);
-	float cRed1 = GetRValue(vertColour3);
-	float cGreen1 = GetGValue(vertColour3);
-	float cBlue2 = GetBValue(vertColour3);
-	float cRed2 = GetRValue(vertColour3);
-	float cGreen2 = GetGValue(vertColour3);
-
+	//gets starting calculation values
 	float cU1 = (float)vertex3.GetUOZ();
 	float cU2 = (float)vertex3.GetUOZ();
 	float cV1 = (float)vertex3.GetVOZ();
@@ -1103,18 +1838,6 @@ void Rasteriser::TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& verte
 		invSlope1 = invSlope2;
 		invSlope2 = slopeTemp;
 
-		slopeTemp = colorSlopeRed1;
-		colorSlopeRed1 = colorSlopeRed2;
-		colorSlopeRed2 = slopeTemp;
-
-		slopeTemp = colorSlopeGreen1;
-		colorSlopeGreen1 = colorSlopeGreen2;
-		colorSlopeGreen2 = slopeTemp;
-
-		slopeTemp = colorSlopeBlue1;
-		colorSlopeBlue1 = colorSlopeBlue2;
-		colorSlopeBlue2 = slopeTemp;
-
 		slopeTemp = uozSlope1;
 		uozSlope1 = uozSlope2;
 		uozSlope2 = slopeTemp;
@@ -1128,58 +1851,59 @@ void Rasteriser::TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& verte
 		zrSlope2 = slopeTemp;
 	}
 
-	//for each pixel on each line
-	for (int scanlineY = vertex3.GetIntY(); scanlineY > vertex1.GetIntY(); scanlineY--)
+	//rows below the target are stepped over in one go and the loop stops at its top, so a triangle reaching
+	//far off the screen only costs the rows that are on it
+	int firstY = vertex3.GetIntY();
+	int lastY = vertex1.GetIntY() > target.minY - 1 ? vertex1.GetIntY() : target.minY - 1;
+	if (firstY > target.maxY)
 	{
+		float skipped = (float)(firstY - target.maxY);
+		currentX1 -= invSlope2 * skipped;
+		currentX2 -= invSlope1 * skipped;
+		cU1 -= uozSlope1 * skipped;
+		cU2 -= uozSlope2 * skipped;
+		cV1 -= vozSlope1 * skipped;
+		cV2 -= vozSlope2 * skipped;
+		cZ1 -= zrSlope1 * skipped;
+		cZ2 -= zrSlope2 * skipped;
+		firstY = target.maxY;
+	}
 
-		for (int xPos = (int)ceil(currentX1); xPos < currentX2; xPos++)
-		{
-			float t = (xPos - currentX1) / (currentX2 - currentX1);
-
-			//interpolate colour and calc values
-			int red = (int)((1 - t) * cRed1 + t * cRed2);
-			int green = (int)((1 - t) * cGreen1 + t * cGreen2);
-			int blue = (int)((1 - t) * cBlue1 + t * cBlue2);
-
-			float uoz = (1 - t) * cU1 + t * cU2;
-			float voz = (1 - t) * cV1 + t * cV2;
-			float zr = (1 - t) * cZ1 + t * cZ2;
-
-			//convert calc values back to UV coords
-			float u = uoz / zr;
-			float v = voz / zr;
-
-			COLORREF lightingColour = RGB(red, green, blue);
+	//for each pixel on each line
+	for (int scanlineY = firstY; scanlineY > lastY; scanlineY--)
+	{
 
-			//sets pixel colour to match mapped texture point
-			COLORREF uvColour = _model.GetTexture().GetTextureValue((int)u, (int)v);
+		unsigned int * row = target.pixels + scanlineY * target.stride;
+		float * depthRow = target.depth != nullptr ? target.depth + scanlineY * target.stride : nullptr;
 
-			//code below modulates lighting into the model, is not currently implemented but can be if comment is removed
-			/*float modulationR = (float)GetRValue(lightingColour) / 255;
-			float modulationG = (float)GetGValue(lightingColour) / 255;
-			float modulationB = (float)GetBValue(lightingColour) / 255;
+		int startX = (int)ceil(currentX1);
+		if (startX < target.minX)
+		{
+			startX = target.minX;
+		}
 
-			float pixelR = GetRValue(uvColour) * modulationR;
-			float pixelG = GetRValue(uvColour) * modulationG;
-			float pixelB = GetRValue(uvColour) * modulationB;
+		//pixels are drawn up to the one before currentX2, and u/z, v/z and 1/w are stepped across the span from
+		//their values at its first pixel
+		int endX = (int)ceil(currentX2);
+		if (endX > target.maxX + 1)
+		{
+			endX = target.maxX + 1;
+		}
 
-			COLORREF currentPixelColour = RGB(pixelR, pixelG, pixelB);*/
+		if (startX < endX)
+		{
+			float uozStep = (cU2 - cU1) / (currentX2 - currentX1);
+			float vozStep = (cV2 - cV1) / (currentX2 - currentX1);
+			float zrStep = (cZ2 - cZ1) / (currentX2 - currentX1);
+			float offset = startX - currentX1;
 
-			SetPixel(hdc, xPos, scanlineY, uvColour);
+			DrawTexturedSpan(level, row, depthRow, startX, endX, cU1 + uozStep * offset, cV1 + vozStep * offset, cZ1 + zrStep * offset, uozStep, vozStep, zrStep);
 		}
 
 		//decrements values for next pass
 		currentX1 -= invSlope2;
 		currentX2 -= invSlope1;
 
-		cRed1 -= colorSlopeRed1;
-		cGreen1 -= colorSlopeGreen1;
-		cBlue1 -= colorSlopeBlue1;
-
-		cRed2 -= colorSlopeRed2;
-		cGreen2 -= colorSlopeGreen2;
-		cBlue2 -= colorSlopeBlue2;
-
 		cU1 -= uozSlope1;
 		cU2 -= uozSlope2;
 		cV1 -= vozSlope1;
@@ -1188,4 +1912,88 @@ void Rasteriser::TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& verte
 		cZ2 -= zrSlope2;
 	}
 
+}
+
+//converts a texture coordinate to 16.16 fixed point, clamped to the texture so that stepping between two converted
+//values can never leave it
+static int ToTextureFixed(float coordinate, int size)
+{
+	if (!(coordinate > 0.0f))
+	{
+		return 0;
+	}
+	if (coordinate >= (float)size)
+	{
+		return (size << 16) - 1;
+	}
+
+	int fixed = (int)(coordinate * 65536.0f);
+	return fixed < (size << 16) ? fixed : (size << 16) - 1;
+}
+
+void Rasteriser::DrawTexturedSpan(const TextureLevel& level, unsigned int* row, float* depthRow, int startX, int endX, float uoz, float voz, float zr, float uozStep, float vozStep, float zrStep)
+{
+	const unsigned int* texels = level.texels;
+	int width = level.width;
+	int height = level.height;
+	bool powerOfTwo = level.widthShift >= 0;
+	int widthShift = level.widthShift;
+	int widthMask = width - 1;
+	int heightMask = height - 1;
+
+	//the coordinates are for the first level, so are scaled to this one
+	uoz *= level.uScale;
+	uozStep *= level.uScale;
+	voz *= level.vScale;
+	vozStep *= level.vScale;
+
+	//u and v are only divided out exactly at the ends of each run of pixels, and stepped in fixed point between
+	int u = ToTextureFixed(uoz / zr, width);
+	int v = ToTextureFixed(voz / zr, height);
+
+	int x = startX;
+	while (x < endX)
+	{
+		//the last run ends on its own last pixel rather than one past it, which may be outside the triangle
+		int length = endX - x < TextureSpanLength ? endX - x : TextureSpanLength;
+		int steps = x + length < endX ? length : length - 1;
+
+		int endU = u;
+		int endV = v;
+		int uStep = 0;
+		int vStep = 0;
+		if (steps > 0)
+		{
+			float endZr = zr + zrStep * steps;
+			endU = ToTextureFixed((uoz + uozStep * steps) / endZr, width);
+			endV = ToTextureFixed((voz + vozStep * steps) / endZr, height);
+			uStep = (endU - u) / steps;
+			vStep = (endV - v) / steps;
+		}
+
+		for (int i = 0; i < length; i++, x++)
+		{
+			//hidden pixels are skipped before the texture is read
+			if (depthRow == nullptr || zr > depthRow[x])
+			{
+				if (depthRow != nullptr)
+				{
+					depthRow[x] = zr;
+				}
+
+				int texel = powerOfTwo ? ((((v >> 16) & heightMask) << widthShift) | ((u >> 16) & widthMask)) : (v >> 16) * width + (u >> 16);
+				row[x] = texels[texel];
+			}
+
+			zr += zrStep;
+			u += uStep;
+			v += vStep;
+		}
+
+		//the next run starts from the exact values rather than the stepped ones
+		u = endU;
+		v = endV;
+		uoz += uozStep * length;
+		voz += vozStep * length;
+	}
 }
\ No newline at end of file
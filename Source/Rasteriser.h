@@ -4,15 +4,33 @@
 #include <vector>
 #include "Matrix.h"
 #include "MD2Loader.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "Frustum.h"
+#include "PolygonClipper.h"
+#include "DepthPyramid.h"
 #include "DirectionalLighting.h"
-#include <Windows.h>
+#include "RenderTarget.h"
+#include "RenderSettings.h"
+#include "HalfSpaceRasteriser.h"
+#include "TileBinner.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+#include "Platform.h"
 
 class Rasteriser : public Framework
 {
 public:
 
+	/*
+	Creates the camera and lights, ready for a model to be loaded
+	*/
+
+	Rasteriser();
+
 	/*
 	Definition of the base methods used to run the rasterizer and render models etc...
 	*/
@@ -22,6 +40,80 @@ public:
 	void Render(const Bitmap& bitmap);
 	void Shutdown();
 
+	/*
+	Loads an MD2 model and its PCX texture to be rendered, going through the mesh cache when a cache file is given
+	*/
+
+	bool LoadModel(const char* modelFile, const char* textureFile, const char* cacheFile = nullptr);
+
+	/*
+	Loads a model in the background and swaps it in for the current one once it is ready, from the
+	Update after it finishes. The current model keeps being rendered until then, and if the load
+	fails the window is closed with a message
+	*/
+
+	void LoadModelAsync(const std::string& modelFile, const std::string& textureFile, const std::string& cacheFile = "");
+
+	/*
+	Accesses the loader that runs background loads, whose finished loads are delivered at the start of each Update
+	*/
+
+	AssetLoader& GetAssetLoader();
+
+	/*
+	Mutates the model transformation and camera, for when the model is not being moved by the demo cycle
+	*/
+
+	void SetModelTransformation(const Matrix& transformation);
+	void SetCamera(const Camera& camera);
+
+	/*
+	Poses the model partway through its animation, blending the two keyframes either side
+	*/
+
+	void SetAnimationPose(const AnimationState& state);
+
+	/*
+	Mutates the instances of the model to draw, each a transformation that places a copy of it in the world after
+	the model transformation. With none, the model is drawn once, as it is in the demo cycle. With the depth buffer,
+	the nearest instances are drawn first, and the rest are skipped when a depth pyramid built from those shows
+	they would be hidden; the number skipped in the last frame is kept
+	*/
+
+	void SetInstances(const std::vector<Matrix>& instances);
+	unsigned int GetOccludedInstanceCount() const;
+
+	/*
+	Accesses / mutates the options that choose between the different rendering paths
+	*/
+
+	const RenderSettings& GetSettings() const;
+	void SetSettings(const RenderSettings& settings);
+
+	/*
+	Accesses the model being rendered
+	*/
+
+	const Model& GetModel() const;
+
+	/*
+	Accesses the profiler that times each stage of Render, which is disabled until it is enabled through here
+	*/
+
+	Profiler& GetProfiler();
+
+	/*
+	Accesses the tiles of the last multithreaded fill, including how long each one took
+	*/
+
+	const TileBinner& GetTileBinner() const;
+
+	/*
+	Accesses how many heap allocations the last call to Render made, which should be none once the first frame has sized everything
+	*/
+
+	unsigned long long GetFrameAllocationCount() const;
+
 	/*
 	Generates the perspective and viewing matrices to be taken into account on the model render
 	*/
@@ -48,9 +140,9 @@ public:
 	*/
 
 	void MyDrawSolidFlat(const Bitmap& bitmap);
-	void FillPolygonFlat(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices, const COLORREF& currentColour);
-	void FillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour);
-	void FillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour);
+	void FillPolygonFlat(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour);
+	void FillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour);
+	void FillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour);
 
 	/*
 	Collection of methods to handle gouraud shading of each individual pixel in a polygon
@@ -58,9 +150,9 @@ public:
 	*/
 
 	void GouraudShading(const Bitmap& bitmap);
-	void FillPolygonGouraud(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices);
-	void GouraudFillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
-	void GouraudFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
+	void FillPolygonGouraud(const RenderTarget& target, Vertex* currentPolygonVertices);
+	void GouraudFillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
+	void GouraudFillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
 
 	/*
 	Collection of methods to handle flat shading of each individual pixel in a polygon
@@ -68,12 +160,81 @@ public:
 	*/
 
 	void DrawSolidTextured(const Bitmap& bitmap);
-	void FillSolidTextured(const HDC& hdc, std::vector<Vertex>& currentPolygonVertices);
-	void TexturedFillBottomFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
-	void TexturedFillTopFlatTriangle(const HDC& hdc, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& vertColour1, const COLORREF& vertColour2, const COLORREF& vertColour3);
+	void FillSolidTextured(const RenderTarget& target, Vertex* currentPolygonVertices);
+	void TexturedFillBottomFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level);
+	void TexturedFillTopFlatTriangle(const RenderTarget& target, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const TextureLevel& level);
 
 private:
 
+	/*
+	Draws a span from one level of a texture from startX up to endX, given u/z, v/z and 1/w at its first pixel and their
+	steps per pixel.
+	The perspective divide is only done once every TextureSpanLength pixels, with u and v stepped in fixed point
+	between, which is too little for the error to show on a span of that length
+	*/
+
+	static const int TextureSpanLength = 16;
+
+	void DrawTexturedSpan(const TextureLevel& level, unsigned int* row, float* depthRow, int startX, int endX, float uoz, float voz, float zr, float uozStep, float vozStep, float zrStep);
+
+	/*
+	Creates the render target the fill methods draw into, attaching the depth buffer when it is in use
+	*/
+
+	RenderTarget CreateRenderTarget(const Bitmap& bitmap);
+
+	/*
+	Creates the matrix that maps clip space after the divide to the screen, and the clipper that
+	clips each polygon between projecting and filling it
+	*/
+
+	Matrix CreateScreenMatrix() const;
+	PolygonClipper CreateClipper();
+
+	/*
+	Tests the model's bounds against the view, and readies a visible model for drawing by culling,
+	transforming, lighting and sorting it, timing each stage
+	*/
+
+	bool IsModelInView();
+	void PrepareModel();
+
+	/*
+	Draws the model once with the current model transformation, or once for each instance, nearest first, checking
+	each instance after the occluders against the depth pyramid
+	*/
+
+	void DrawModel(const Bitmap& bitmap);
+	void DrawInstances(const Bitmap& bitmap);
+	bool IsModelOccluded();
+
+	/*
+	Moves the model and picks the drawing method for each step of the demonstration
+	*/
+
+	void UpdateDemoCycle();
+	void RenderDemoCycle(const Bitmap& bitmap);
+
+	/*
+	Drawing helpers. Labels and GDI polygons need a window and are skipped without one, while
+	lines go straight into the pixel memory so wireframes look the same either way
+	*/
+
+	void DrawLabel(const Bitmap& bitmap, const wchar_t* text);
+	void DrawLine(const RenderTarget& target, float x1, float y1, float x2, float y2, const COLORREF& colour);
+	bool FillPolygonGDI(const Bitmap& bitmap, const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& currentColour);
+
+	/*
+	Either fills each triangle straight away or, when more than one thread is in use, bins
+	them into tiles and fills the tiles in parallel once the whole model has been submitted
+	*/
+
+	void BeginTriangles(const RenderTarget& target);
+	void SubmitTriangle(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour, TriangleShading shading);
+	void SubmitPolygon(const RenderTarget& target, Vertex* polygonVertices, int count, const COLORREF& currentColour, TriangleShading shading);
+	void FlushTriangles();
+	void FillTriangle(const RenderTarget& target, Vertex* currentPolygonVertices, const COLORREF& currentColour, TriangleShading shading);
+
 	/*
 	Members to hold the values needed when rendering a model
 	*/
@@ -81,6 +242,30 @@ private:
 	Model _model;
 	Camera _camera;
 
+	RenderSettings _settings;
+	std::vector<float> _depthBuffer;
+
+	ThreadPool _threadPool;
+	TileBinner _tileBinner;
+
+	unsigned long long _frameAllocationCount{ 0 };
+
+	Profiler _profiler;
+
+	AssetLoader _assetLoader;
+	std::string _loadError;
+
+	struct InstanceDepth
+	{
+		float depth;
+		int index;
+	};
+
+	std::vector<Matrix> _instances;
+	std::vector<InstanceDepth> _instanceOrder;
+	DepthPyramid _depthPyramid;
+	unsigned int _occludedInstanceCount{ 0 };
+
 	std::vector<DirectionalLighting> _lightingVectors;
 	std::vector<PointLighting> _lightingPoints;
 
@@ -0,0 +1,546 @@
+#include "Rasteriser.h"
+#include "ModelFolder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+Benchmark over every MD2 model in a folder, drawing each one with every shading mode at a set
+of resolutions. Each run spins the model once round in front of the camera over a fixed number
+of frames, framed by its bounding box, so the same model always produces the same frames. Results
+are written as JSON or CSV so that they can be compared from one release to the next.
+Like the command line renderer, it is built for machines without a window.
+
+Given a number of animation instances, it instead times blending the keyframes of that many
+instances of each animated model per tick, each instance at a different point in the
+animation, to show how many animated characters the vertex pipeline can keep up with.
+*/
+
+#define PI 3.14159265
+
+struct BenchmarkOptions
+{
+	const char* modelFolder{ "MD2 Files" };
+	const char* textureFolder{ "Texture Files" };
+	const char* outputFile{ nullptr };
+	unsigned int frames{ 120 };
+	unsigned int warmupFrames{ 10 };
+	unsigned int threadCount{ 1 };
+	unsigned int animationInstances{ 0 };
+	bool csv{ false };
+	std::vector<unsigned int> widths;
+	std::vector<unsigned int> heights;
+	std::vector<ShadingMode> shadingModes;
+};
+
+struct BenchmarkResult
+{
+	std::string model;
+	size_t vertices;
+	size_t polygons;
+	unsigned int width;
+	unsigned int height;
+	const char* shading;
+	double trianglesPerFrame;
+	double coveredPixelsPerFrame;
+	double trianglesPerSecond;
+	double pixelsPerSecond;
+	double minimum;
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double maximum;
+};
+
+struct AnimationResult
+{
+	std::string model;
+	size_t vertices;
+	int frames;
+	size_t memory;
+	double verticesPerSecond;
+	double instancesPerMillisecond;
+	double minimum;
+	double mean;
+	double p50;
+	double p99;
+};
+
+static const char* const shadingNames[] = { "wireframe", "flat", "gouraud", "textured" };
+static const ShadingMode shadingModes[] = { ShadingMode::Wireframe, ShadingMode::Flat, ShadingMode::Gouraud, ShadingMode::Textured };
+
+static const char* GetShadingName(ShadingMode mode)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (shadingModes[i] == mode)
+		{
+			return shadingNames[i];
+		}
+	}
+	return "demo";
+}
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --models <folder>                    folder of MD2 files to benchmark (MD2 Files)\n"
+		"  --textures <folder>                  folder holding a PCX of the same name for each model (Texture Files)\n"
+		"  --frames <n>                         timed frames per run (120)\n"
+		"  --warmup <n>                         untimed frames before each run (10)\n"
+		"  --sizes <w>x<h>[,<w>x<h>...]         resolutions to render at (320x240,800x600,1920x1080)\n"
+		"  --shading <mode>[,<mode>...]         wireframe, flat, gouraud and/or textured (all of them)\n"
+		"  --threads <n>                        threads that fill triangles, 0 for one per core (1)\n"
+		"  --animation <instances>              time keyframe blending of this many instances per tick instead of rendering\n"
+		"  --format json|csv                    format of the results (json)\n"
+		"  --output <file>                      file to write the results to (standard output)\n",
+		program);
+}
+
+static bool ParseSizes(const char* value, BenchmarkOptions& options)
+{
+	options.widths.clear();
+	options.heights.clear();
+
+	std::string sizes = value;
+	size_t start = 0;
+	while (start <= sizes.size())
+	{
+		size_t end = sizes.find(',', start);
+		if (end == std::string::npos)
+		{
+			end = sizes.size();
+		}
+
+		unsigned int width = 0;
+		unsigned int height = 0;
+		if (sscanf(sizes.substr(start, end - start).c_str(), "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+		{
+			return false;
+		}
+		options.widths.push_back(width);
+		options.heights.push_back(height);
+		start = end + 1;
+	}
+	return true;
+}
+
+static bool ParseShadingModes(const char* value, BenchmarkOptions& options)
+{
+	options.shadingModes.clear();
+
+	std::string modes = value;
+	size_t start = 0;
+	while (start <= modes.size())
+	{
+		size_t end = modes.find(',', start);
+		if (end == std::string::npos)
+		{
+			end = modes.size();
+		}
+
+		std::string name = modes.substr(start, end - start);
+		int index = 0;
+		while (index < 4 && name != shadingNames[index])
+		{
+			index++;
+		}
+		if (index == 4)
+		{
+			return false;
+		}
+		options.shadingModes.push_back(shadingModes[index]);
+		start = end + 1;
+	}
+	return true;
+}
+
+static bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+	ParseSizes("320x240,800x600,1920x1080", options);
+	options.shadingModes.assign(shadingModes, shadingModes + 4);
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+
+		//every option takes a value
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value for %s\n", option);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		if (ModelFolder::ReadFolderOption(option, value, options.modelFolder, options.textureFolder))
+		{
+		}
+		else if (strcmp(option, "--output") == 0)
+		{
+			options.outputFile = value;
+		}
+		else if (strcmp(option, "--frames") == 0 && atoi(value) > 0)
+		{
+			options.frames = static_cast<unsigned int>(atoi(value));
+		}
+		else if (strcmp(option, "--warmup") == 0)
+		{
+			options.warmupFrames = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--threads") == 0)
+		{
+			options.threadCount = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--animation") == 0)
+		{
+			options.animationInstances = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--sizes") == 0 && ParseSizes(value, options))
+		{
+		}
+		else if (strcmp(option, "--shading") == 0 && ParseShadingModes(value, options))
+		{
+		}
+		else if (strcmp(option, "--format") == 0 && (strcmp(value, "json") == 0 || strcmp(value, "csv") == 0))
+		{
+			options.csv = strcmp(value, "csv") == 0;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option or value %s %s\n", option, value);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//nearest rank percentile of a sorted list
+static double GetPercentile(const std::vector<double>& sorted, unsigned int percentile)
+{
+	size_t rank = (sorted.size() * percentile + 99) / 100;
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+//spins the model about its centre, with the camera far enough back for the whole bounding box to stay in view.
+//The projection sees 45 degrees either side of straight ahead, so a sphere fits in at any distance over root 2 times its radius
+static void ApplySchedule(Rasteriser& rasteriser, const Vector3D& centre, float radius, unsigned int frame, unsigned int frames)
+{
+	float radians = static_cast<float>(2.0 * PI * frame / frames);
+
+	Matrix spin = { cos(radians), 0, sin(radians), 0,
+					0, 1, 0, 0,
+					sin(-radians), 0, cos(radians), 0,
+					0, 0, 0, 1 };
+	Matrix centring = { 1, 0, 0, -centre.GetX(),
+						0, 1, 0, -centre.GetY(),
+						0, 0, 1, -centre.GetZ(),
+						0, 0, 0, 1 };
+
+	rasteriser.SetModelTransformation(spin * centring);
+	rasteriser.SetCamera(Camera(0.0f, 0.0f, 0.0f, Vertex(0, 0, -1.5f * radius, 1)));
+}
+
+static BenchmarkResult RunBenchmark(Rasteriser& rasteriser, Bitmap& bitmap, const BenchmarkOptions& options, ShadingMode shadingMode)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	RenderSettings settings = rasteriser.GetSettings();
+	settings.shadingMode = shadingMode;
+	settings.threadCount = options.threadCount;
+	rasteriser.SetSettings(settings);
+
+	Vector3D minimum;
+	Vector3D maximum;
+	rasteriser.GetModel().GetLocalBounds(minimum, maximum);
+	Vector3D centre((minimum.GetX() + maximum.GetX()) / 2, (minimum.GetY() + maximum.GetY()) / 2, (minimum.GetZ() + maximum.GetZ()) / 2);
+	Vector3D halfSize(maximum.GetX() - centre.GetX(), maximum.GetY() - centre.GetY(), maximum.GetZ() - centre.GetZ());
+	float radius = sqrt(halfSize.GetX() * halfSize.GetX() + halfSize.GetY() * halfSize.GetY() + halfSize.GetZ() * halfSize.GetZ());
+	radius = radius > 0.001f ? radius : 1.0f;
+
+	//the warm up frames size the buffers and thread pool, so that the timed frames are all alike
+	for (unsigned int frame = 0; frame < options.warmupFrames; frame++)
+	{
+		ApplySchedule(rasteriser, centre, radius, frame, options.frames);
+		rasteriser.Update(bitmap);
+		rasteriser.Render(bitmap);
+	}
+
+	std::vector<double> frameTimes;
+	frameTimes.reserve(options.frames);
+	unsigned long long triangles = 0;
+	unsigned long long coveredPixels = 0;
+
+	for (unsigned int frame = 0; frame < options.frames; frame++)
+	{
+		ApplySchedule(rasteriser, centre, radius, frame, options.frames);
+
+		Clock::time_point start = Clock::now();
+		rasteriser.Update(bitmap);
+		rasteriser.Render(bitmap);
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+		//counted outside the timing, the polygons that survived culling and the pixels that were drawn
+		const std::vector<Polygon3D>& polygons = rasteriser.GetModel().GetPolygons();
+		for (size_t i = 0; i < polygons.size(); i++)
+		{
+			triangles += polygons[i].GetCullState() ? 0 : 1;
+		}
+
+		const unsigned int* pixels = bitmap.GetPixels();
+		for (unsigned int y = 0; y < bitmap.GetHeight(); y++)
+		{
+			for (unsigned int x = 0; x < bitmap.GetWidth(); x++)
+			{
+				coveredPixels += pixels[y * bitmap.GetStride() + x] != 0 ? 1 : 0;
+			}
+		}
+	}
+
+	double totalMilliseconds = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		totalMilliseconds += frameTimes[i];
+	}
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	double totalSeconds = totalMilliseconds / 1000.0;
+
+	BenchmarkResult result;
+	result.vertices = rasteriser.GetModel().GetVertexCount();
+	result.polygons = rasteriser.GetModel().GetPolygonCount();
+	result.width = bitmap.GetWidth();
+	result.height = bitmap.GetHeight();
+	result.shading = GetShadingName(shadingMode);
+	result.trianglesPerFrame = static_cast<double>(triangles) / options.frames;
+	result.coveredPixelsPerFrame = static_cast<double>(coveredPixels) / options.frames;
+	result.trianglesPerSecond = totalSeconds > 0.0 ? triangles / totalSeconds : 0.0;
+	result.pixelsPerSecond = totalSeconds > 0.0 ? coveredPixels / totalSeconds : 0.0;
+	result.minimum = frameTimes.front();
+	result.mean = totalMilliseconds / options.frames;
+	result.p50 = GetPercentile(frameTimes, 50);
+	result.p90 = GetPercentile(frameTimes, 90);
+	result.p99 = GetPercentile(frameTimes, 99);
+	result.maximum = frameTimes.back();
+	return result;
+}
+
+//poses every instance once per tick, each a whole animation apart divided between the instances.
+//The instances share one set of output streams, as a renderer drawing them one after another would
+static AnimationResult RunAnimationBenchmark(const Model& model, const BenchmarkOptions& options)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const KeyframeAnimation& animation = model.GetAnimation();
+	std::vector<AnimationState> instances(options.animationInstances);
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		animation.StartSequence(instances[i], 0, animation.GetFrameCount(), 10.0f);
+		instances[i].time = static_cast<float>(animation.GetFrameCount()) * i / instances.size();
+	}
+
+	VertexStream positions;
+	VertexStream normals;
+	std::vector<double> tickTimes;
+	tickTimes.reserve(options.frames);
+
+	for (unsigned int tick = 0; tick < options.warmupFrames + options.frames; tick++)
+	{
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			KeyframeAnimation::Advance(instances[i], 1.0f / 60.0f);
+			animation.Interpolate(instances[i], positions, normals);
+		}
+		double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (tick >= options.warmupFrames)
+		{
+			tickTimes.push_back(milliseconds);
+		}
+	}
+
+	double totalMilliseconds = 0.0;
+	for (size_t i = 0; i < tickTimes.size(); i++)
+	{
+		totalMilliseconds += tickTimes[i];
+	}
+	std::sort(tickTimes.begin(), tickTimes.end());
+
+	double instancePoses = static_cast<double>(instances.size()) * options.frames;
+
+	AnimationResult result;
+	result.vertices = animation.GetVertexCount();
+	result.frames = animation.GetFrameCount();
+	result.memory = animation.GetMemoryUsage();
+	result.verticesPerSecond = totalMilliseconds > 0.0 ? instancePoses * result.vertices * 1000.0 / totalMilliseconds : 0.0;
+	result.instancesPerMillisecond = totalMilliseconds > 0.0 ? instancePoses / totalMilliseconds : 0.0;
+	result.minimum = tickTimes.front();
+	result.mean = totalMilliseconds / options.frames;
+	result.p50 = GetPercentile(tickTimes, 50);
+	result.p99 = GetPercentile(tickTimes, 99);
+	return result;
+}
+
+static void WriteAnimationResults(FILE* output, const BenchmarkOptions& options, const std::vector<AnimationResult>& results)
+{
+	if (options.csv)
+	{
+		fprintf(output, "model,vertices,frames,memoryBytes,verticesPerSecond,instancesPerMs,minTickMs,meanTickMs,p50TickMs,p99TickMs\n");
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const AnimationResult& result = results[i];
+			fprintf(output, "%s,%zu,%d,%zu,%.0f,%.1f,%.4f,%.4f,%.4f,%.4f\n",
+				result.model.c_str(), result.vertices, result.frames, result.memory, result.verticesPerSecond, result.instancesPerMillisecond,
+				result.minimum, result.mean, result.p50, result.p99);
+		}
+		return;
+	}
+
+	fprintf(output, "{\n  \"ticks\": %u,\n  \"warmupTicks\": %u,\n  \"instances\": %u,\n  \"results\": [\n", options.frames, options.warmupFrames, options.animationInstances);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const AnimationResult& result = results[i];
+		fprintf(output,
+			"    {\"model\": \"%s\", \"vertices\": %zu, \"frames\": %d, \"memoryBytes\": %zu, \"verticesPerSecond\": %.0f, \"instancesPerMs\": %.1f, "
+			"\"tickMs\": {\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f}}%s\n",
+			result.model.c_str(), result.vertices, result.frames, result.memory, result.verticesPerSecond, result.instancesPerMillisecond,
+			result.minimum, result.mean, result.p50, result.p99,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(output, "  ]\n}\n");
+}
+
+static void WriteResults(FILE* output, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results)
+{
+	if (options.csv)
+	{
+		fprintf(output, "model,vertices,polygons,width,height,shading,trianglesPerFrame,coveredPixelsPerFrame,trianglesPerSecond,pixelsPerSecond,minMs,meanMs,p50Ms,p90Ms,p99Ms,maxMs\n");
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const BenchmarkResult& result = results[i];
+			fprintf(output, "%s,%zu,%zu,%u,%u,%s,%.1f,%.1f,%.0f,%.0f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+				result.model.c_str(), result.vertices, result.polygons, result.width, result.height, result.shading,
+				result.trianglesPerFrame, result.coveredPixelsPerFrame, result.trianglesPerSecond, result.pixelsPerSecond,
+				result.minimum, result.mean, result.p50, result.p90, result.p99, result.maximum);
+		}
+		return;
+	}
+
+	fprintf(output, "{\n  \"frames\": %u,\n  \"warmupFrames\": %u,\n  \"threads\": %u,\n  \"results\": [\n", options.frames, options.warmupFrames, options.threadCount);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		fprintf(output,
+			"    {\"model\": \"%s\", \"vertices\": %zu, \"polygons\": %zu, \"width\": %u, \"height\": %u, \"shading\": \"%s\", "
+			"\"trianglesPerFrame\": %.1f, \"coveredPixelsPerFrame\": %.1f, \"trianglesPerSecond\": %.0f, \"pixelsPerSecond\": %.0f, "
+			"\"frameMs\": {\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}}%s\n",
+			result.model.c_str(), result.vertices, result.polygons, result.width, result.height, result.shading,
+			result.trianglesPerFrame, result.coveredPixelsPerFrame, result.trianglesPerSecond, result.pixelsPerSecond,
+			result.minimum, result.mean, result.p50, result.p90, result.p99, result.maximum,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(output, "  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> models = ModelFolder::FindModels(options.modelFolder);
+	if (models.empty())
+	{
+		fprintf(stderr, "No MD2 files found in %s\n", options.modelFolder);
+		return 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	std::vector<AnimationResult> animationResults;
+
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		//the texture is the PCX file with the same name as the model, if there is one
+		std::string name = models[i].substr(0, models[i].size() - 4);
+		std::string modelFile = std::string(options.modelFolder) + "/" + models[i];
+		std::string textureFile = std::string(options.textureFolder) + "/" + name + ".pcx";
+
+		Rasteriser rasteriser;
+		if (!rasteriser.LoadModel(modelFile.c_str(), textureFile.c_str()))
+		{
+			fprintf(stderr, "Unable to load %s, skipping it\n", modelFile.c_str());
+			continue;
+		}
+
+		//models with a single frame have nothing to blend
+		if (options.animationInstances > 0)
+		{
+			if (rasteriser.GetModel().GetAnimation().GetFrameCount() > 1)
+			{
+				fprintf(stderr, "%s %u instances\n", models[i].c_str(), options.animationInstances);
+
+				animationResults.push_back(RunAnimationBenchmark(rasteriser.GetModel(), options));
+				animationResults.back().model = models[i];
+			}
+			continue;
+		}
+
+		for (size_t size = 0; size < options.widths.size(); size++)
+		{
+			Bitmap bitmap;
+			bitmap.Create(options.widths[size], options.heights[size]);
+
+			for (size_t mode = 0; mode < options.shadingModes.size(); mode++)
+			{
+				//without a texture there are no UV coords to map, so the textured run would only repeat the Gouraud one
+				if (options.shadingModes[mode] == ShadingMode::Textured && rasteriser.GetModel().GetUVCoords().empty())
+				{
+					continue;
+				}
+
+				fprintf(stderr, "%s %ux%u %s\n", models[i].c_str(), options.widths[size], options.heights[size], GetShadingName(options.shadingModes[mode]));
+
+				results.push_back(RunBenchmark(rasteriser, bitmap, options, options.shadingModes[mode]));
+				results.back().model = models[i];
+			}
+		}
+	}
+
+	FILE* output = stdout;
+	if (options.outputFile != nullptr)
+	{
+		output = fopen(options.outputFile, "w");
+		if (output == nullptr)
+		{
+			fprintf(stderr, "Unable to write %s\n", options.outputFile);
+			return 1;
+		}
+	}
+
+	if (options.animationInstances > 0)
+	{
+		WriteAnimationResults(output, options, animationResults);
+	}
+	else
+	{
+		WriteResults(output, options, results);
+	}
+
+	if (output != stdout)
+	{
+		fclose(output);
+	}
+
+	return 0;
+}
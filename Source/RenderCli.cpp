@@ -0,0 +1,415 @@
+#include "Rasteriser.h"
+#include "ImageWriter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+Command line renderer for machines without a window. Loads an MD2 model and PCX texture,
+renders a number of frames into an offscreen bitmap as fast as it can, with no frame pacing,
+and optionally saves each frame as an image. Built instead of the windowed Framework, so it
+links against the non-Win32 Bitmap.
+*/
+
+#define PI 3.14159265
+
+//how the model or camera moves over the frames that are rendered
+enum class CameraPath
+{
+	Static,
+	Turntable,
+	Orbit
+};
+
+struct CliOptions
+{
+	const char* modelFile{ nullptr };
+	const char* textureFile{ nullptr };
+	const char* outputPrefix{ "frame_" };
+	const char* traceFile{ nullptr };
+	const char* animation{ nullptr };
+	const char* cacheFile{ nullptr };
+	unsigned int frames{ 1 };
+	unsigned int instances{ 0 };
+	unsigned int width{ 800 };
+	unsigned int height{ 600 };
+	float distance{ 50.0f };
+	CameraPath path{ CameraPath::Turntable };
+	bool writeImages{ true };
+	ImageFormat format{ ImageFormat::PPM };
+	RenderSettings settings;
+};
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr,
+		"Usage: %s --model <file.md2> --texture <file.pcx> [options]\n"
+		"  --frames <n>                                  frames to render (1)\n"
+		"  --size <width>x<height>                       size of the image (800x600)\n"
+		"  --shading wireframe|flat|gouraud|textured     how the model is drawn (textured)\n"
+		"  --path static|turntable|orbit                 how the view moves over the frames (turntable)\n"
+		"  --distance <d>                                distance of the camera from the model (50)\n"
+		"  --cache <file.mesh>                           loads through this mesh cache, rebuilding it if it is missing or stale\n"
+		"  --animation <name>                            plays the frames with this name once over the rendered frames, such as run\n"
+		"  --format ppm|png|raw|none                     image format to save each frame in (ppm)\n"
+		"  --output <prefix>                             prefix of the image files (frame_)\n"
+		"  --threads <n>                                 threads that fill triangles, 0 for one per core (0)\n"
+		"  --tile-size <pixels>                          size of the tiles filled by each thread (64)\n"
+		"  --depth zbuffer|painters                      hidden surface removal (zbuffer)\n"
+		"  --sort radix|comparison                       how the painters' sort orders the polygons (radix)\n"
+		"  --fill halfspace|scanline                     triangle fill routine (halfspace)\n"
+		"  --transform fused|separate                    vertex transform pipeline (fused)\n"
+		"  --frustum on|off                              skips models whose bounds are outside the view (on)\n"
+		"  --instances <n>                               draws n copies of the model in rows going away from the camera\n"
+		"  --occlusion on|off                            skips copies hidden behind the nearest ones (on)\n"
+		"  --profile <trace.json>                        time each stage, printing a summary and saving a Chrome trace\n",
+		program);
+}
+
+//matches an option value against a list of names, returning the index of the match or -1
+static int MatchName(const char* value, const char* const* names, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (strcmp(value, names[i]) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool ParseOptions(int argc, char* argv[], CliOptions& options)
+{
+	static const char* const shadingNames[] = { "wireframe", "flat", "gouraud", "textured" };
+	static const ShadingMode shadingModes[] = { ShadingMode::Wireframe, ShadingMode::Flat, ShadingMode::Gouraud, ShadingMode::Textured };
+	static const char* const pathNames[] = { "static", "turntable", "orbit" };
+	static const char* const formatNames[] = { "ppm", "png", "raw", "none" };
+	static const char* const depthNames[] = { "painters", "zbuffer" };
+	static const char* const sortNames[] = { "comparison", "radix" };
+	static const char* const fillNames[] = { "scanline", "halfspace" };
+	static const char* const transformNames[] = { "separate", "fused" };
+	static const char* const switchNames[] = { "off", "on" };
+
+	options.settings.shadingMode = ShadingMode::Textured;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+
+		//every option takes a value
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value for %s\n", option);
+			return false;
+		}
+		const char* value = argv[++i];
+		int index = 0;
+
+		if (strcmp(option, "--model") == 0)
+		{
+			options.modelFile = value;
+		}
+		else if (strcmp(option, "--texture") == 0)
+		{
+			options.textureFile = value;
+		}
+		else if (strcmp(option, "--output") == 0)
+		{
+			options.outputPrefix = value;
+		}
+		else if (strcmp(option, "--cache") == 0)
+		{
+			options.cacheFile = value;
+		}
+		else if (strcmp(option, "--animation") == 0)
+		{
+			options.animation = value;
+		}
+		else if (strcmp(option, "--profile") == 0)
+		{
+			options.traceFile = value;
+		}
+		else if (strcmp(option, "--frames") == 0)
+		{
+			options.frames = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--size") == 0)
+		{
+			if (sscanf(value, "%ux%u", &options.width, &options.height) != 2 || options.width == 0 || options.height == 0)
+			{
+				fprintf(stderr, "Invalid size %s\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(option, "--instances") == 0)
+		{
+			options.instances = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--distance") == 0)
+		{
+			options.distance = static_cast<float>(atof(value));
+		}
+		else if (strcmp(option, "--threads") == 0)
+		{
+			options.settings.threadCount = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else if (strcmp(option, "--tile-size") == 0)
+		{
+			options.settings.tileSize = atoi(value);
+		}
+		else if (strcmp(option, "--shading") == 0 && (index = MatchName(value, shadingNames, 4)) >= 0)
+		{
+			options.settings.shadingMode = shadingModes[index];
+		}
+		else if (strcmp(option, "--path") == 0 && (index = MatchName(value, pathNames, 3)) >= 0)
+		{
+			options.path = static_cast<CameraPath>(index);
+		}
+		else if (strcmp(option, "--format") == 0 && (index = MatchName(value, formatNames, 4)) >= 0)
+		{
+			options.writeImages = index < 3;
+			options.format = index < 3 ? static_cast<ImageFormat>(index) : ImageFormat::PPM;
+		}
+		else if (strcmp(option, "--depth") == 0 && (index = MatchName(value, depthNames, 2)) >= 0)
+		{
+			options.settings.depthMode = static_cast<DepthMode>(index);
+		}
+		else if (strcmp(option, "--sort") == 0 && (index = MatchName(value, sortNames, 2)) >= 0)
+		{
+			options.settings.depthSort = static_cast<DepthSort>(index);
+		}
+		else if (strcmp(option, "--fill") == 0 && (index = MatchName(value, fillNames, 2)) >= 0)
+		{
+			options.settings.triangleFill = static_cast<TriangleFill>(index);
+		}
+		else if (strcmp(option, "--transform") == 0 && (index = MatchName(value, transformNames, 2)) >= 0)
+		{
+			options.settings.transformPipeline = static_cast<TransformPipeline>(index);
+		}
+		else if (strcmp(option, "--frustum") == 0 && (index = MatchName(value, switchNames, 2)) >= 0)
+		{
+			options.settings.frustumCulling = index == 1;
+		}
+		else if (strcmp(option, "--occlusion") == 0 && (index = MatchName(value, switchNames, 2)) >= 0)
+		{
+			options.settings.occlusionCulling = index == 1;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option or value %s %s\n", option, value);
+			return false;
+		}
+	}
+
+	if (options.modelFile == nullptr || options.textureFile == nullptr)
+	{
+		fprintf(stderr, "A model and texture must be given\n");
+		return false;
+	}
+
+	return true;
+}
+
+//sets up the model transformation and camera for one frame of the path, going once round over all the frames
+static void ApplyCameraPath(Rasteriser& rasteriser, const CliOptions& options, unsigned int frame)
+{
+	float radians = static_cast<float>(2.0 * PI * frame / options.frames);
+
+	Matrix modelTransformation = { 1, 0, 0, 0,
+								   0, 1, 0, 0,
+								   0, 0, 1, 0,
+								   0, 0, 0, 1 };
+	Camera camera(0.0f, 0.0f, 0.0f, Vertex(0, 0, -options.distance, 1));
+
+	switch (options.path)
+	{
+	case CameraPath::Static:
+		break;
+	case CameraPath::Turntable:
+		//spins the model about its y axis in front of a fixed camera, as the demo does
+		modelTransformation = { cos(radians), 0, sin(radians), 0,
+								0, 1, 0, 0,
+								sin(-radians), 0, cos(radians), 0,
+								0, 0, 0, 1 };
+		break;
+	case CameraPath::Orbit:
+		//moves the camera round the model, turning it so that it keeps looking at the origin
+		camera = Camera(0.0f, radians, 0.0f, Vertex(-options.distance * sin(radians), 0, -options.distance * cos(radians), 1));
+		break;
+	}
+
+	rasteriser.SetModelTransformation(modelTransformation);
+	rasteriser.SetCamera(camera);
+}
+
+//places the copies in a square grid of rows, the first centred in front of the camera and each later row further
+//away, spaced by the size of the model so that they do not overlap
+static void ApplyInstances(Rasteriser& rasteriser, const CliOptions& options)
+{
+	Vector3D centre;
+	float radius;
+	rasteriser.GetModel().GetBoundingSphere(centre, radius);
+	float spacing = 2.0f * radius;
+
+	unsigned int columns = static_cast<unsigned int>(ceil(sqrt(static_cast<double>(options.instances))));
+	std::vector<Matrix> instances;
+	for (unsigned int i = 0; i < options.instances; i++)
+	{
+		float x = (static_cast<float>(i % columns) - 0.5f * (columns - 1)) * spacing;
+		float z = static_cast<float>(i / columns) * spacing;
+		instances.push_back(Matrix{ 1, 0, 0, x,
+									0, 1, 0, 0,
+									0, 0, 1, z,
+									0, 0, 0, 1 });
+	}
+	rasteriser.SetInstances(instances);
+}
+
+int main(int argc, char* argv[])
+{
+	CliOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	Rasteriser rasteriser;
+	rasteriser.SetSettings(options.settings);
+	if (!rasteriser.LoadModel(options.modelFile, options.textureFile, options.cacheFile))
+	{
+		fprintf(stderr, "Unable to load %s with %s\n", options.modelFile, options.textureFile);
+		return 1;
+	}
+
+	if (options.instances > 0)
+	{
+		ApplyInstances(rasteriser, options);
+	}
+
+	//the animation is spread over the rendered frames, as the camera path is
+	AnimationState animationState;
+	if (options.animation != nullptr)
+	{
+		const KeyframeAnimation& animation = rasteriser.GetModel().GetAnimation();
+		int firstFrame = 0;
+		int frameCount = 0;
+		if (!animation.FindSequence(options.animation, firstFrame, frameCount))
+		{
+			fprintf(stderr, "No frames named %s in %s\n", options.animation, options.modelFile);
+			return 1;
+		}
+		animation.StartSequence(animationState, firstFrame, frameCount, 0.0f);
+	}
+
+	Bitmap bitmap;
+	bitmap.Create(options.width, options.height);
+
+	Profiler& profiler = rasteriser.GetProfiler();
+	profiler.SetEnabled(options.traceFile != nullptr);
+
+	static const char* const extensions[] = { ".ppm", ".png", ".raw" };
+	ImageWriter writer;
+	std::string filename;
+
+	typedef std::chrono::steady_clock Clock;
+	double renderSeconds = 0.0;
+	double writeSeconds = 0.0;
+
+	for (unsigned int frame = 0; frame < options.frames; frame++)
+	{
+		Clock::time_point start = Clock::now();
+
+		ApplyCameraPath(rasteriser, options, frame);
+		if (options.animation != nullptr)
+		{
+			animationState.time = static_cast<float>(animationState.frameCount) * frame / options.frames;
+			rasteriser.SetAnimationPose(animationState);
+		}
+		rasteriser.Update(bitmap);
+		rasteriser.Render(bitmap);
+
+		Clock::time_point rendered = Clock::now();
+		renderSeconds += std::chrono::duration<double>(rendered - start).count();
+
+		if (options.writeImages)
+		{
+			char number[16];
+			snprintf(number, sizeof(number), "%04u", frame);
+			filename = options.outputPrefix;
+			filename += number;
+			filename += extensions[static_cast<int>(options.format)];
+
+			if (!writer.Write(filename.c_str(), bitmap, options.format))
+			{
+				fprintf(stderr, "Unable to write %s\n", filename.c_str());
+				return 1;
+			}
+
+			writeSeconds += std::chrono::duration<double>(Clock::now() - rendered).count();
+		}
+	}
+
+	double totalSeconds = renderSeconds + writeSeconds;
+	printf("%u frames at %ux%u, %u polygons\n", options.frames, options.width, options.height,
+		static_cast<unsigned int>(rasteriser.GetModel().GetPolygonCount()));
+	printf("render %.3f ms/frame, write %.3f ms/frame, %.1f frames/s overall\n",
+		options.frames > 0 ? renderSeconds * 1000.0 / options.frames : 0.0,
+		options.frames > 0 ? writeSeconds * 1000.0 / options.frames : 0.0,
+		totalSeconds > 0.0 ? options.frames / totalSeconds : 0.0);
+	printf("allocations in the last frame: %llu\n", rasteriser.GetFrameAllocationCount());
+	if (options.instances > 0)
+	{
+		printf("instances hidden in the last frame: %u of %u\n", rasteriser.GetOccludedInstanceCount(), options.instances);
+	}
+
+	if (profiler.IsEnabled())
+	{
+		//only the stages that ran are listed
+		printf("\n%-28s %8s %10s %10s %10s\n", "stage (ms)", "frames", "min", "mean", "p99");
+		for (int i = 0; i < static_cast<int>(ProfileStage::Count); i++)
+		{
+			ProfileStage stage = static_cast<ProfileStage>(i);
+			StageStatistics statistics = profiler.GetStatistics(stage);
+			if (statistics.frames > 0)
+			{
+				printf("%-28s %8u %10.4f %10.4f %10.4f\n", Profiler::GetStageName(stage), statistics.frames, statistics.minimum, statistics.mean, statistics.p99);
+			}
+		}
+
+		//the tiles are only filled apart when there is more than one thread, and only those with something in them count
+		const std::vector<float>& tileTimings = rasteriser.GetTileBinner().GetTileTimings();
+		unsigned int filledTiles = 0;
+		float tileMinimum = 0.0f;
+		float tileMaximum = 0.0f;
+		float tileTotal = 0.0f;
+		for (size_t i = 0; i < tileTimings.size(); i++)
+		{
+			if (tileTimings[i] > 0.0f)
+			{
+				tileMinimum = filledTiles == 0 || tileTimings[i] < tileMinimum ? tileTimings[i] : tileMinimum;
+				tileMaximum = tileTimings[i] > tileMaximum ? tileTimings[i] : tileMaximum;
+				tileTotal += tileTimings[i];
+				filledTiles++;
+			}
+		}
+		if (filledTiles > 0)
+		{
+			printf("\n%-28s %8s %10s %10s %10s\n", "tiles in last frame (ms)", "tiles", "min", "mean", "max");
+			printf("%-28s %8u %10.4f %10.4f %10.4f\n", "TileFill", filledTiles, tileMinimum, tileTotal / filledTiles, tileMaximum);
+		}
+
+		if (!profiler.ExportChromeTrace(options.traceFile))
+		{
+			fprintf(stderr, "Unable to write %s\n", options.traceFile);
+			return 1;
+		}
+	}
+
+	return 0;
+}
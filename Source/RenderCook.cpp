@@ -0,0 +1,114 @@
+#include "MeshCache.h"
+#include "ModelFolder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+The offline cook step for the mesh cache. Every MD2 model in a folder is loaded with the PCX
+of the same name, if there is one, and written out as a .mesh cache file that the renderer
+can load without decoding anything. The renderer rebuilds a cache itself when its sources
+change, so cooking ahead of time only saves that first slow start.
+*/
+
+struct CookOptions
+{
+	const char* modelFolder{ "MD2 Files" };
+	const char* textureFolder{ "Texture Files" };
+	const char* outputFolder{ "Mesh Cache" };
+};
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --models <folder>                    folder of MD2 files to cook (MD2 Files)\n"
+		"  --textures <folder>                  folder holding a PCX of the same name for each model (Texture Files)\n"
+		"  --output <folder>                    existing folder to write the .mesh files to (Mesh Cache)\n",
+		program);
+}
+
+static bool ParseOptions(int argc, char* argv[], CookOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+
+		//every option takes a value
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value for %s\n", option);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		if (ModelFolder::ReadFolderOption(option, value, options.modelFolder, options.textureFolder))
+		{
+		}
+		else if (strcmp(option, "--output") == 0)
+		{
+			options.outputFolder = value;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option or value %s %s\n", option, value);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	CookOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> models = ModelFolder::FindModels(options.modelFolder);
+	if (models.empty())
+	{
+		fprintf(stderr, "No MD2 files found in %s\n", options.modelFolder);
+		return 1;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	int failures = 0;
+
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		std::string name = models[i].substr(0, models[i].size() - 4);
+		std::string modelFile = std::string(options.modelFolder) + "/" + models[i];
+		std::string textureFile = std::string(options.textureFolder) + "/" + name + ".pcx";
+		std::string cacheFile = std::string(options.outputFolder) + "/" + name + ".mesh";
+
+		Clock::time_point start = Clock::now();
+		if (!MeshCache::Cook(modelFile.c_str(), textureFile.c_str(), cacheFile.c_str()))
+		{
+			fprintf(stderr, "Unable to cook %s to %s\n", modelFile.c_str(), cacheFile.c_str());
+			failures++;
+			continue;
+		}
+		Clock::time_point cooked = Clock::now();
+
+		//loads the cache straight back, to show what it saves
+		Model model;
+		unsigned long long sourceChecksum = 0;
+		MeshCache::CalculateSourceChecksum(modelFile.c_str(), textureFile.c_str(), sourceChecksum);
+		bool readBack = MeshCache::Read(cacheFile.c_str(), sourceChecksum, model);
+		Clock::time_point read = Clock::now();
+
+		printf("%-24s cooked in %7.3f ms, read back in %7.3f ms%s\n", cacheFile.c_str(),
+			std::chrono::duration<double, std::milli>(cooked - start).count(),
+			std::chrono::duration<double, std::milli>(read - cooked).count(),
+			readBack ? "" : " (failed)");
+		failures += readBack ? 0 : 1;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,371 @@
+#include "Rasteriser.h"
+#include "ImageWriter.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+/*
+Golden image regression check for the rasteriser. Renders a fixed set of scenes from the bundled
+models, covering every shading mode with both triangle fill routines, both depth modes, both
+painters' sorts and both transform pipelines, and compares each one with a stored reference image.
+
+A pixel differs when any of its channels is more than the tolerance away from the reference, and
+a scene fails when more pixels differ than it allows. For every failing scene a diff image is
+written that shows the reference dimmed to grey with the differing pixels in red, brighter the
+larger the difference. Running with --update renders the references instead.
+Like the command line renderer, it is built for machines without a window.
+*/
+
+#define PI 3.14159265
+
+struct RegressionScene
+{
+	const char* name;
+	const char* model;
+	const char* texture;
+	ShadingMode shadingMode;
+	TriangleFill triangleFill;
+	DepthMode depthMode;
+	TransformPipeline transformPipeline;
+	float angle;
+	DepthSort depthSort{ DepthSort::Radix };
+	unsigned int frames{ 1 };
+};
+
+static const RegressionScene scenes[] =
+{
+	{ "marvin_wireframe", "marvin.md2", "marvin.pcx", ShadingMode::Wireframe, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_flat_scanline", "marvin.md2", "marvin.pcx", ShadingMode::Flat, TriangleFill::Scanline, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_flat_halfspace", "marvin.md2", "marvin.pcx", ShadingMode::Flat, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_flat_painters", "marvin.md2", "marvin.pcx", ShadingMode::Flat, TriangleFill::Scanline, DepthMode::PaintersSort, TransformPipeline::Fused, 30.0f },
+	{ "marvin_flat_painters_comparison", "marvin.md2", "marvin.pcx", ShadingMode::Flat, TriangleFill::Scanline, DepthMode::PaintersSort, TransformPipeline::Fused, 30.0f, DepthSort::Comparison, 6 },
+	{ "marvin_gouraud_scanline", "marvin.md2", "marvin.pcx", ShadingMode::Gouraud, TriangleFill::Scanline, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_gouraud_halfspace", "marvin.md2", "marvin.pcx", ShadingMode::Gouraud, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_textured_scanline", "marvin.md2", "marvin.pcx", ShadingMode::Textured, TriangleFill::Scanline, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_textured_halfspace", "marvin.md2", "marvin.pcx", ShadingMode::Textured, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Fused, 30.0f },
+	{ "marvin_textured_separate", "marvin.md2", "marvin.pcx", ShadingMode::Textured, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Separate, 200.0f },
+	{ "teapot_gouraud_scanline", "teapot.md2", nullptr, ShadingMode::Gouraud, TriangleFill::Scanline, DepthMode::ZBuffer, TransformPipeline::Fused, 120.0f },
+	{ "helicopter_flat_halfspace", "helicopter.md2", nullptr, ShadingMode::Flat, TriangleFill::HalfSpace, DepthMode::ZBuffer, TransformPipeline::Fused, 300.0f }
+};
+
+const unsigned int SceneCount = sizeof(scenes) / sizeof(scenes[0]);
+const unsigned int SceneWidth = 200;
+const unsigned int SceneHeight = 150;
+const float FrameStep = 30.0f;
+
+struct RegressionOptions
+{
+	const char* modelFolder{ "MD2 Files" };
+	const char* textureFolder{ "Texture Files" };
+	const char* referenceFolder{ "Reference Images" };
+	const char* diffFolder{ "." };
+	int tolerance{ 2 };
+	unsigned int maxDifferingPixels{ 30 };
+	bool update{ false };
+};
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --models <folder>          folder holding the MD2 files (MD2 Files)\n"
+		"  --textures <folder>        folder holding the PCX files (Texture Files)\n"
+		"  --references <folder>      folder holding the reference images (Reference Images)\n"
+		"  --diffs <folder>           folder to write diff images of failing scenes to (.)\n"
+		"  --tolerance <n>            largest difference allowed in any channel of a pixel (2)\n"
+		"  --max-differing <n>        pixels a scene may have outside the tolerance (30)\n"
+		"  --update                   render the reference images rather than checking against them\n",
+		program);
+}
+
+static bool ParseOptions(int argc, char* argv[], RegressionOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+
+		if (strcmp(option, "--update") == 0)
+		{
+			options.update = true;
+			continue;
+		}
+
+		//every other option takes a value
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value for %s\n", option);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		if (strcmp(option, "--models") == 0)
+		{
+			options.modelFolder = value;
+		}
+		else if (strcmp(option, "--textures") == 0)
+		{
+			options.textureFolder = value;
+		}
+		else if (strcmp(option, "--references") == 0)
+		{
+			options.referenceFolder = value;
+		}
+		else if (strcmp(option, "--diffs") == 0)
+		{
+			options.diffFolder = value;
+		}
+		else if (strcmp(option, "--tolerance") == 0)
+		{
+			options.tolerance = atoi(value);
+		}
+		else if (strcmp(option, "--max-differing") == 0)
+		{
+			options.maxDifferingPixels = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", option);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//reads the next number from a PPM header, skipping whitespace and comments
+static bool ReadHeaderValue(std::ifstream& file, unsigned int& value)
+{
+	int character = file.get();
+	while (character == '#' || isspace(character))
+	{
+		if (character == '#')
+		{
+			while (character != '\n' && character != EOF)
+			{
+				character = file.get();
+			}
+		}
+		character = file.get();
+	}
+
+	if (!isdigit(character))
+	{
+		return false;
+	}
+
+	value = 0;
+	while (isdigit(character))
+	{
+		value = value * 10 + (character - '0');
+		character = file.get();
+	}
+	return true;
+}
+
+//reads a binary PPM, as written by ImageWriter, into a bitmap
+static bool ReadPPM(const char* filename, Bitmap& bitmap)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file || file.get() != 'P' || file.get() != '6')
+	{
+		return false;
+	}
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int maximum = 0;
+	if (!ReadHeaderValue(file, width) || !ReadHeaderValue(file, height) || !ReadHeaderValue(file, maximum) || maximum != 255)
+	{
+		return false;
+	}
+
+	bitmap.Create(width, height);
+
+	unsigned char rgb[3];
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			if (!file.read(reinterpret_cast<char*>(rgb), 3))
+			{
+				return false;
+			}
+			bitmap.GetPixels()[y * bitmap.GetStride() + x] = Bitmap::ToPixel(rgb[0], rgb[1], rgb[2]);
+		}
+	}
+	return true;
+}
+
+//spins the model about the centre of its bounding box, with the camera set back to fit the bounding sphere in view
+static void RenderScene(const RegressionScene& scene, const RegressionOptions& options, Bitmap& bitmap, bool& loaded)
+{
+	std::string modelFile = std::string(options.modelFolder) + "/" + scene.model;
+	std::string textureFile = scene.texture != nullptr ? std::string(options.textureFolder) + "/" + scene.texture : std::string();
+
+	Rasteriser rasteriser;
+	loaded = rasteriser.LoadModel(modelFile.c_str(), scene.texture != nullptr ? textureFile.c_str() : nullptr);
+	if (!loaded)
+	{
+		return;
+	}
+
+	//filled on the calling thread, so that the scenes do not depend on how many cores there are
+	RenderSettings settings;
+	settings.shadingMode = scene.shadingMode;
+	settings.triangleFill = scene.triangleFill;
+	settings.depthMode = scene.depthMode;
+	settings.transformPipeline = scene.transformPipeline;
+	settings.depthSort = scene.depthSort;
+	settings.threadCount = 1;
+	rasteriser.SetSettings(settings);
+
+	Vector3D minimum;
+	Vector3D maximum;
+	rasteriser.GetModel().GetLocalBounds(minimum, maximum);
+	float centreX = (minimum.GetX() + maximum.GetX()) / 2;
+	float centreY = (minimum.GetY() + maximum.GetY()) / 2;
+	float centreZ = (minimum.GetZ() + maximum.GetZ()) / 2;
+	float halfX = maximum.GetX() - centreX;
+	float halfY = maximum.GetY() - centreY;
+	float halfZ = maximum.GetZ() - centreZ;
+	float radius = sqrt(halfX * halfX + halfY * halfY + halfZ * halfZ);
+
+	Matrix centring = { 1, 0, 0, -centreX,
+						0, 1, 0, -centreY,
+						0, 0, 1, -centreZ,
+						0, 0, 0, 1 };
+
+	rasteriser.SetCamera(Camera(0.0f, 0.0f, 0.0f, Vertex(0, 0, -1.5f * radius, 1)));
+	bitmap.Create(SceneWidth, SceneHeight);
+
+	//a scene of several frames turns the model further each frame, ending at its angle, so that it also covers
+	//anything one frame leaves for the next, such as the order the polygons were sorted into
+	for (unsigned int frame = scene.frames; frame-- > 0;)
+	{
+		float radians = static_cast<float>((scene.angle - frame * FrameStep) * PI / 180);
+		Matrix spin = { cos(radians), 0, sin(radians), 0,
+						0, 1, 0, 0,
+						sin(-radians), 0, cos(radians), 0,
+						0, 0, 0, 1 };
+
+		rasteriser.SetModelTransformation(spin * centring);
+		rasteriser.Update(bitmap);
+		rasteriser.Render(bitmap);
+	}
+}
+
+//counts the pixels that differ by more than the tolerance, drawing them into the diff image
+static unsigned int CompareImages(const Bitmap& image, const Bitmap& reference, int tolerance, Bitmap& diff)
+{
+	unsigned int differingPixels = 0;
+
+	diff.Create(image.GetWidth(), image.GetHeight());
+
+	for (unsigned int y = 0; y < image.GetHeight(); y++)
+	{
+		for (unsigned int x = 0; x < image.GetWidth(); x++)
+		{
+			unsigned int pixel = image.GetPixels()[y * image.GetStride() + x];
+			unsigned int expected = reference.GetPixels()[y * reference.GetStride() + x];
+
+			int difference = 0;
+			for (int shift = 0; shift <= 16; shift += 8)
+			{
+				int channel = static_cast<int>((pixel >> shift) & 0xFF) - static_cast<int>((expected >> shift) & 0xFF);
+				channel = channel < 0 ? -channel : channel;
+				difference = channel > difference ? channel : difference;
+			}
+
+			unsigned int& diffPixel = diff.GetPixels()[y * diff.GetStride() + x];
+			if (difference > tolerance)
+			{
+				differingPixels++;
+				int red = 128 + difference / 2;
+				diffPixel = Bitmap::ToPixel(red, 0, 0);
+			}
+			else
+			{
+				int grey = (((expected >> 16) & 0xFF) + ((expected >> 8) & 0xFF) + (expected & 0xFF)) / 9;
+				diffPixel = Bitmap::ToPixel(grey, grey, grey);
+			}
+		}
+	}
+
+	return differingPixels;
+}
+
+int main(int argc, char* argv[])
+{
+	RegressionOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	ImageWriter writer;
+	unsigned int failures = 0;
+
+	for (unsigned int i = 0; i < SceneCount; i++)
+	{
+		const RegressionScene& scene = scenes[i];
+		std::string referenceFile = std::string(options.referenceFolder) + "/" + scene.name + ".ppm";
+
+		Bitmap image;
+		bool loaded = false;
+		RenderScene(scene, options, image, loaded);
+		if (!loaded)
+		{
+			printf("FAIL %-28s unable to load %s\n", scene.name, scene.model);
+			failures++;
+			continue;
+		}
+
+		if (options.update)
+		{
+			bool written = writer.Write(referenceFile.c_str(), image, ImageFormat::PPM);
+			printf("%s %-28s %s\n", written ? "WROTE" : "FAIL", scene.name, referenceFile.c_str());
+			failures += written ? 0 : 1;
+			continue;
+		}
+
+		Bitmap reference;
+		if (!ReadPPM(referenceFile.c_str(), reference))
+		{
+			printf("FAIL %-28s no reference image %s\n", scene.name, referenceFile.c_str());
+			failures++;
+			continue;
+		}
+
+		if (reference.GetWidth() != image.GetWidth() || reference.GetHeight() != image.GetHeight())
+		{
+			printf("FAIL %-28s reference is %ux%u, rendered %ux%u\n", scene.name, reference.GetWidth(), reference.GetHeight(), image.GetWidth(), image.GetHeight());
+			failures++;
+			continue;
+		}
+
+		Bitmap diff;
+		unsigned int differingPixels = CompareImages(image, reference, options.tolerance, diff);
+		if (differingPixels <= options.maxDifferingPixels)
+		{
+			printf("PASS %-28s %u pixels differ\n", scene.name, differingPixels);
+			continue;
+		}
+
+		//keeps both the diff and what was rendered, to look at next to the reference
+		std::string diffFile = std::string(options.diffFolder) + "/" + scene.name + "_diff.ppm";
+		std::string renderedFile = std::string(options.diffFolder) + "/" + scene.name + "_rendered.ppm";
+		writer.Write(diffFile.c_str(), diff, ImageFormat::PPM);
+		writer.Write(renderedFile.c_str(), image, ImageFormat::PPM);
+
+		printf("FAIL %-28s %u pixels differ, diff written to %s\n", scene.name, differingPixels, diffFile.c_str());
+		failures++;
+	}
+
+	printf("%u of %u scenes %s\n", SceneCount - failures, SceneCount, options.update ? "written" : "passed");
+	return failures == 0 ? 0 : 1;
+}
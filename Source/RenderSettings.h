@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+How hidden surfaces are removed when filling polygons.
+
+PaintersSort sorts the polygons furthest first every frame and draws them over each other.
+ZBuffer interpolates 1/w across each polygon and keeps the nearest value per pixel,
+so no sort is needed and hidden pixels are rejected before they are shaded.
+*/
+
+enum class DepthMode
+{
+	PaintersSort,
+	ZBuffer
+};
+
+/*
+How the painters' sort puts the polygons furthest first.
+
+Comparison sorts the polygons themselves by their average depth. Radix leaves the polygons
+where they are and sorts a compact key and index for each one that survived culling, a few
+counting passes over the bits of the depth, which is stable, so polygons at the same depth
+keep the same order from frame to frame.
+*/
+
+enum class DepthSort
+{
+	Comparison,
+	Radix
+};
+
+/*
+Which routine fills the pixels of each triangle.
+
+Scanline splits the triangle into flat-topped and flat-bottomed halves and walks down the edges.
+HalfSpace evaluates the edge functions of the whole triangle over 8x8 blocks of pixels.
+*/
+
+enum class TriangleFill
+{
+	Scanline,
+	HalfSpace
+};
+
+/*
+How vertices are taken from model space to the screen each frame.
+
+Separate applies the view, projection and viewport matrices one after another to the
+whole vertex list, dividing by w in between. Fused multiplies the matrices together once
+and transforms, divides and maps each vertex to the viewport in a single pass.
+*/
+
+enum class TransformPipeline
+{
+	Separate,
+	Fused
+};
+
+/*
+How the model is drawn each frame.
+
+DemoCycle steps through every transformation and drawing method in turn, labelling each one,
+and moves the model itself. The other modes always draw the model the same way and leave the
+model transformation and camera to whoever is driving the rasteriser, as the command line
+renderer does.
+*/
+
+enum class ShadingMode
+{
+	DemoCycle,
+	Wireframe,
+	Flat,
+	Gouraud,
+	Textured
+};
+
+/*
+Options that select between the different rendering paths, so that they
+can be switched at runtime and compared against each other.
+
+threadCount is the number of threads that fill triangles, with 0 meaning one per hardware
+thread. With more than one thread the triangles are binned into square tiles of tileSize
+pixels and the tiles are filled in parallel, otherwise each triangle is filled as soon as
+it is drawn.
+
+frustumCulling skips every per-vertex and per-polygon stage for a model whose bounds are
+entirely outside the view. The near and far planes are distances in front of the camera,
+with a far plane of 0 for none, as the projection itself has no depth range. Polygons that
+cross the near plane are clipped to it whether or not frustum culling is on.
+
+occlusionCulling skips the instances of a model that would be entirely hidden, once the
+occluderCount nearest of them have been drawn. It needs the depth buffer.
+*/
+
+struct RenderSettings
+{
+	DepthMode depthMode{ DepthMode::ZBuffer };
+	DepthSort depthSort{ DepthSort::Radix };
+	TriangleFill triangleFill{ TriangleFill::HalfSpace };
+	TransformPipeline transformPipeline{ TransformPipeline::Fused };
+	ShadingMode shadingMode{ ShadingMode::DemoCycle };
+	unsigned int threadCount{ 0 };
+	int tileSize{ 64 };
+	bool frustumCulling{ true };
+	float nearPlane{ 1.0f };
+	float farPlane{ 0.0f };
+	bool occlusionCulling{ true };
+	unsigned int occluderCount{ 4 };
+};
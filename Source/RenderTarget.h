@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+Describes the block of 32-bit pixel memory that the fill methods write into directly.
+Pixels are addressed as pixels[y * stride + x] and only those inside the inclusive
+min/max rectangle may be written.
+
+If depth is not null it is a buffer of 1/w values laid out the same way as the pixels,
+and a pixel is only written when it is nearer (has a larger 1/w) than the value stored.
+*/
+
+struct RenderTarget
+{
+	unsigned int *	pixels;
+	float *			depth;
+	unsigned int	stride;
+
+	int				minX;
+	int				minY;
+	int				maxX;
+	int				maxY;
+};
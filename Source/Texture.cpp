@@ -1,41 +1,24 @@
 #include "Texture.h"
+#include "Vertex.h"
+#include "Bitmap.h"
+#include <cmath>
 
 Texture::Texture()
 {
 	_width = 0;
 	_height = 0;
-	_paletteIndices = nullptr;
-	_palette = nullptr;
 }
 
 Texture::~Texture()
 {
-	if (_paletteIndices != nullptr)
-	{
-		delete[] _paletteIndices;
-		_paletteIndices = nullptr;
-	}
-	if (_palette != nullptr)
-	{
-		delete[] _palette;
-		_palette = nullptr;
-	}
 }
 
 void Texture::SetTextureSize(int width, int height)
 {
 	_width = width;
 	_height = height;
-	if (_paletteIndices != nullptr)
-	{
-		delete[] _paletteIndices;
-	}
-	_paletteIndices = new BYTE[_width * _height];
-	if (_palette != nullptr)
-	{
-		delete[] _palette;
-	}
-	_palette = new COLORREF[256];
+	_paletteIndices.assign(_width * _height, 0);
+	_palette.assign(256, 0);
 }
 
 COLORREF Texture::GetTextureValue(int u, int v) const
@@ -56,17 +39,17 @@ COLORREF Texture::GetTextureValue(int u, int v) const
 	{
 		u = _width - 1;
 	}
-	return _palette[_paletteIndices[v * _width + u]];
+	return _texels[v * _width + u];
 }
 
 BYTE * Texture::GetPaletteIndices()
 {
-	return _paletteIndices;
+	return _paletteIndices.data();
 }
 
 COLORREF * Texture::GetPalette()
 {
-	return _palette;
+	return _palette.data();
 }
 
 int Texture::GetWidth() const
@@ -78,3 +61,154 @@ int Texture::GetHeight() const
 {
 	return _height;
 }
+
+//looks up the palette colour of every texel
+void Texture::ResolvePalette()
+{
+	_texels.resize(_width * _height);
+	for (int i = 0; i < _width * _height; i++)
+	{
+		_texels[i] = _palette[_paletteIndices[i]];
+	}
+	BuildMipmaps();
+}
+
+//takes texels that have already been resolved, such as those from the mesh cache, without any palette
+void Texture::SetTexels(int width, int height, const COLORREF* texels)
+{
+	_width = width;
+	_height = height;
+	_texels.assign(texels, texels + width * height);
+	BuildMipmaps();
+}
+
+//returns nullptr until the texture has loaded
+const COLORREF* Texture::GetTexels() const
+{
+	return _texels.empty() ? nullptr : _texels.data();
+}
+
+int Texture::GetLevelCount() const
+{
+	return static_cast<int>(_levels.size());
+}
+
+const TextureLevel& Texture::GetLevel(int level) const
+{
+	return _levels[level];
+}
+
+int Texture::SelectMipLevel(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3) const
+{
+	//the areas of the triangle in first level texels and in pixels, found from the texture coordinates after the
+	//perspective divide, so the ratio is that of the triangle as a whole
+	float u1 = vertex1.GetUOZ() / vertex1.GetZR();
+	float v1 = vertex1.GetVOZ() / vertex1.GetZR();
+	float u2 = vertex2.GetUOZ() / vertex2.GetZR();
+	float v2 = vertex2.GetVOZ() / vertex2.GetZR();
+	float u3 = vertex3.GetUOZ() / vertex3.GetZR();
+	float v3 = vertex3.GetVOZ() / vertex3.GetZR();
+
+	float texelArea = fabs((u2 - u1) * (v3 - v1) - (u3 - u1) * (v2 - v1));
+	float pixelArea = fabs((vertex2.GetX() - vertex1.GetX()) * (vertex3.GetY() - vertex1.GetY()) - (vertex3.GetX() - vertex1.GetX()) * (vertex2.GetY() - vertex1.GetY()));
+
+	//each level has a quarter of the texels of the one before, and the next is taken once it is nearer to one
+	//texel per pixel, which is past twice the texels per pixel of this one
+	int level = 0;
+	float threshold = 2.0f * pixelArea;
+	while (level + 1 < static_cast<int>(_levels.size()) && texelArea > threshold)
+	{
+		threshold *= 4.0f;
+		level++;
+	}
+	return level;
+}
+
+//converts the texels into the bitmap's layout, then averages each 2x2 block into the next level until one texel is
+//left. A block that runs off the right or bottom edge of an odd sized level repeats the texels on it
+void Texture::BuildMipmaps()
+{
+	_levels.clear();
+	_levelTexels.clear();
+	if (_width <= 0 || _height <= 0)
+	{
+		return;
+	}
+
+	std::vector<size_t> offsets;
+	int levelWidth = _width;
+	int levelHeight = _height;
+	size_t texelCount = 0;
+	while (true)
+	{
+		TextureLevel level;
+		level.texels = nullptr;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.widthShift = -1;
+		level.uScale = (float)levelWidth / _width;
+		level.vScale = (float)levelHeight / _height;
+		if ((levelWidth & (levelWidth - 1)) == 0 && (levelHeight & (levelHeight - 1)) == 0)
+		{
+			level.widthShift = 0;
+			while ((1 << level.widthShift) < levelWidth)
+			{
+				level.widthShift++;
+			}
+		}
+		_levels.push_back(level);
+		offsets.push_back(texelCount);
+		texelCount += static_cast<size_t>(levelWidth) * levelHeight;
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	_levelTexels.resize(texelCount);
+	for (size_t i = 0; i < _levels.size(); i++)
+	{
+		_levels[i].texels = &_levelTexels[offsets[i]];
+	}
+
+	for (int i = 0; i < _width * _height; i++)
+	{
+		_levelTexels[i] = Bitmap::ToPixel(_texels[i]);
+	}
+
+	for (size_t i = 1; i < _levels.size(); i++)
+	{
+		const TextureLevel& source = _levels[i - 1];
+		const TextureLevel& destination = _levels[i];
+		unsigned int* texels = &_levelTexels[offsets[i]];
+
+		for (int y = 0; y < destination.height; y++)
+		{
+			const unsigned int* row0 = source.texels + (y * 2) * source.width;
+			const unsigned int* row1 = y * 2 + 1 < source.height ? row0 + source.width : row0;
+
+			for (int x = 0; x < destination.width; x++)
+			{
+				int x0 = x * 2;
+				int x1 = x0 + 1 < source.width ? x0 + 1 : x0;
+				unsigned int block[4] = { row0[x0], row0[x1], row1[x0], row1[x1] };
+
+				//each channel is averaged on its own, rounding to nearest
+				unsigned int texel = 0;
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					unsigned int sum = 2;
+					for (int j = 0; j < 4; j++)
+					{
+						sum += (block[j] >> shift) & 0xFF;
+					}
+					texel |= (sum / 4) << shift;
+				}
+				texels[y * destination.width + x] = texel;
+			}
+		}
+	}
+}
@@ -1,11 +1,39 @@
 #pragma once
-#include "windows.h"
+#include <vector>
+#include "Platform.h"
+
+class Vertex;
+
+/*
+One level of a texture's mip chain, holding 32 bit texels already in the layout of the bitmap's
+pixels. When both sides are powers of two, widthShift is the shift that finds the start of a row,
+so that a texel can be found with shifts and masks rather than a multiply and clamps; otherwise
+it is -1. Texture coordinates for the first level are scaled by uScale and vScale for this one
+*/
+
+struct TextureLevel
+{
+	const unsigned int * texels;
+	int		width;
+	int		height;
+	int		widthShift;
+	float	uScale;
+	float	vScale;
+};
+
+/*
+A texture loaded as 256 colour palette indices, which is resolved into a colour per texel
+once loading is complete so that a lookup is a single read. The mip chain is built from those
+colours at the same time, each level averaging 2x2 blocks of the one before down to a single texel
+*/
 
 class Texture
 {
 public:
 	Texture();
 	~Texture();
+	Texture(Texture&&) = default;
+	Texture& operator=(Texture&&) = default;
 
 	void		SetTextureSize(int width, int height);
 	COLORREF	GetTextureValue(int u, int v) const;
@@ -14,9 +42,29 @@ public:
 	int			GetWidth() const;
 	int			GetHeight() const;
 
+	void		ResolvePalette();
+	void		SetTexels(int width, int height, const COLORREF* texels);
+	const COLORREF* GetTexels() const;
+
+	/*
+	Accessors for the mip chain, which is empty until the texture has loaded. SelectMipLevel picks
+	the level for a triangle from how many texels of the first level it covers for each pixel on
+	the screen, taking the level nearest to one texel per pixel
+	*/
+
+	int			GetLevelCount() const;
+	const TextureLevel& GetLevel(int level) const;
+	int			SelectMipLevel(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3) const;
+
 private:
-	BYTE	 * _paletteIndices;
-	COLORREF * _palette;
+	void		BuildMipmaps();
+
+	std::vector<BYTE>	  _paletteIndices;
+	std::vector<COLORREF> _palette;
 	int		   _width;
 	int		   _height;
+
+	std::vector<COLORREF> _texels;
+	std::vector<unsigned int> _levelTexels;
+	std::vector<TextureLevel> _levels;
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool()
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	StopWorkers();
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return static_cast<unsigned int>(_workers.size()) + 1;
+}
+
+// Replaces the workers with a new set. A count of 0 or 1 leaves only the calling thread.
+
+void ThreadPool::SetThreadCount(unsigned int threadCount)
+{
+	if (threadCount == GetThreadCount())
+	{
+		return;
+	}
+	StopWorkers();
+	if (threadCount > 1)
+	{
+		StartWorkers(threadCount - 1);
+	}
+}
+
+void ThreadPool::Run(unsigned int taskCount, const std::function<void(unsigned int)>& task)
+{
+	if (taskCount == 0)
+	{
+		return;
+	}
+
+	// Publish the batch and wake the workers
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_task = &task;
+		_taskCount = taskCount;
+		_nextTask = 0;
+		_busyWorkers = static_cast<unsigned int>(_workers.size());
+		_batch++;
+	}
+	_startCondition.notify_all();
+
+	// Work on the batch from this thread too
+	RunTasks();
+
+	// Wait until every worker has run out of tasks
+	std::unique_lock<std::mutex> lock(_mutex);
+	_doneCondition.wait(lock, [this] { return _busyWorkers == 0; });
+	_task = nullptr;
+}
+
+void ThreadPool::StartWorkers(unsigned int workerCount)
+{
+	_stopping = false;
+
+	//the workers are told the current batch up front, so one that starts late cannot mistake a batch published in the meantime for an old one
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, _batch));
+	}
+}
+
+void ThreadPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_startCondition.notify_all();
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		_workers[i].join();
+	}
+	_workers.clear();
+}
+
+// Each worker sleeps until a new batch is published, helps run it, then reports that it is done
+
+void ThreadPool::WorkerLoop(unsigned int lastBatch)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_startCondition.wait(lock, [this, lastBatch] { return _stopping || _batch != lastBatch; });
+			if (_stopping)
+			{
+				return;
+			}
+			lastBatch = _batch;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_busyWorkers--;
+		}
+		_doneCondition.notify_one();
+	}
+}
+
+// Takes the next task number until there are none left
+
+void ThreadPool::RunTasks()
+{
+	while (true)
+	{
+		unsigned int taskIndex = _nextTask++;
+		if (taskIndex >= _taskCount)
+		{
+			return;
+		}
+		(*_task)(taskIndex);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*
+A fixed set of worker threads that share out a batch of numbered tasks between them.
+The thread calling Run also works on the batch, and Run only returns once every task
+has finished. Tasks are handed out one at a time so that slow tasks do not hold up
+the others.
+*/
+
+class ThreadPool
+{
+public:
+	ThreadPool();
+	~ThreadPool();
+
+	/*
+	Accesses / mutates the total number of threads working on each batch, including the calling thread
+	*/
+
+	unsigned int GetThreadCount() const;
+	void SetThreadCount(unsigned int threadCount);
+
+	/*
+	Calls task(0) to task(taskCount - 1) spread over the threads, waiting for them all to finish
+	*/
+
+	void Run(unsigned int taskCount, const std::function<void(unsigned int)>& task);
+
+private:
+
+	void StartWorkers(unsigned int workerCount);
+	void StopWorkers();
+	void WorkerLoop(unsigned int lastBatch);
+	void RunTasks();
+
+	/*
+	Members to hold the worker threads and the state of the batch they are working on
+	*/
+
+	std::vector<std::thread> _workers;
+
+	std::mutex _mutex;
+	std::condition_variable _startCondition;
+	std::condition_variable _doneCondition;
+
+	const std::function<void(unsigned int)> * _task{ nullptr };
+	unsigned int _taskCount{ 0 };
+	std::atomic<unsigned int> _nextTask{ 0 };
+	unsigned int _busyWorkers{ 0 };
+	unsigned int _batch{ 0 };
+	bool _stopping{ false };
+};
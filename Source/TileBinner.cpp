@@ -0,0 +1,139 @@
+#include "TileBinner.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+TileBinner::TileBinner()
+{
+	_target = RenderTarget{ nullptr, nullptr, 0, 0, 0, -1, -1 };
+	_tileSize = 64;
+	_tileColumns = 0;
+	_tileRows = 0;
+}
+
+void TileBinner::Begin(const RenderTarget& target, int tileSize)
+{
+	_target = target;
+	_tileSize = tileSize > 8 ? tileSize : 8;
+
+	int width = target.maxX - target.minX + 1;
+	int height = target.maxY - target.minY + 1;
+	_tileColumns = width > 0 ? (width + _tileSize - 1) / _tileSize : 0;
+	_tileRows = height > 0 ? (height + _tileSize - 1) / _tileSize : 0;
+
+	//clear rather than reallocate, so the bins keep their capacity from the last frame
+	_triangles.clear();
+	_bins.resize(_tileColumns * _tileRows);
+	for (size_t i = 0; i < _bins.size(); i++)
+	{
+		_bins[i].clear();
+	}
+
+	//the timings run on over the batches of a frame, and only start again when the layout changes
+	if (_tileTimings.size() != _bins.size())
+	{
+		_tileTimings.assign(_bins.size(), 0.0f);
+	}
+}
+
+void TileBinner::ResetTimings()
+{
+	std::fill(_tileTimings.begin(), _tileTimings.end(), 0.0f);
+}
+
+void TileBinner::AddTriangle(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& colour, TriangleShading shading)
+{
+	//find the bounding box, padded by a pixel as the scanline fill rounds its edges to whole pixels
+	float minX = fminf(vertex1.GetX(), fminf(vertex2.GetX(), vertex3.GetX())) - 1.0f;
+	float maxX = fmaxf(vertex1.GetX(), fmaxf(vertex2.GetX(), vertex3.GetX())) + 1.0f;
+	float minY = fminf(vertex1.GetY(), fminf(vertex2.GetY(), vertex3.GetY())) - 1.0f;
+	float maxY = fmaxf(vertex1.GetY(), fmaxf(vertex2.GetY(), vertex3.GetY())) + 1.0f;
+
+	//written so that a box containing NaN is also thrown away
+	if (!(maxX >= (float)_target.minX && minX <= (float)_target.maxX && maxY >= (float)_target.minY && minY <= (float)_target.maxY))
+	{
+		return;
+	}
+
+	//clamp to the render target before converting, so huge coordinates cannot overflow
+	int firstColumn = minX > (float)_target.minX ? ((int)minX - _target.minX) / _tileSize : 0;
+	int lastColumn = maxX < (float)_target.maxX ? ((int)maxX - _target.minX) / _tileSize : _tileColumns - 1;
+	int firstRow = minY > (float)_target.minY ? ((int)minY - _target.minY) / _tileSize : 0;
+	int lastRow = maxY < (float)_target.maxY ? ((int)maxY - _target.minY) / _tileSize : _tileRows - 1;
+
+	unsigned int triangleIndex = (unsigned int)_triangles.size();
+	_triangles.push_back(BinnedTriangle{ { vertex1, vertex2, vertex3 }, colour, shading });
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int column = firstColumn; column <= lastColumn; column++)
+		{
+			_bins[row * _tileColumns + column].push_back(triangleIndex);
+		}
+	}
+}
+
+void TileBinner::Rasterise(ThreadPool& threadPool, const std::function<void(const RenderTarget&, const BinnedTriangle&)>& fill)
+{
+	//only hand out the tiles that have something to draw
+	_occupiedTiles.clear();
+	for (int i = 0; i < (int)_bins.size(); i++)
+	{
+		if (!_bins[i].empty())
+		{
+			_occupiedTiles.push_back(i);
+		}
+	}
+
+	threadPool.Run((unsigned int)_occupiedTiles.size(), [this, &fill](unsigned int task)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		int tileIndex = _occupiedTiles[task];
+		RenderTarget tileTarget = GetTileTarget(tileIndex);
+		const std::vector<unsigned int>& bin = _bins[tileIndex];
+
+		for (size_t i = 0; i < bin.size(); i++)
+		{
+			fill(tileTarget, _triangles[bin[i]]);
+		}
+
+		//each tile is only ever timed by the one thread that filled it
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		_tileTimings[tileIndex] += elapsed.count();
+	});
+}
+
+int TileBinner::GetTileSize() const
+{
+	return _tileSize;
+}
+
+int TileBinner::GetTileColumns() const
+{
+	return _tileColumns;
+}
+
+int TileBinner::GetTileRows() const
+{
+	return _tileRows;
+}
+
+const std::vector<float>& TileBinner::GetTileTimings() const
+{
+	return _tileTimings;
+}
+
+//the render target shares the pixel and depth memory, but only allows writes within the tile
+
+RenderTarget TileBinner::GetTileTarget(int tileIndex) const
+{
+	RenderTarget tileTarget = _target;
+
+	tileTarget.minX = _target.minX + (tileIndex % _tileColumns) * _tileSize;
+	tileTarget.minY = _target.minY + (tileIndex / _tileColumns) * _tileSize;
+	tileTarget.maxX = tileTarget.minX + _tileSize - 1 < _target.maxX ? tileTarget.minX + _tileSize - 1 : _target.maxX;
+	tileTarget.maxY = tileTarget.minY + _tileSize - 1 < _target.maxY ? tileTarget.minY + _tileSize - 1 : _target.maxY;
+
+	return tileTarget;
+}
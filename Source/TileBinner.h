@@ -0,0 +1,98 @@
+#pragma once
+#include "Vertex.h"
+#include "RenderTarget.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <functional>
+
+/*
+Which fill method a binned triangle is drawn with
+*/
+
+enum class TriangleShading
+{
+	Flat,
+	Gouraud,
+	Textured
+};
+
+/*
+A screen-space triangle waiting to be filled, holding its own copy of the vertices
+so that every tile it touches can sort and split them independently
+*/
+
+struct BinnedTriangle
+{
+	Vertex			vertices[3];
+	COLORREF		colour;
+	TriangleShading	shading;
+};
+
+/*
+Splits the render target into square tiles and records which triangles overlap each one.
+Once every triangle for the frame has been added, the tiles are shared out over a thread
+pool and each is filled through a render target clipped to that tile. Tiles never overlap,
+so no two threads ever write the same pixel or depth value and no locking is needed.
+Within a tile the triangles are filled in the order they were added, so the painters'
+sort still works.
+
+How long each tile took to fill is added up over every batch filled in a frame, so that
+the load across the screen can be inspected.
+*/
+
+class TileBinner
+{
+public:
+	TileBinner();
+
+	/*
+	Empties the bins ready for a new set of triangles over the given render target
+	*/
+
+	void Begin(const RenderTarget& target, int tileSize);
+
+	/*
+	Zeroes the tile timings, once at the start of each frame rather than for each batch
+	*/
+
+	void ResetTimings();
+
+	/*
+	Adds a triangle to the bin of every tile its bounding box overlaps
+	*/
+
+	void AddTriangle(const Vertex& vertex1, const Vertex& vertex2, const Vertex& vertex3, const COLORREF& colour, TriangleShading shading);
+
+	/*
+	Fills every tile that has triangles in it, calling fill once per triangle per tile
+	*/
+
+	void Rasterise(ThreadPool& threadPool, const std::function<void(const RenderTarget&, const BinnedTriangle&)>& fill);
+
+	/*
+	Accessors to get the tile layout and the time in milliseconds each tile took to fill in the frame, row by row
+	*/
+
+	int GetTileSize() const;
+	int GetTileColumns() const;
+	int GetTileRows() const;
+	const std::vector<float>& GetTileTimings() const;
+
+private:
+
+	RenderTarget GetTileTarget(int tileIndex) const;
+
+	/*
+	Members to hold the tile layout, the triangles and the bins, which keep their memory between frames
+	*/
+
+	RenderTarget _target;
+	int _tileSize;
+	int _tileColumns;
+	int _tileRows;
+
+	std::vector<BinnedTriangle> _triangles;
+	std::vector<std::vector<unsigned int>> _bins;
+	std::vector<int> _occupiedTiles;
+	std::vector<float> _tileTimings;
+};
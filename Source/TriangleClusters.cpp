@@ -0,0 +1,344 @@
+#include "TriangleClusters.h"
+#include <cmath>
+
+const int TriangleClusters::MaxPolygons;
+
+//how closely a polygon must face the same way as the seed of a cluster to join it, the cosine of 60 degrees
+static const float MinimumAlignment = 0.5f;
+
+static const unsigned int Unassigned = 0xFFFFFFFF;
+
+//normals shorter than this, against the lengths of the edges they come from, belong to polygons with no real area,
+//whose direction is only rounding error
+static const float DegenerateNormal = 1e-5f;
+
+//the edges of a polygon, as the back-face test takes them
+static void CalculateEdges(const Polygon3D& polygon, const VertexStream& positions, float a[3], float b[3])
+{
+	const float* x = positions.GetX();
+	const float* y = positions.GetY();
+	const float* z = positions.GetZ();
+
+	int i0 = polygon.GetIndex(0);
+	int i1 = polygon.GetIndex(1);
+	int i2 = polygon.GetIndex(2);
+
+	a[0] = x[i0] - x[i1];
+	a[1] = y[i0] - y[i1];
+	a[2] = z[i0] - z[i1];
+	b[0] = x[i0] - x[i2];
+	b[1] = y[i0] - y[i2];
+	b[2] = z[i0] - z[i2];
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float Length(const float v[3])
+{
+	return sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+//scales a normal to unit length, or to zero when it is too short against the given scale to have a direction
+static void Normalise(float normal[3], float scale)
+{
+	float length = Length(normal);
+	bool degenerate = length <= DegenerateNormal * scale || length == 0;
+	for (int i = 0; i < 3; i++)
+	{
+		normal[i] = degenerate ? 0 : normal[i] / length;
+	}
+}
+
+//the unit normal of a polygon, wound as the back-face test expects, or zero when the polygon has no area
+static void CalculateNormal(const Polygon3D& polygon, const VertexStream& positions, float normal[3])
+{
+	float a[3], b[3];
+	CalculateEdges(polygon, positions, a, b);
+	Cross(a, b, normal);
+	Normalise(normal, Length(a) * Length(b));
+}
+
+TriangleClusters::TriangleClusters()
+{
+	_clusterCount = 0;
+}
+
+void TriangleClusters::Clear()
+{
+	_polygonClusters.clear();
+	_bounds.clear();
+	_clusterCount = 0;
+}
+
+void TriangleClusters::Build(const std::vector<Polygon3D>& polygons, const VertexStream& positions)
+{
+	Clear();
+
+	std::vector<float> normals(polygons.size() * 3);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		CalculateNormal(polygons[i], positions, &normals[i * 3]);
+	}
+
+	//lists the polygons around each vertex, counting them first so that one array holds every list
+	std::vector<unsigned int> vertexStarts(positions.GetCount() + 1, 0);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			vertexStarts[polygons[i].GetIndex(j) + 1]++;
+		}
+	}
+	for (size_t i = 1; i < vertexStarts.size(); i++)
+	{
+		vertexStarts[i] += vertexStarts[i - 1];
+	}
+
+	std::vector<unsigned int> vertexPolygons(polygons.size() * 3);
+	std::vector<unsigned int> vertexFill(vertexStarts.begin(), vertexStarts.end() - 1);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			vertexPolygons[vertexFill[polygons[i].GetIndex(j)]++] = static_cast<unsigned int>(i);
+		}
+	}
+
+	//grows each cluster outwards from the first polygon not yet in one, breadth first, so that clusters stay compact
+	_polygonClusters.assign(polygons.size(), Unassigned);
+	std::vector<unsigned int> queue;
+	queue.reserve(MaxPolygons);
+
+	for (size_t seed = 0; seed < polygons.size(); seed++)
+	{
+		if (_polygonClusters[seed] != Unassigned)
+		{
+			continue;
+		}
+
+		unsigned int cluster = static_cast<unsigned int>(_clusterCount++);
+		const float* seedNormal = &normals[seed * 3];
+
+		queue.clear();
+		queue.push_back(static_cast<unsigned int>(seed));
+		_polygonClusters[seed] = cluster;
+
+		for (size_t next = 0; next < queue.size() && queue.size() < MaxPolygons; next++)
+		{
+			const Polygon3D& polygon = polygons[queue[next]];
+			for (int j = 0; j < 3 && queue.size() < MaxPolygons; j++)
+			{
+				int vertex = polygon.GetIndex(j);
+				for (unsigned int k = vertexStarts[vertex]; k < vertexStarts[vertex + 1] && queue.size() < MaxPolygons; k++)
+				{
+					unsigned int neighbour = vertexPolygons[k];
+					if (_polygonClusters[neighbour] != Unassigned)
+					{
+						continue;
+					}
+
+					//polygons with no area face nowhere, so they can join any cluster without widening its cone
+					const float* normal = &normals[neighbour * 3];
+					float alignment = normal[0] * seedNormal[0] + normal[1] * seedNormal[1] + normal[2] * seedNormal[2];
+					bool degenerate = normal[0] == 0 && normal[1] == 0 && normal[2] == 0;
+					if (alignment >= MinimumAlignment || degenerate)
+					{
+						_polygonClusters[neighbour] = cluster;
+						queue.push_back(neighbour);
+					}
+				}
+			}
+		}
+	}
+
+	AddPose(polygons, positions);
+}
+
+void TriangleClusters::AddPose(const std::vector<Polygon3D>& polygons, const VertexStream& positions)
+{
+	AddBounds(polygons, positions, nullptr);
+}
+
+void TriangleClusters::AddBlendPose(const std::vector<Polygon3D>& polygons, const VertexStream& positionsA, const VertexStream& positionsB)
+{
+	AddBounds(polygons, positionsA, &positionsB);
+}
+
+//a blended polygon has the edges a + t(b - a) of the two poses, so its normal is a quadratic in t whose Bezier
+//control points are the normal of each pose and the average of the two mixed cross products of their edges.
+//the weights of the control points are never negative, so a cone around all three holds the normal at every t
+void TriangleClusters::AddBounds(const std::vector<Polygon3D>& polygons, const VertexStream& positionsA, const VertexStream* positionsB)
+{
+	const VertexStream* poses[2] = { &positionsA, positionsB };
+	int poseCount = positionsB != nullptr ? 2 : 1;
+	int normalCount = positionsB != nullptr ? 3 : 1;
+
+	std::vector<float> normals(polygons.size() * normalCount * 3);
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		float* normal = &normals[i * normalCount * 3];
+		if (positionsB == nullptr)
+		{
+			CalculateNormal(polygons[i], positionsA, normal);
+			continue;
+		}
+
+		float a1[3], b1[3], a2[3], b2[3];
+		CalculateEdges(polygons[i], positionsA, a1, b1);
+		CalculateEdges(polygons[i], *positionsB, a2, b2);
+
+		float mixedA[3], mixedB[3];
+		Cross(a1, b1, normal);
+		Cross(a2, b2, normal + 3);
+		Cross(a1, b2, mixedA);
+		Cross(a2, b1, mixedB);
+		for (int k = 0; k < 3; k++)
+		{
+			normal[6 + k] = (mixedA[k] + mixedB[k]) / 2;
+		}
+
+		//each is measured against the longest edges of either pose, so that a polygon that only has area in one pose keeps its direction there
+		float lengthA = Length(a1) > Length(a2) ? Length(a1) : Length(a2);
+		float lengthB = Length(b1) > Length(b2) ? Length(b1) : Length(b2);
+		for (int j = 0; j < 3; j++)
+		{
+			Normalise(normal + j * 3, lengthA * lengthB);
+		}
+	}
+
+	//the centre is the middle of the box around the cluster's vertices, and the axis the average of its normals
+	std::vector<float> minimums(_clusterCount * 3, INFINITY);
+	std::vector<float> maximums(_clusterCount * 3, -INFINITY);
+	std::vector<float> axes(_clusterCount * 3, 0.0f);
+
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		unsigned int cluster = _polygonClusters[i];
+		for (int pose = 0; pose < poseCount; pose++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				int vertex = polygons[i].GetIndex(j);
+				float position[3] = { poses[pose]->GetX()[vertex], poses[pose]->GetY()[vertex], poses[pose]->GetZ()[vertex] };
+				for (int k = 0; k < 3; k++)
+				{
+					minimums[cluster * 3 + k] = position[k] < minimums[cluster * 3 + k] ? position[k] : minimums[cluster * 3 + k];
+					maximums[cluster * 3 + k] = position[k] > maximums[cluster * 3 + k] ? position[k] : maximums[cluster * 3 + k];
+				}
+			}
+		}
+		for (int j = 0; j < normalCount; j++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				axes[cluster * 3 + k] += normals[(i * normalCount + j) * 3 + k];
+			}
+		}
+	}
+
+	size_t first = _bounds.size();
+	_bounds.resize(first + _clusterCount);
+	ClusterBounds* bounds = &_bounds[first];
+
+	for (size_t cluster = 0; cluster < _clusterCount; cluster++)
+	{
+		float* axis = &axes[cluster * 3];
+		float length = Length(axis);
+		for (int k = 0; k < 3; k++)
+		{
+			bounds[cluster].centre[k] = (minimums[cluster * 3 + k] + maximums[cluster * 3 + k]) / 2;
+			bounds[cluster].axis[k] = length > 0 ? axis[k] / length : 0;
+		}
+		bounds[cluster].radius = 0;
+
+		//the cone starts as narrow as it can be and widens to take in each normal
+		bounds[cluster].cosAngle = length > 0 ? 1.0f : 0.0f;
+	}
+
+	//the radius reaches the furthest vertex in either pose, which holds every blend of the two, and the cone the normal furthest from the axis
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		ClusterBounds& cluster = bounds[_polygonClusters[i]];
+		for (int pose = 0; pose < poseCount; pose++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				int vertex = polygons[i].GetIndex(j);
+				float offset[3] = { poses[pose]->GetX()[vertex] - cluster.centre[0], poses[pose]->GetY()[vertex] - cluster.centre[1], poses[pose]->GetZ()[vertex] - cluster.centre[2] };
+				float distance = Length(offset);
+				cluster.radius = distance > cluster.radius ? distance : cluster.radius;
+			}
+		}
+
+		for (int j = 0; j < normalCount; j++)
+		{
+			const float* normal = &normals[(i * normalCount + j) * 3];
+			if (normal[0] == 0 && normal[1] == 0 && normal[2] == 0)
+			{
+				continue;
+			}
+			float alignment = normal[0] * cluster.axis[0] + normal[1] * cluster.axis[1] + normal[2] * cluster.axis[2];
+			cluster.cosAngle = alignment < cluster.cosAngle ? alignment : cluster.cosAngle;
+		}
+	}
+
+	for (size_t cluster = 0; cluster < _clusterCount; cluster++)
+	{
+		bounds[cluster].cosAngle = bounds[cluster].cosAngle > 0 ? bounds[cluster].cosAngle : 0;
+		bounds[cluster].sinAngle = sqrt(1 - bounds[cluster].cosAngle * bounds[cluster].cosAngle);
+	}
+}
+
+size_t TriangleClusters::GetClusterCount() const
+{
+	return _clusterCount;
+}
+
+size_t TriangleClusters::GetPoseCount() const
+{
+	return _clusterCount > 0 ? _bounds.size() / _clusterCount : 0;
+}
+
+const std::vector<unsigned int>& TriangleClusters::GetPolygonClusters() const
+{
+	return _polygonClusters;
+}
+
+const TriangleClusters::ClusterBounds* TriangleClusters::GetBounds(size_t pose) const
+{
+	return _bounds.data() + pose * _clusterCount;
+}
+
+void TriangleClusters::SetClusters(const unsigned int* polygonClusters, size_t polygonCount, size_t clusterCount, const ClusterBounds* bounds, size_t poseCount)
+{
+	_polygonClusters.assign(polygonClusters, polygonClusters + polygonCount);
+	_bounds.assign(bounds, bounds + clusterCount * poseCount);
+	_clusterCount = clusterCount;
+}
+
+//the nearest any polygon in the cluster can face towards the camera is when its normal is tilted from the axis
+//as far as the cone allows, towards the camera, and it sits at the edge of the sphere nearest the camera.
+//with the angle between the axis and the direction to the centre, the cluster faces away when the distance
+//from the camera to the centre, projected on that tilted normal, is more than the radius
+bool TriangleClusters::IsBackFacing(const ClusterBounds& bounds, float cameraX, float cameraY, float cameraZ)
+{
+	if (bounds.cosAngle <= 0)
+	{
+		return false;
+	}
+
+	float dx = bounds.centre[0] - cameraX;
+	float dy = bounds.centre[1] - cameraY;
+	float dz = bounds.centre[2] - cameraZ;
+
+	float along = dx * bounds.axis[0] + dy * bounds.axis[1] + dz * bounds.axis[2];
+	float acrossSquared = dx * dx + dy * dy + dz * dz - along * along;
+	float across = acrossSquared > 0 ? sqrt(acrossSquared) : 0;
+
+	return along * bounds.cosAngle - across * bounds.sinAngle > bounds.radius;
+}
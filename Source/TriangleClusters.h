@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include "Polygon3D.h"
+#include "VertexStream.h"
+
+/*
+Splits a mesh into clusters of up to MaxPolygons neighbouring polygons that face roughly the
+same way, so that back-face culling can reject a whole cluster with one test before any of
+its polygons are looked at.
+
+Each cluster is bounded by a sphere around its vertices and a cone around its polygon normals.
+When the camera is behind every plane the cone allows at every point in the sphere, every
+polygon in the cluster faces away, and the test is exact rather than an estimate. Clusters are
+grown from a seed polygon through polygons that share a vertex with it, taking those whose
+normal is within about 60 degrees of the seed's, so that the cones stay narrow enough to cull.
+
+The clusters are found once when the model loads, from its first pose, and keep the same
+polygons in every pose. Their bounds are worked out for each pose: the static mesh, or each
+keyframe of an animated one. As the vertices are blended in straight lines between keyframes,
+the bounds of a blend pose hold every pose between two keyframes, so culling stays exact
+while the model animates. Polygons too thin to have a direction can be rejected along with
+their cluster, as they cover no pixels.
+*/
+
+class TriangleClusters
+{
+public:
+	static const int MaxPolygons = 64;
+
+	/*
+	The sphere around the vertices of a cluster, and the cone around its polygon normals as
+	its axis and the cosine and sine of its half angle. A cluster whose normals spread over
+	90 degrees or more can never face away as a whole, and has a cosine of 0
+	*/
+
+	struct ClusterBounds
+	{
+		float centre[3];
+		float radius;
+		float axis[3];
+		float cosAngle;
+		float sinAngle;
+	};
+
+	TriangleClusters();
+
+	/*
+	Forgets the clusters, leaving nothing to cull with
+	*/
+
+	void Clear();
+
+	/*
+	Groups the polygons into clusters using the positions of the first pose, and works out the bounds of that pose
+	*/
+
+	void Build(const std::vector<Polygon3D>& polygons, const VertexStream& positions);
+
+	/*
+	Works out the bounds of every cluster for another pose of the same mesh, which becomes the next pose, or
+	bounds that hold every blend between two poses of it, for culling while the mesh is partway between them
+	*/
+
+	void AddPose(const std::vector<Polygon3D>& polygons, const VertexStream& positions);
+	void AddBlendPose(const std::vector<Polygon3D>& polygons, const VertexStream& positionsA, const VertexStream& positionsB);
+
+	/*
+	Accesses the number of clusters and poses, the cluster each polygon belongs to and the bounds of the clusters in a pose
+	*/
+
+	size_t GetClusterCount() const;
+	size_t GetPoseCount() const;
+	const std::vector<unsigned int>& GetPolygonClusters() const;
+	const ClusterBounds* GetBounds(size_t pose) const;
+
+	/*
+	Replaces the clusters and the bounds of every pose with ones worked out before, such as those read from the mesh cache
+	*/
+
+	void SetClusters(const unsigned int* polygonClusters, size_t polygonCount, size_t clusterCount, const ClusterBounds* bounds, size_t poseCount);
+
+	/*
+	Checks whether every polygon a cluster could hold faces away from the camera, given in the same space as the bounds
+	*/
+
+	static bool IsBackFacing(const ClusterBounds& bounds, float cameraX, float cameraY, float cameraZ);
+
+private:
+
+	void AddBounds(const std::vector<Polygon3D>& polygons, const VertexStream& positionsA, const VertexStream* positionsB);
+
+	/*
+	The cluster of each polygon, and the bounds of every cluster one pose after another
+	*/
+
+	std::vector<unsigned int> _polygonClusters;
+	std::vector<ClusterBounds> _bounds;
+	size_t _clusterCount;
+};
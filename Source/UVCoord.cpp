@@ -25,6 +25,11 @@ int UVCoord::GetIntU() const
 	return (int)_u;
 }
 
+float UVCoord::GetU() const
+{
+	return _u;
+}
+
 void UVCoord::SetU(const float u)
 {
 	_u = u;
@@ -35,6 +40,11 @@ int UVCoord::GetIntV() const
 	return (int)_v;
 }
 
+float UVCoord::GetV() const
+{
+	return _v;
+}
+
 void UVCoord::SetV(const float v)
 {
 	_v = v;
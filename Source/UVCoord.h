@@ -16,8 +16,10 @@ public:
 	*/
 
 	int GetIntU() const;
+	float GetU() const;
 	void SetU(const float u);
 	int GetIntV() const;
+	float GetV() const;
 	void SetV(const float v);
 
 private:
@@ -1,7 +1,7 @@
 #pragma once
 #include "Vector3D.h"
 #include "UVCoord.h"
-#include <windows.h>
+#include "Platform.h"
 
 class Vertex
 {
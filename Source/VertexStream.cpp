@@ -0,0 +1,87 @@
+#include "VertexStream.h"
+
+VertexStream::VertexStream()
+{
+	_count = 0;
+}
+
+void VertexStream::Resize(size_t count)
+{
+	size_t paddedCount = (count + BatchSize - 1) / BatchSize * BatchSize;
+
+	_count = count;
+	_x.resize(paddedCount);
+	_y.resize(paddedCount);
+	_z.resize(paddedCount);
+	_w.resize(paddedCount);
+
+	//the padding is a valid point so that transforming and dividing it is harmless
+	for (size_t i = count; i < paddedCount; i++)
+	{
+		Set(i, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+size_t VertexStream::GetCount() const
+{
+	return _count;
+}
+
+size_t VertexStream::GetPaddedCount() const
+{
+	return _x.size();
+}
+
+float* VertexStream::GetX()
+{
+	return _x.data();
+}
+
+float* VertexStream::GetY()
+{
+	return _y.data();
+}
+
+float* VertexStream::GetZ()
+{
+	return _z.data();
+}
+
+float* VertexStream::GetW()
+{
+	return _w.data();
+}
+
+const float* VertexStream::GetX() const
+{
+	return _x.data();
+}
+
+const float* VertexStream::GetY() const
+{
+	return _y.data();
+}
+
+const float* VertexStream::GetZ() const
+{
+	return _z.data();
+}
+
+const float* VertexStream::GetW() const
+{
+	return _w.data();
+}
+
+void VertexStream::Set(size_t index, float x, float y, float z, float w)
+{
+	_x[index] = x;
+	_y[index] = y;
+	_z[index] = z;
+	_w[index] = w;
+}
+
+void VertexStream::Add(float x, float y, float z, float w)
+{
+	Resize(_count + 1);
+	Set(_count - 1, x, y, z, w);
+}
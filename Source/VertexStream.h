@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include "AlignedAllocator.h"
+
+/*
+Holds the positions of a set of vertices as structure-of-arrays, one array each for
+x, y, z and w, so that SIMD code can load the same coordinate of 4 or 8 neighbouring
+vertices with a single instruction.
+
+Each array is 32 byte aligned and padded with (0, 0, 0, 1) up to a whole multiple of
+8 vertices, so batch code can always work in full groups without a scalar tail.
+*/
+
+class VertexStream
+{
+public:
+	static const size_t BatchSize = 8;
+
+	VertexStream();
+
+	/*
+	Sets the number of vertices in the stream. Memory is only reallocated when the stream grows.
+	*/
+
+	void Resize(size_t count);
+
+	/*
+	Accessors to get the number of vertices, and that number rounded up to a whole batch
+	*/
+
+	size_t GetCount() const;
+	size_t GetPaddedCount() const;
+
+	/*
+	Accessors to get each coordinate array
+	*/
+
+	float* GetX();
+	float* GetY();
+	float* GetZ();
+	float* GetW();
+	const float* GetX() const;
+	const float* GetY() const;
+	const float* GetZ() const;
+	const float* GetW() const;
+
+	/*
+	Writes one vertex position into the stream, or adds one onto the end
+	*/
+
+	void Set(size_t index, float x, float y, float z, float w);
+	void Add(float x, float y, float z, float w);
+
+private:
+	typedef std::vector<float, AlignedAllocator<float, 32>> AlignedFloats;
+
+	size_t _count;
+	AlignedFloats _x;
+	AlignedFloats _y;
+	AlignedFloats _z;
+	AlignedFloats _w;
+};